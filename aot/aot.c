@@ -0,0 +1,327 @@
+#include "isa_defs.h"
+
+
+
+// paot: translates a memory image into a C program that behaves like
+// running it under pvm. Every code address gets a label, JMP/JAL and
+// LDI + branch pairs become plain gotos, and targets only known at run
+// time (RET, offsets from the stack) go through a label table.
+//
+// Build the output with aot/aot_runtime.c, simulator/trap_handlers.c
+// and common/string_utils.c (see `make aot`).
+
+static word_t IMAGE[MEMORY_SIZE];
+static word_t code_end;
+static uint8_t dynamic[MEMORY_SIZE]; // STORE targets, interpreted each time.
+static FILE *out;
+
+
+
+static int in_code(word_t addr)
+{
+    return addr >= CODE_START && addr < code_end;
+}
+
+// Static transfer to addr.
+static void emit_goto(word_t addr)
+{
+    if (in_code(addr))
+        fprintf(out, "goto L%04X;", addr);
+    else
+        fprintf(out, "DISPATCH(0x%04X);", addr);
+}
+
+static const char *branch_condition(int func, int base)
+{
+    // Operands sit at MEMORY[sp + base] (value, or rhs) and above.
+    static char buf[96];
+    switch (func)
+    {
+        case FUNC_BEQ: snprintf(buf, sizeof(buf), "MEMORY[sp + %d] == MEMORY[sp + %d]", base + 1, base); break;
+        case FUNC_BNE: snprintf(buf, sizeof(buf), "MEMORY[sp + %d] != MEMORY[sp + %d]", base + 1, base); break;
+        case FUNC_BZ:  snprintf(buf, sizeof(buf), "MEMORY[sp + %d] == 0", base); break;
+        case FUNC_BNZ: snprintf(buf, sizeof(buf), "MEMORY[sp + %d] != 0", base); break;
+        case FUNC_BN:  snprintf(buf, sizeof(buf), "(sword_t)MEMORY[sp + %d] < 0", base); break;
+        default:       snprintf(buf, sizeof(buf), "(sword_t)MEMORY[sp + %d] > 0", base); break;
+    }
+    return buf;
+}
+
+// Returns 1 if control can fall through to addr + 1.
+static int emit_branch(word_t addr, int func)
+{
+    int pops = (FUNC_BEQ == func || FUNC_BNE == func) ? 3 : 2;
+
+    fprintf(out, "CHECK_STACK_UNDERFLOW(sp, %d);\n", pops);
+    fprintf(out, "    { word_t off = MEMORY[sp]; int taken = %s; sp += %d;\n",
+            branch_condition(func, 1), pops);
+    fprintf(out, "      if (taken) DISPATCH(0x%04X + sign_extend_12(off)); }", (word_t)(addr + 1));
+    return 1;
+}
+
+// LDI k followed by a branch: the offset is never pushed, both ways are gotos.
+static void emit_folded_branch(word_t addr, sword_t offset, int func)
+{
+    int pops = (FUNC_BEQ == func || FUNC_BNE == func) ? 2 : 1;
+    word_t after = addr + 2;
+
+    fprintf(out, "CHECK_STACK_UNDERFLOW(sp, %d);\n", pops);
+    fprintf(out, "    { int taken = %s; sp += %d;\n", branch_condition(func, 0), pops);
+    fprintf(out, "      if (taken) ");
+    emit_goto((word_t)(after + offset));
+    fprintf(out, " }\n    ");
+    emit_goto(after);
+}
+
+static const char *alu_code(int func)
+{
+    switch (func)
+    {
+        case FUNC_ADD:  return "BINARY(n + t);";
+        case FUNC_SUB:  return "BINARY(n - t);";
+        case FUNC_MULT: return "BINARY((sword_t)n * (sword_t)t);";
+        case FUNC_AND:  return "BINARY(n & t);";
+        case FUNC_OR:   return "BINARY(n | t);";
+        case FUNC_XOR:  return "BINARY(n ^ t);";
+        case FUNC_SHL:  return "BINARY((sword_t)n << (sword_t)t);";
+        case FUNC_SHR:  return "BINARY((sword_t)n >> (sword_t)t);";
+        case FUNC_NEG:  return "UNARY(-v);";
+        case FUNC_INC:  return "UNARY(v + 1);";
+        case FUNC_DEC:  return "UNARY(v - 1);";
+        case FUNC_ABS:  return "UNARY(v < 0 ? -v : v);";
+        case FUNC_NOT:  return "UNARY(!v);";
+        case FUNC_DIV:
+            return "CHECK_STACK_UNDERFLOW(sp, 2);\n"
+                   "    { sword_t t = (sword_t)MEMORY[sp], n = (sword_t)MEMORY[sp + 1];\n"
+                   "      if (0 == t) aot_div_zero();\n"
+                   "      MEMORY[sp + 1] = (word_t)(n % t); MEMORY[sp] = (word_t)(n / t); }";
+    }
+    return NULL;
+}
+
+static const char *stack_code(int func)
+{
+    switch (func)
+    {
+        case FUNC_SWAP: return "CHECK_STACK_UNDERFLOW(sp, 2);\n"
+                               "    { word_t t = MEMORY[sp]; MEMORY[sp] = MEMORY[sp + 1]; MEMORY[sp + 1] = t; }";
+        case FUNC_DUP:  return "CHECK_STACK_UNDERFLOW(sp, 1); CHECK_STACK_OVERFLOW(sp, 1);\n"
+                               "    sp--; MEMORY[sp] = MEMORY[sp + 1];";
+        case FUNC_DROP: return "CHECK_STACK_UNDERFLOW(sp, 1); sp++;";
+        case FUNC_OVER: return "CHECK_STACK_UNDERFLOW(sp, 2); CHECK_STACK_OVERFLOW(sp, 1);\n"
+                               "    sp--; MEMORY[sp] = MEMORY[sp + 2];";
+    }
+    return NULL;
+}
+
+
+
+// Emits the body for the instruction at addr.
+// Returns 1 if control can fall through to addr + 1.
+static int emit_instruction(word_t addr)
+{
+    Instruction in;
+    in.raw = IMAGE[addr];
+    int     arg  = in.fields.arg;
+    sword_t imm  = sign_extend_12(arg);
+    word_t  next = addr + 1;
+
+    if (dynamic[addr])
+    {
+        fprintf(out, "STEP(0x%04X);", addr);
+        return 0;
+    }
+
+    switch (in.fields.opcode)
+    {
+        case OP_ALU_LOGIC:
+            if (arg >= ALU_FUNC_COUNT)
+                break;
+            fprintf(out, "%s", alu_code(arg));
+            return 1;
+
+        case OP_STACK_OPS:
+            if (arg >= STACK_FUNC_COUNT)
+                break;
+            fprintf(out, "%s", stack_code(arg));
+            return 1;
+
+        case OP_BRANCH:
+            if (arg >= BRANCH_FUNC_COUNT)
+                break;
+            return emit_branch(addr, arg);
+
+        case OP_LDI:
+        {
+            Instruction after;
+            after.raw = IMAGE[next];
+            if (in_code(next) && !dynamic[next] &&
+                OP_BRANCH == after.fields.opcode && after.fields.arg < BRANCH_FUNC_COUNT)
+            {
+                emit_folded_branch(addr, imm, after.fields.arg);
+                return 0;
+            }
+            fprintf(out, "MEMORY[--sp] = 0x%04X;", (word_t)imm);
+            return 1;
+        }
+
+        case OP_LOAD:
+            fprintf(out, "CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x%04X];",
+                    (word_t)(IMAGE[0] + imm));
+            return 1;
+
+        case OP_STORE:
+            fprintf(out, "CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x%04X] = MEMORY[sp++];",
+                    (word_t)(IMAGE[0] + imm));
+            return 1;
+
+        case OP_JMP:
+            emit_goto((word_t)(next + imm));
+            return 0;
+
+        case OP_JAL:
+            fprintf(out, "CHECK_STACK_OVERFLOW(sp, 1); MEMORY[--sp] = lr; lr = 0x%04X;\n    ", next);
+            emit_goto((word_t)(next + imm));
+            return 0;
+
+        case OP_RET:
+            fprintf(out, "CHECK_STACK_UNDERFLOW(sp, 1); pc = lr; lr = MEMORY[sp++]; DISPATCH(pc);");
+            return 0;
+
+        case OP_TRAP:
+            fprintf(out, "REGS.SP = sp; REGS.LR = lr; aot_trap(%d, 0x%04X); sp = REGS.SP;", arg, addr);
+            return 1;
+
+        case OP_HALT:
+            fprintf(out, "aot_halt(0x%04X);", addr);
+            return 0;
+    }
+
+    fprintf(out, "aot_illegal(0x%04X);", addr);
+    return 0;
+}
+
+
+
+int main(int argc, char **argv)
+{
+    const char *filename = NULL;
+    const char *out_name = NULL;
+
+    if (2 == argc)
+    {
+        filename = argv[1];
+    }
+    else if (4 == argc && 0 == strcmp(argv[1], "-o"))
+    {
+        out_name = argv[2];
+        filename = argv[3];
+    }
+    else
+    {
+        fprintf(stderr, "Usage: %s [-o output.c] <binary_file.bin>\n", argv[0]);
+        fprintf(stderr, "  Writes a C translation of the image (stdout by default)\n");
+        return EXIT_FAILURE;
+    }
+
+    // Same loading rules as pdis.
+    FILE *input = fopen(filename, "rb");
+    if (!input)
+    {
+        perror("Error opening input file");
+        return EXIT_FAILURE;
+    }
+
+    size_t words_read = fread(IMAGE, sizeof(word_t), MEMORY_SIZE, input);
+    fclose(input);
+
+    code_end = IMAGE[0x0000];
+    if (0 == code_end)
+    {
+        code_end = words_read < MEMORY_SIZE ? words_read : MEMORY_SIZE - 1;
+    }
+    word_t br = IMAGE[0x0000];
+
+    out = stdout;
+    if (out_name && NULL == (out = fopen(out_name, "w")))
+    {
+        perror("Error opening output file");
+        return EXIT_FAILURE;
+    }
+
+    // STOREs into the code region make their target a runtime decision.
+    size_t dynamic_count = 0;
+    for (word_t pc = CODE_START; pc < code_end; pc++)
+    {
+        Instruction in;
+        in.raw = IMAGE[pc];
+        word_t ea = br + sign_extend_12(in.fields.arg);
+        if (OP_STORE == in.fields.opcode && in_code(ea) && !dynamic[ea])
+        {
+            dynamic[ea] = 1;
+            dynamic_count++;
+        }
+    }
+
+    fprintf(out, "// Generated by paot from %s, do not edit.\n\n", filename);
+    fprintf(out, "#include \"aot_runtime.h\"\n\n");
+    fprintf(out, "#define CODE_END 0x%04X\n\n", code_end);
+
+    fprintf(out, "static const word_t IMAGE[%zu] = {", words_read ? words_read : 1);
+    for (size_t i = 0; i < words_read; i++)
+        fprintf(out, "%s0x%04X,", 0 == i % 12 ? "\n    " : " ", IMAGE[i]);
+    fprintf(out, "%s\n};\n\n", words_read ? "" : " 0");
+
+    fprintf(out, "static const word_t DYNAMIC[%zu] = {", dynamic_count ? dynamic_count : 1);
+    for (word_t pc = CODE_START, n = 0; pc < code_end; pc++)
+        if (dynamic[pc])
+            fprintf(out, "%s0x%04X,", 0 == n++ % 12 ? "\n    " : " ", pc);
+    fprintf(out, "%s\n};\n\n", dynamic_count ? "" : " 0");
+
+    fprintf(out,
+        "// n/t are the two top words, v the top word as signed.\n"
+        "#define BINARY(e) do { CHECK_STACK_UNDERFLOW(sp, 2); word_t t = MEMORY[sp++], n = MEMORY[sp]; \\\n"
+        "                       MEMORY[sp] = (word_t)(e); } while (0)\n"
+        "#define UNARY(e)  do { CHECK_STACK_UNDERFLOW(sp, 1); sword_t v = (sword_t)MEMORY[sp]; \\\n"
+        "                       MEMORY[sp] = (word_t)(e); } while (0)\n"
+        "#define DISPATCH(target) do { pc = (target); \\\n"
+        "                       goto *(pc < CODE_END ? LABELS[pc] : &&interpret); } while (0)\n"
+        "#define STEP(addr) do { pc = (addr); goto interpret; } while (0)\n\n");
+
+    fprintf(out, "int main(void)\n{\n");
+    fprintf(out, "    aot_start(IMAGE, %zu, CODE_END, DYNAMIC, %zu);\n\n", words_read, dynamic_count);
+    fprintf(out, "    static void *const LABELS[CODE_END > 0 ? CODE_END : 1] = {\n");
+    fprintf(out, "        [0] = &&interpret,\n");
+    for (word_t pc = CODE_START; pc < code_end; pc++)
+        fprintf(out, "        [0x%04X] = &&L%04X,\n", pc, pc);
+    fprintf(out, "    };\n\n");
+    fprintf(out, "    register word_t sp = REGS.SP;\n");
+    fprintf(out, "    register word_t lr = REGS.LR;\n");
+    fprintf(out, "    word_t pc;\n\n");
+    fprintf(out, "    DISPATCH(CODE_START);\n\n");
+
+    // Anything outside the compiled code runs one instruction at a time.
+    fprintf(out, "interpret:\n");
+    fprintf(out, "    REGS.SP = sp; REGS.LR = lr;\n");
+    fprintf(out, "    pc = aot_step(pc);\n");
+    fprintf(out, "    sp = REGS.SP; lr = REGS.LR;\n");
+    fprintf(out, "    DISPATCH(pc);\n\n");
+
+    for (word_t pc = CODE_START; pc < code_end; pc++)
+    {
+        fprintf(out, "L%04X:\n    ", pc);
+        int falls_through = emit_instruction(pc);
+        fprintf(out, "\n");
+        if (falls_through && pc + 1 == code_end)
+        {
+            fprintf(out, "    DISPATCH(0x%04X);\n", (word_t)(pc + 1));
+        }
+    }
+
+    fprintf(out, "}\n");
+
+    if (out != stdout)
+        fclose(out);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+#include "aot_runtime.h"
+#include "trap_handlers.h"
+#include <stdarg.h>
+
+
+
+// The generated code works on these directly. The trap handlers want a
+// VM, so there's one that shares the memory, see aot_trap().
+word_t MEMORY[MEMORY_SIZE] = {0};
+Registers REGS;
+FILE *log_file = NULL;
+
+static pvm_vm        aot_vm;
+static pvm_vm *const vm = &aot_vm;
+
+static const word_t *original;
+static size_t        original_words;
+static word_t        code_end;
+static uint8_t       dynamic_map[MEMORY_SIZE];
+
+
+
+// The HALT and TRAP 2 messages go after the guest's output, anything
+// else that exits picks it up here.
+static void flush_at_exit(void)
+{
+    flush_guest_output(vm);
+}
+
+
+
+void aot_start(const word_t *image, size_t words, word_t end,
+               const word_t *dynamic, size_t dynamic_count)
+{
+    original       = image;
+    original_words = words;
+    code_end       = end;
+    for (size_t i = 0; i < dynamic_count; i++)
+        dynamic_map[dynamic[i]] = 1;
+
+    REGS.SP = INITIAL_SP;
+    vm->memory = MEMORY;
+    vm->io = HOST_IO;
+    vm->buffered = 1;
+    initialize_trap_table(vm);
+    atexit(flush_at_exit);
+
+    memcpy(MEMORY, image, words * sizeof(word_t));
+    if (words > 0)
+        printf("Loaded %zu words starting at 0x%04X.\n", words, CODE_START);
+    else
+        printf("Warning: Binary file loaded but appears empty lol.\n");
+
+    REGS.BR = MEMORY[0x0000];
+
+    printf("** Starting Simulator at 0x%04X **\n", CODE_START);
+}
+
+
+
+// Compiled code can't follow writes to itself, except at the addresses
+// paot knew about. Anything else is reported rather than ignored.
+void invalidate_code_cache(pvm_vm *unused, word_t addr, word_t count)
+{
+    (void)unused;
+    for (int i = 0; i < count; i++)
+    {
+        word_t a = addr + i;
+        word_t was = a < original_words ? original[a] : 0;
+
+        if (a >= CODE_START && a < code_end && !dynamic_map[a] && MEMORY[a] != was)
+        {
+            fprintf(stderr, "Runtime Error: Write to compiled code at 0x%04X, run this image with pvm instead\n", a);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+
+
+void aot_halt(word_t pc)
+{
+    flush_guest_output(vm);
+    printf("\n** HALT at 0x%04X **\n", pc);
+    exit(EXIT_SUCCESS);
+}
+
+
+
+// What the library does with a longjmp, ends the process here.
+void pvm_fail(pvm_vm *unused, const char *fmt, ...)
+{
+    (void)unused;
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+    exit(EXIT_FAILURE);
+}
+
+
+
+void aot_trap(int trap, word_t pc)
+{
+    if (trap < 256 && vm->traps[trap] != NULL)
+    {
+        vm->regs = REGS;
+        vm->traps[trap](vm);
+        REGS = vm->regs;
+        if (trap == 2) // special exit trap
+        {
+            flush_guest_output(vm);
+            printf("\n** SYS_EXIT at 0x%04X with status %hhu (0x%04X) **\n", pc, vm->status, vm->status);
+            exit(vm->status);
+        }
+    }
+    else
+    {
+        fprintf(stderr, "Runtime Error: Unknown TRAP code 0x%X at 0x%04X\n", trap, pc);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+
+void aot_illegal(word_t pc)
+{
+    Instruction in;
+    in.raw = MEMORY[pc];
+
+    switch (in.fields.opcode)
+    {
+        case OP_ALU_LOGIC:
+            fprintf(stderr, "Runtime Error: Unknown ALU func code 0x%X\n", in.fields.arg);
+            break;
+        case OP_STACK_OPS:
+            fprintf(stderr, "Unknown stack func 0x%X\n", in.fields.arg);
+            break;
+        case OP_BRANCH:
+            fprintf(stderr, "Unknown branch func 0x%X\n", in.fields.arg);
+            break;
+        default:
+            fprintf(stderr, "Runtime Error: Illegal Opcode 0x%X at address 0x%04X\n", in.fields.opcode, pc);
+            break;
+    }
+    exit(EXIT_FAILURE);
+}
+
+
+
+void aot_div_zero(void)
+{
+    fprintf(stderr, "Divide by zero.\n");
+    exit(EXIT_FAILURE);
+}
+
+
+
+static word_t step_alu(word_t pc, int func)
+{
+    word_t sp = REGS.SP;
+
+    switch (func)
+    {
+        case FUNC_NEG:
+        case FUNC_INC:
+        case FUNC_DEC:
+        case FUNC_ABS:
+        case FUNC_NOT:
+        {
+            CHECK_STACK_UNDERFLOW(sp, 1);
+            sword_t v = (sword_t)MEMORY[sp];
+            if (FUNC_NEG == func)      v = -v;
+            else if (FUNC_INC == func) v++;
+            else if (FUNC_DEC == func) v--;
+            else if (FUNC_ABS == func) v = v < 0 ? -v : v;
+            else                       v = !v;
+            MEMORY[sp] = (word_t)v;
+            return pc + 1;
+        }
+
+        case FUNC_DIV:
+        {
+            CHECK_STACK_UNDERFLOW(sp, 2);
+            sword_t t = (sword_t)MEMORY[sp];
+            sword_t n = (sword_t)MEMORY[sp + 1];
+            if (0 == t)
+                aot_div_zero();
+            MEMORY[sp + 1] = (word_t)(n % t);
+            MEMORY[sp]     = (word_t)(n / t);
+            return pc + 1;
+        }
+    }
+
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    word_t t = MEMORY[sp++];
+    word_t n = MEMORY[sp];
+    switch (func)
+    {
+        case FUNC_ADD:  n = n + t; break;
+        case FUNC_SUB:  n = n - t; break;
+        case FUNC_MULT: n = (word_t)((sword_t)n * (sword_t)t); break;
+        case FUNC_AND:  n = n & t; break;
+        case FUNC_OR:   n = n | t; break;
+        case FUNC_XOR:  n = n ^ t; break;
+        case FUNC_SHL:  n = (word_t)((sword_t)n << (sword_t)t); break;
+        case FUNC_SHR:  n = (word_t)((sword_t)n >> (sword_t)t); break;
+    }
+    MEMORY[sp] = n;
+    REGS.SP = sp;
+    return pc + 1;
+}
+
+
+
+static word_t step_branch(word_t pc, int func)
+{
+    word_t sp = REGS.SP;
+    int compare = (FUNC_BEQ == func || FUNC_BNE == func);
+    int pops = compare ? 3 : 2;
+    int taken;
+
+    CHECK_STACK_UNDERFLOW(sp, pops);
+    word_t offset = MEMORY[sp];
+    word_t a      = MEMORY[sp + 1];
+    word_t b      = compare ? MEMORY[sp + 2] : 0;
+    REGS.SP = sp + pops;
+
+    switch (func)
+    {
+        case FUNC_BEQ: taken = (a == b); break;
+        case FUNC_BNE: taken = (a != b); break;
+        case FUNC_BZ:  taken = (a == 0); break;
+        case FUNC_BNZ: taken = (a != 0); break;
+        case FUNC_BN:  taken = ((sword_t)a < 0); break;
+        default:       taken = ((sword_t)a > 0); break;
+    }
+
+    return pc + 1 + (taken ? sign_extend_12(offset) : 0);
+}
+
+
+
+word_t aot_step(word_t pc)
+{
+    Instruction in;
+    in.raw = MEMORY[pc];
+    int     arg = in.fields.arg;
+    sword_t imm = sign_extend_12(arg);
+    word_t  sp  = REGS.SP;
+
+    switch (in.fields.opcode)
+    {
+        case OP_ALU_LOGIC:
+            if (arg >= ALU_FUNC_COUNT)
+                aot_illegal(pc);
+            return step_alu(pc, arg);
+
+        case OP_STACK_OPS:
+            switch (arg)
+            {
+                case FUNC_SWAP:
+                {
+                    CHECK_STACK_UNDERFLOW(sp, 2);
+                    word_t t = MEMORY[sp];
+                    MEMORY[sp] = MEMORY[sp + 1];
+                    MEMORY[sp + 1] = t;
+                    break;
+                }
+                case FUNC_DUP:
+                    CHECK_STACK_UNDERFLOW(sp, 1);
+                    CHECK_STACK_OVERFLOW(sp, 1);
+                    MEMORY[sp - 1] = MEMORY[sp];
+                    REGS.SP--;
+                    break;
+                case FUNC_DROP:
+                    CHECK_STACK_UNDERFLOW(sp, 1);
+                    REGS.SP++;
+                    break;
+                case FUNC_OVER:
+                    CHECK_STACK_UNDERFLOW(sp, 2);
+                    CHECK_STACK_OVERFLOW(sp, 1);
+                    MEMORY[sp - 1] = MEMORY[sp + 1];
+                    REGS.SP--;
+                    break;
+                default:
+                    aot_illegal(pc);
+            }
+            return pc + 1;
+
+        case OP_BRANCH:
+            if (arg >= BRANCH_FUNC_COUNT)
+                aot_illegal(pc);
+            return step_branch(pc, arg);
+
+        case OP_LDI:
+            MEMORY[--REGS.SP] = (word_t)imm;
+            return pc + 1;
+
+        case OP_LOAD:
+            CHECK_STACK_OVERFLOW(sp, 1);
+            REGS.SP--;
+            MEMORY[REGS.SP] = MEMORY[(word_t)(REGS.BR + imm)];
+            return pc + 1;
+
+        case OP_STORE:
+        {
+            CHECK_STACK_UNDERFLOW(sp, 1);
+            word_t ea = REGS.BR + imm;
+            MEMORY[ea] = MEMORY[REGS.SP++];
+            invalidate_code_cache(vm, ea, 1);
+            return pc + 1;
+        }
+
+        case OP_JMP:
+            return pc + 1 + imm;
+
+        case OP_JAL:
+            CHECK_STACK_OVERFLOW(sp, 1);
+            MEMORY[--REGS.SP] = REGS.LR;
+            REGS.LR = pc + 1;
+            return pc + 1 + imm;
+
+        case OP_RET:
+        {
+            CHECK_STACK_UNDERFLOW(sp, 1);
+            word_t target = REGS.LR;
+            REGS.LR = MEMORY[REGS.SP++];
+            return target;
+        }
+
+        case OP_TRAP:
+            aot_trap(arg, pc);
+            return pc + 1;
+
+        case OP_HALT:
+            aot_halt(pc);
+            return pc;
+
+        default:
+            aot_illegal(pc);
+            return pc;
+    }
+}
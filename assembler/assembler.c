@@ -347,7 +347,7 @@ int main(int argc, char **argv)
                 if (!end_quote) { /* error already caught in pass 1 */ break; }
                 *end_quote = '\0'; 
                 
-                word_t words_used = str_pack(start_quote, current_address);
+                word_t words_used = str_pack(MEMORY, start_quote, current_address);
                 current_address += words_used;
             }
             else
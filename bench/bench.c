@@ -0,0 +1,381 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pinnacle.h"
+#include "isa_defs.h"
+#include "jit.h"
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+// pbench: runs memory images back to back inside one process and reports
+// ns per guest instruction. Every run starts from a fresh copy of its
+// image (pvm_map_image resets the VM), so nothing leaks from one
+// repetition into the next.
+//
+// Built with the libpinnacle sources and -DBENCHMARK -DNO_LOG (see
+// `make bench`). Guest output goes to /dev/null, stdin is empty.
+// With --expect DIR, an image with a DIR/NAME.expected file is run once
+// more first and its output has to match that file.
+
+#define MAX_IMAGES     256
+#define MAX_REPS       10000
+#define DEFAULT_WARMUP 3
+#define DEFAULT_REPS   20
+#define DEFAULT_THRESHOLD 5.0   // Percent.
+
+typedef struct
+{
+    char       name[64];
+    pvm_image *image;
+    uint64_t   instructions;    // Per run, the same every run.
+    int        status;
+    double     median, p95, stddev, mean;
+} Workload;
+
+static Workload workloads[MAX_IMAGES];
+static int      workload_count = 0;
+static int      use_jit = 0;
+static int      unbuffered = 0;     // Guest I/O a system call per TRAP.
+static int      console = 0;        // pvm_set_console() on.
+static int      null_fd = -1;       // Where guest output goes.
+static pvm_vm  *vm;
+
+
+
+static void load_image(const char *path)
+{
+    if (workload_count == MAX_IMAGES)
+    {
+        fprintf(stderr, "Too many images, the limit is %d\n", MAX_IMAGES);
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (NULL == f)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    static word_t words[MEMORY_SIZE];
+    size_t count = fread(words, sizeof(word_t), MEMORY_SIZE, f);
+    if (0 == count)
+        fprintf(stderr, "Warning: %s is empty\n", path);
+    fclose(f);
+
+    Workload *w = &workloads[workload_count++];
+    w->image = pvm_image_create(words, count * sizeof(word_t));
+    if (NULL == w->image)
+    {
+        perror("pvm_image_create");
+        exit(EXIT_FAILURE);
+    }
+
+    // "bin/bench/sieve.bin" is reported as "sieve".
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(w->name, sizeof(w->name), "%s", base);
+    char *dot = strrchr(w->name, '.');
+    if (dot)
+        *dot = '\0';
+}
+
+
+
+// Same starting state as a fresh pvm. Returns the exit status.
+static int run_once(const Workload *w)
+{
+    if (pvm_map_image(vm, w->image) != 0)
+    {
+        perror(w->name);
+        exit(EXIT_FAILURE);
+    }
+
+    pvm_status result = use_jit ? pvm_run_jit(vm) : pvm_run(vm, 0);
+    if (PVM_ERROR == result)
+    {
+        fprintf(stderr, "%s: %s\n", w->name, pvm_error(vm));
+        exit(EXIT_FAILURE);
+    }
+    return PVM_EXITED == result ? pvm_exit_status(vm) : 0;
+}
+
+
+
+// The guest writes to fd 1 directly.
+static void check_output(const Workload *w, const char *dir)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.expected", dir, w->name);
+    FILE *expected = fopen(path, "rb");
+    if (NULL == expected)
+        return;
+
+    FILE *got = tmpfile();
+    if (NULL == got)
+    {
+        perror("tmpfile");
+        exit(EXIT_FAILURE);
+    }
+
+    dup2(fileno(got), STDOUT_FILENO);
+    run_once(w);
+    dup2(null_fd, STDOUT_FILENO);
+    rewind(got);
+
+    int a, b;
+    do
+    {
+        a = fgetc(expected);
+        b = fgetc(got);
+    } while (a == b && a != EOF);
+
+    fclose(expected);
+    fclose(got);
+
+    if (a != b)
+    {
+        fprintf(stderr, "%s: output does not match %s\n", w->name, path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+
+static void measure(Workload *w, int warmup, int reps)
+{
+    static double samples[MAX_REPS];
+
+    for (int i = 0; i < warmup; i++)
+        run_once(w);
+
+    for (int i = 0; i < reps; i++)
+    {
+        double start = now_ns();
+        int st = run_once(w);
+        double elapsed = now_ns() - start;
+        uint64_t instr_count = pvm_instructions(vm);
+
+        // A workload that doesn't repeat itself can't be compared with anything.
+        if (i > 0 && (instr_count != w->instructions || st != w->status))
+        {
+            fprintf(stderr, "%s: run %d executed %llu instructions (status %d), run 0 did %llu (status %d)\n",
+                    w->name, i, (unsigned long long)instr_count, st,
+                    (unsigned long long)w->instructions, w->status);
+            exit(EXIT_FAILURE);
+        }
+        w->instructions = instr_count;
+        w->status = st;
+        samples[i] = elapsed / (instr_count ? instr_count : 1);
+    }
+
+    qsort(samples, reps, sizeof(double), compare_doubles);
+
+    double sum = 0.0;
+    for (int i = 0; i < reps; i++)
+        sum += samples[i];
+    w->mean = sum / reps;
+
+    double var = 0.0;
+    for (int i = 0; i < reps; i++)
+        var += (samples[i] - w->mean) * (samples[i] - w->mean);
+    w->stddev = reps > 1 ? sqrt(var / (reps - 1)) : 0.0;
+
+    w->median = reps % 2 ? samples[reps / 2]
+                         : (samples[reps / 2 - 1] + samples[reps / 2]) / 2;
+    // Nearest rank.
+    w->p95 = samples[(int)ceil(0.95 * reps) - 1];
+}
+
+
+
+// One workload per line, so the baseline can be read back without a
+// JSON parser and diffs stay readable.
+static void write_json(FILE *out, int warmup, int reps)
+{
+    fprintf(out, "{\n");
+    fprintf(out, "  \"engine\": \"%s\",\n", use_jit ? "jit" : "interpreter");
+    fprintf(out, "  \"unit\": \"ns/instr\",\n");
+    fprintf(out, "  \"warmup\": %d,\n", warmup);
+    fprintf(out, "  \"repetitions\": %d,\n", reps);
+    fprintf(out, "  \"workloads\": [\n");
+    for (int i = 0; i < workload_count; i++)
+    {
+        const Workload *w = &workloads[i];
+        fprintf(out, "    {\"name\": \"%s\", \"instructions\": %llu, \"status\": %d, "
+                     "\"median\": %.4f, \"p95\": %.4f, \"stddev\": %.4f, \"mean\": %.4f}%s\n",
+                w->name, (unsigned long long)w->instructions, w->status,
+                w->median, w->p95, w->stddev, w->mean,
+                i + 1 < workload_count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+
+
+// Returns the number of workloads that got slower than the threshold.
+static int compare_baseline(const char *path, double threshold)
+{
+    FILE *f = fopen(path, "r");
+    if (NULL == f)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    int regressions = 0;
+    char line[512];
+
+    fprintf(stderr, "%-24s %10s %10s %8s\n", "workload", "baseline", "now", "change");
+    while (fgets(line, sizeof(line), f))
+    {
+        char name[64];
+        double base;
+        const char *n = strstr(line, "\"name\": \"");
+        const char *m = strstr(line, "\"median\": ");
+        if (NULL == n || NULL == m ||
+            1 != sscanf(n + 9, "%63[^\"]", name) || 1 != sscanf(m + 10, "%lf", &base))
+            continue;
+
+        for (int i = 0; i < workload_count; i++)
+        {
+            if (strcmp(workloads[i].name, name) != 0)
+                continue;
+
+            double change = base > 0 ? (workloads[i].median / base - 1.0) * 100.0 : 0.0;
+            int slower = change > threshold;
+            regressions += slower;
+            fprintf(stderr, "%-24s %10.4f %10.4f %+7.1f%%%s\n",
+                    name, base, workloads[i].median, change, slower ? "  REGRESSION" : "");
+        }
+    }
+
+    fclose(f);
+    return regressions;
+}
+
+
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [options] image.bin...\n", prog);
+    fprintf(stderr, "  --jit:           Run the images on the JIT\n");
+    fprintf(stderr, "  --unbuffered:    A system call for every TRAP 0 and TRAP 1\n");
+    fprintf(stderr, "  --console:       STORE -2048 and LOAD -2047 are the console\n");
+    fprintf(stderr, "  -w N:            Warmup runs per image (default %d)\n", DEFAULT_WARMUP);
+    fprintf(stderr, "  -n N:            Measured runs per image (default %d)\n", DEFAULT_REPS);
+    fprintf(stderr, "  -o FILE:         Write the JSON report to FILE instead of stdout\n");
+    fprintf(stderr, "  --expect DIR:    Check output against DIR/NAME.expected first\n");
+    fprintf(stderr, "  --baseline FILE: Compare medians with an earlier report\n");
+    fprintf(stderr, "  --threshold PCT: Slowdown that counts as a regression (default %.0f%%)\n",
+            DEFAULT_THRESHOLD);
+    exit(EXIT_FAILURE);
+}
+
+
+
+int main(int argc, char **argv)
+{
+    int warmup = DEFAULT_WARMUP;
+    int reps = DEFAULT_REPS;
+    const char *output = NULL;
+    const char *baseline = NULL;
+    const char *expect_dir = NULL;
+    double threshold = DEFAULT_THRESHOLD;
+
+    for (int i = 1; i < argc; i++)
+    {
+        int has_value = i + 1 < argc;
+
+        if (0 == strcmp(argv[i], "--jit"))
+            use_jit = 1;
+        else if (0 == strcmp(argv[i], "--unbuffered"))
+            unbuffered = 1;
+        else if (0 == strcmp(argv[i], "--console"))
+            console = 1;
+        else if (0 == strcmp(argv[i], "-w") && has_value)
+            warmup = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-n") && has_value)
+            reps = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-o") && has_value)
+            output = argv[++i];
+        else if (0 == strcmp(argv[i], "--expect") && has_value)
+            expect_dir = argv[++i];
+        else if (0 == strcmp(argv[i], "--baseline") && has_value)
+            baseline = argv[++i];
+        else if (0 == strcmp(argv[i], "--threshold") && has_value)
+            threshold = atof(argv[++i]);
+        else if ('-' == argv[i][0])
+            usage(argv[0]);
+        else
+            load_image(argv[i]);
+    }
+
+    if (0 == workload_count || warmup < 0 || reps < 1 || reps > MAX_REPS)
+        usage(argv[0]);
+
+    // Keep the report, silence the guests.
+    int report_fd = dup(STDOUT_FILENO);
+    null_fd = open("/dev/null", O_RDWR);
+    if (report_fd < 0 || null_fd < 0)
+    {
+        perror("Could not redirect the guest I/O");
+        return EXIT_FAILURE;
+    }
+    fflush(stdout);
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(null_fd, STDIN_FILENO);
+
+    vm = pvm_create();
+    if (NULL == vm)
+    {
+        perror("Could not create the VM");
+        return EXIT_FAILURE;
+    }
+    pvm_set_buffering(vm, !unbuffered);
+    pvm_set_console(vm, console);
+
+    for (int i = 0; i < workload_count; i++)
+    {
+        if (expect_dir)
+            check_output(&workloads[i], expect_dir);
+        measure(&workloads[i], warmup, reps);
+        fprintf(stderr, "%-24s %12llu instr  median %.4f ns/instr\n", workloads[i].name,
+                (unsigned long long)workloads[i].instructions, workloads[i].median);
+    }
+    fflush(stdout);
+
+    FILE *out = output ? fopen(output, "w") : fdopen(report_fd, "w");
+    if (NULL == out)
+    {
+        perror(output ? output : "fdopen");
+        return EXIT_FAILURE;
+    }
+    write_json(out, warmup, reps);
+    fclose(out);
+
+    if (baseline && compare_baseline(baseline, threshold) > 0)
+    {
+        fprintf(stderr, "Regression over %.1f%% against %s\n", threshold, baseline);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
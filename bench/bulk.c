@@ -0,0 +1,116 @@
+#include "isa_defs.h"
+
+
+
+// pbulk: what the memory and number TRAPs (5 to 11) buy over guest loops,
+// and the console over TRAPs. Every bench/bulk/NAME_trap.asm does what
+// NAME_loop.asm does in guest code, and bench/console/NAME_console.asm
+// what NAME_trap.asm does, with the same output. Reads pbench's reports
+// on them and prints the time per run of both (see `make bulk`).
+//
+//     pbulk REPORT.json...
+
+#define MAX_PAIRS 16
+
+// The old way first.
+static const char *SUFFIXES[] = { "_loop", "_trap", "_console" };
+#define SUFFIX_COUNT ((int)(sizeof(SUFFIXES) / sizeof(SUFFIXES[0])))
+
+typedef struct
+{
+    char   name[64];            // Without the suffix.
+    double us[SUFFIX_COUNT];    // Per run, by suffix. 0 if not found.
+} Pair;
+
+static Pair pairs[MAX_PAIRS];
+static int  pair_count = 0;
+
+
+
+static Pair *find_pair(const char *name)
+{
+    for (int i = 0; i < pair_count; i++)
+        if (0 == strcmp(pairs[i].name, name))
+            return &pairs[i];
+
+    if (MAX_PAIRS == pair_count)
+        return NULL;
+    Pair *p = &pairs[pair_count++];
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    return p;
+}
+
+
+
+// One workload per line in pbench's report.
+static void read_report(const char *report)
+{
+    FILE *f = fopen(report, "r");
+    if (NULL == f)
+    {
+        perror(report);
+        exit(EXIT_FAILURE);
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), f))
+    {
+        char name[64];
+        unsigned long long instructions;
+        double median;
+        const char *n  = strstr(line, "\"name\": \"");
+        const char *is = strstr(line, "\"instructions\": ");
+        const char *ms = strstr(line, "\"median\": ");
+        if (NULL == n || NULL == is || NULL == ms ||
+            1 != sscanf(n + 9, "%63[^\"]", name) ||
+            1 != sscanf(is + 16, "%llu", &instructions) || 1 != sscanf(ms + 10, "%lf", &median))
+            continue;
+
+        // The median is per instruction, the run took this long.
+        char *suffix = strrchr(name, '_');
+        int s = 0;
+        while (suffix && s < SUFFIX_COUNT && strcmp(suffix, SUFFIXES[s]) != 0)
+            s++;
+        if (NULL == suffix || SUFFIX_COUNT == s)
+            continue;
+        *suffix = '\0';
+
+        Pair *p = find_pair(name);
+        if (p)
+            p->us[s] = median * instructions / 1e3;
+    }
+    fclose(f);
+}
+
+
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s REPORT.json...\n", argv[0]);
+        fprintf(stderr, "  Prints the speedup of each NAME_trap over NAME_loop, and of each\n");
+        fprintf(stderr, "  NAME_console over NAME_trap, in pbench reports\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < argc; i++)
+        read_report(argv[i]);
+
+    printf("%-10s %-8s %12s %-8s %12s %10s\n", "name", "old", "us", "new", "us", "speedup");
+    for (int i = 0; i < pair_count; i++)
+    {
+        // The only two it has, or the first and last if ever there are more.
+        const Pair *p = &pairs[i];
+        int old = 0, new = SUFFIX_COUNT - 1;
+        while (old < SUFFIX_COUNT && 0 == p->us[old])
+            old++;
+        while (new > old && 0 == p->us[new])
+            new--;
+        if (new <= old)
+            continue;
+        printf("%-10s %-8s %12.1f %-8s %12.1f %9.1fx\n", p->name, SUFFIXES[old] + 1, p->us[old],
+               SUFFIXES[new] + 1, p->us[new], p->us[old] / p->us[new]);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+; Formats V in decimal ROUNDS times, V going round V * 75 + 74 every
+; time, into OUT: DIV by 10 for the digits, then packed two to a word
+; through patched LOADs and STOREs. Prints the last one and the sum of
+; their lengths. format_trap.asm does the same with TRAP 9.
+
+.CODE
+    LDI DIGS
+    LOAD OP_LOAD
+    ADD
+    STORE LD_DIGS
+    LDI DIGS
+    LOAD OP_STORE
+    ADD
+    STORE ST_DIGS
+    LDI OUT
+    INC
+    LOAD OP_STORE
+    ADD
+    STORE ST_OUT1
+
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL FORMAT
+    LOAD SUM
+    LOAD R
+    ADD
+    STORE SUM
+    LOAD V
+    LDI 75
+    MULT
+    LDI 74
+    ADD
+    STORE V
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LDI 1
+    LDI OUT
+    TRAP 1
+    DROP
+    LDI 1
+    LDI NEWLINE
+    TRAP 1
+    DROP
+    LOAD SUM
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+; OUT = V as a signed decimal, R = its length. The digits come from
+; W = -|V|, which -32768 fits in too, into DIGS last first.
+FORMAT:
+    LDI 0
+    STORE NEG
+    LOAD V
+    LDI 4
+    BN
+    LOAD V
+    NEG
+    STORE W
+    JMP F_DIGITS
+    LOAD V
+    STORE W
+    LDI 1
+    STORE NEG
+F_DIGITS:
+    LDI 0
+    STORE N
+F_LOOP:
+    LOAD W
+    LDI 10
+    DIV
+    STORE W
+    LDI 48
+    SWAP
+    SUB
+    LOAD N
+    LOAD ST_DIGS
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD N
+    INC
+    STORE N
+    LOAD W
+    LDI 1
+    BZ
+    JMP F_LOOP
+    ; The sign goes last, it comes out first.
+    LOAD NEG
+    LDI 9
+    BZ
+    LDI 45
+    LOAD N
+    LOAD ST_DIGS
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD N
+    INC
+    STORE N
+    LOAD N
+    STORE OUT
+    LOAD N
+    STORE R
+    LDI 0
+    STORE K
+    LOAD N
+    STORE J
+; OUT[1 + K] = DIGS[J - 1] << 8 | DIGS[J - 2], 0 for the last one if
+; there is none.
+P_LOOP:
+    LOAD J
+    LDI 1
+    BP
+    RET
+    LOAD J
+    DEC
+    DUP
+    STORE J
+    LOAD LD_DIGS
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    LDI 8
+    SHL
+    LOAD J
+    LDI 1
+    BP
+    JMP P_STORE
+    LOAD J
+    DEC
+    DUP
+    STORE J
+    LOAD LD_DIGS
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    OR
+P_STORE:
+    LOAD K
+    LOAD ST_OUT1
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD K
+    INC
+    STORE K
+    JMP P_LOOP
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    NEWLINE:    .WORD 1
+                .WORD 0x0A00
+    OP_LOAD:    .WORD 0x5000
+    OP_STORE:   .WORD 0x6000
+    LD_SLOT:    .WORD 0x5000    ; LOAD x
+                .WORD 0x2000    ; SWAP
+                .WORD 0x9000    ; RET
+    ST_THUNK:   .WORD 0x2000    ; SWAP
+    ST_SLOT:    .WORD 0x6000    ; STORE x
+                .WORD 0x9000    ; RET
+    LD_DIGS:    .WORD 0
+    ST_DIGS:    .WORD 0
+    ST_OUT1:    .WORD 0
+    ROUNDS:     .WORD 5000
+    V:          .WORD 1
+    W:          .WORD 0
+    NEG:        .WORD 0
+    N:          .WORD 0
+    J:          .WORD 0
+    K:          .WORD 0
+    R:          .WORD 0
+    SUM:        .WORD 0
+    DIGS:       .WORD 0         ; Up to 6 of them.
+                .WORD 0
+                .WORD 0
+                .WORD 0
+                .WORD 0
+                .WORD 0
+    OUT:        .WORD 0         ; Length, then up to 3 words, past the image.
@@ -0,0 +1,111 @@
+; Formats V in decimal ROUNDS times, V going round V * 75 + 74 every
+; time, into OUT with TRAP 9 (format). Prints the last one and the sum
+; of their lengths. format_loop.asm is the same as a guest loop.
+
+.CODE
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL FORMAT
+    LOAD SUM
+    LOAD R
+    ADD
+    STORE SUM
+    LOAD V
+    LDI 75
+    MULT
+    LDI 74
+    ADD
+    STORE V
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LDI 1
+    LDI OUT
+    TRAP 1
+    DROP
+    LDI 1
+    LDI NEWLINE
+    TRAP 1
+    DROP
+    LOAD SUM
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+FORMAT:
+    LDI OUT
+    LOAD V
+    LDI 10
+    TRAP 9
+    STORE R
+    RET
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    NEWLINE:    .WORD 1
+                .WORD 0x0A00
+    ROUNDS:     .WORD 5000
+    V:          .WORD 1
+    R:          .WORD 0
+    SUM:        .WORD 0
+    OUT:        .WORD 0         ; Length, then up to 3 words, past the image.
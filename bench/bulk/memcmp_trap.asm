@@ -0,0 +1,103 @@
+; Compares the words of TEXT and OTHER, which differ in the last one,
+; ROUNDS times with TRAP 7 (memcmp). Adds up the results (1 every time)
+; and prints the sum. memcmp_loop.asm is the same as a guest loop.
+
+.CODE
+    LOAD TEXT
+    INC
+    LDI 1
+    SHR
+    INC
+    STORE WORDS
+
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL COMPARE
+    LOAD SUM
+    LOAD R
+    ADD
+    STORE SUM
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LOAD SUM
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+COMPARE:
+    LDI TEXT
+    LDI OTHER
+    LOAD WORDS
+    TRAP 7
+    STORE R
+    RET
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    ROUNDS:     .WORD 2000
+    WORDS:      .WORD 0
+    R:          .WORD 0
+    SUM:        .WORD 0
+    TEXT:       .STRING "The quick brown fox jumps over the lazy dog, then naps in the shade of an old oak tree. Pack my box with five dozen liquor jugs! How vexingly quick daft zebras jump, while sphinx of black quartz judges my vow. Waltz, bad nymph, for quick jigs vex. Bright vixens jump, dozy fowl quack. 0123456789 and back again: 9876543210."
+    OTHER:      .STRING "The quick brown fox jumps over the lazy dog, then naps in the shade of an old oak tree. Pack my box with five dozen liquor jugs! How vexingly quick daft zebras jump, while sphinx of black quartz judges my vow. Waltz, bad nymph, for quick jigs vex. Bright vixens jump, dozy fowl quack. 0123456789 and back again: 9876543210!"
@@ -0,0 +1,85 @@
+; Copies TEXT to BUF, length word and all, ROUNDS times, a word at a time
+; through a patched LOAD and STORE. Then prints BUF.
+; memcpy_trap.asm does the same with TRAP 5.
+
+.CODE
+    LDI TEXT
+    LOAD OP_LOAD
+    ADD
+    STORE LD_TEXT
+    LDI BUF
+    LOAD OP_STORE
+    ADD
+    STORE ST_BUF
+    LOAD TEXT
+    INC
+    LDI 1
+    SHR
+    INC
+    STORE WORDS
+
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL COPY
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LDI 1
+    LDI BUF
+    TRAP 1
+    DROP
+    LDI 1
+    LDI NEWLINE
+    TRAP 1
+    DROP
+    TRAP 2
+
+; BUF[i] = TEXT[i] for i = WORDS - 1 down to 0.
+COPY:
+    LOAD WORDS
+    STORE I
+COPY_LOOP:
+    LOAD I
+    DEC
+    DUP
+    STORE I
+    DUP
+    LOAD LD_TEXT
+    ADD
+    STORE LD_SLOT
+    LOAD ST_BUF
+    ADD
+    STORE ST_SLOT
+    JAL LD_SLOT
+    JAL ST_THUNK
+    LOAD I
+    LDI 1
+    BZ
+    JMP COPY_LOOP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NEWLINE:    .WORD 1
+                .WORD 0x0A00
+    OP_LOAD:    .WORD 0x5000
+    OP_STORE:   .WORD 0x6000
+    LD_SLOT:    .WORD 0x5000    ; LOAD x
+                .WORD 0x2000    ; SWAP
+                .WORD 0x9000    ; RET
+    ST_THUNK:   .WORD 0x2000    ; SWAP
+    ST_SLOT:    .WORD 0x6000    ; STORE x
+                .WORD 0x9000    ; RET
+    LD_TEXT:    .WORD 0
+    ST_BUF:     .WORD 0
+    ROUNDS:     .WORD 2000
+    WORDS:      .WORD 0
+    I:          .WORD 0
+    TEXT:       .STRING "The quick brown fox jumps over the lazy dog, then naps in the shade of an old oak tree. Pack my box with five dozen liquor jugs! How vexingly quick daft zebras jump, while sphinx of black quartz judges my vow. Waltz, bad nymph, for quick jigs vex. Bright vixens jump, dozy fowl quack. 0123456789 and back again: 9876543210."
+    BUF:        .WORD 0         ; As long as TEXT, past the image.
@@ -0,0 +1,48 @@
+; Copies TEXT to BUF, length word and all, ROUNDS times with TRAP 5
+; (memcpy). Then prints BUF. memcpy_loop.asm is the same as a guest loop.
+
+.CODE
+    LOAD TEXT
+    INC
+    LDI 1
+    SHR
+    INC
+    STORE WORDS
+
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL COPY
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LDI 1
+    LDI BUF
+    TRAP 1
+    DROP
+    LDI 1
+    LDI NEWLINE
+    TRAP 1
+    DROP
+    TRAP 2
+
+COPY:
+    LDI BUF
+    LDI TEXT
+    LOAD WORDS
+    TRAP 5
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NEWLINE:    .WORD 1
+                .WORD 0x0A00
+    ROUNDS:     .WORD 2000
+    WORDS:      .WORD 0
+    TEXT:       .STRING "The quick brown fox jumps over the lazy dog, then naps in the shade of an old oak tree. Pack my box with five dozen liquor jugs! How vexingly quick daft zebras jump, while sphinx of black quartz judges my vow. Waltz, bad nymph, for quick jigs vex. Bright vixens jump, dozy fowl quack. 0123456789 and back again: 9876543210."
+    BUF:        .WORD 0         ; As long as TEXT, past the image.
@@ -0,0 +1,72 @@
+; Fills the N words of BUF with FILL, ROUNDS times, a word at a time
+; through a patched STORE. FILL goes from "--" to "<>" and back every
+; round. Then prints BUF. memset_trap.asm does the same with TRAP 6.
+
+.CODE
+    LDI BUF
+    INC
+    LOAD OP_STORE
+    ADD
+    STORE ST_BUF1
+
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL FILL_BUF
+    LOAD FILL
+    LOAD TOGGLE
+    XOR
+    STORE FILL
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LDI 1
+    LDI BUF
+    TRAP 1
+    DROP
+    LDI 1
+    LDI NEWLINE
+    TRAP 1
+    DROP
+    TRAP 2
+
+; BUF[1 + i] = FILL for i = N - 1 down to 0.
+FILL_BUF:
+    LOAD N
+    STORE I
+FILL_LOOP:
+    LOAD FILL
+    LOAD I
+    DEC
+    DUP
+    STORE I
+    LOAD ST_BUF1
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD I
+    LDI 1
+    BZ
+    JMP FILL_LOOP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NEWLINE:    .WORD 1
+                .WORD 0x0A00
+    OP_STORE:   .WORD 0x6000
+    ST_THUNK:   .WORD 0x2000    ; SWAP
+    ST_SLOT:    .WORD 0x6000    ; STORE x
+                .WORD 0x9000    ; RET
+    ST_BUF1:    .WORD 0
+    FILL:       .WORD 0x2D2D    ; "--"
+    TOGGLE:     .WORD 0x1113    ; "--" ^ "<>"
+    ROUNDS:     .WORD 500
+    N:          .WORD 1000
+    I:          .WORD 0
+    BUF:        .WORD 2000      ; Characters, N words of them past the image.
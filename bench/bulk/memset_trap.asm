@@ -0,0 +1,48 @@
+; Fills the N words of BUF with FILL, ROUNDS times with TRAP 6 (memset).
+; FILL goes from "--" to "<>" and back every round. Then prints BUF.
+; memset_loop.asm is the same as a guest loop.
+
+.CODE
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL FILL_BUF
+    LOAD FILL
+    LOAD TOGGLE
+    XOR
+    STORE FILL
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LDI 1
+    LDI BUF
+    TRAP 1
+    DROP
+    LDI 1
+    LDI NEWLINE
+    TRAP 1
+    DROP
+    TRAP 2
+
+FILL_BUF:
+    LDI BUF
+    INC
+    LOAD FILL
+    LOAD N
+    TRAP 6
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NEWLINE:    .WORD 1
+                .WORD 0x0A00
+    FILL:       .WORD 0x2D2D    ; "--"
+    TOGGLE:     .WORD 0x1113    ; "--" ^ "<>"
+    ROUNDS:     .WORD 500
+    N:          .WORD 1000
+    BUF:        .WORD 2000      ; Characters, N words of them past the image.
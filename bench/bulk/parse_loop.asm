@@ -0,0 +1,235 @@
+; Parses the numbers in TEXT, ROUNDS times, a character at a time
+; through a patched LOAD, and adds them all up. Prints the sum masked to
+; 15 bits. parse_trap.asm does the same with TRAP 11.
+
+.CODE
+    LDI TEXT
+    INC
+    LOAD OP_LOAD
+    ADD
+    STORE LD_TEXT1
+
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    LDI 0
+    STORE POS
+NEXT:
+    JAL PARSE
+    LOAD C
+    LDI 1
+    BNZ
+    JMP ROUND_END
+    LOAD SUM
+    LOAD V
+    ADD
+    STORE SUM
+    LOAD POS
+    LOAD C
+    ADD
+    STORE POS
+    JMP NEXT
+ROUND_END:
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LOAD SUM
+    LOAD MASK
+    AND
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+; V = the number at TEXT[POS], C = the characters it took, 0 if there's
+; none. TEXT has no tabs or + signs, so this doesn't look for them.
+PARSE:
+    LOAD POS
+    STORE I
+    LDI 0
+    STORE V
+    LDI 0
+    STORE NEG
+P_BLANK:
+    LOAD I
+    LOAD TEXT
+    SUB
+    LDI 1
+    BN
+    JMP P_NONE
+    LOAD I
+    JAL GETC
+    LDI 32
+    SUB
+    LDI 4
+    BNZ
+    LOAD I
+    INC
+    STORE I
+    JMP P_BLANK
+    LOAD I
+    JAL GETC
+    LDI 45
+    SUB
+    LDI 5
+    BNZ
+    LDI 1
+    STORE NEG
+    LOAD I
+    INC
+    STORE I
+    LOAD I
+    STORE START
+P_DIGIT:
+    LOAD I
+    LOAD TEXT
+    SUB
+    LDI 1
+    BN
+    JMP P_END
+    LOAD I
+    JAL GETC
+    LDI 48
+    SUB
+    DUP
+    LDI 5
+    BN
+    DUP
+    LDI 10
+    SUB
+    LDI 1
+    BN
+    JMP P_END_DROP
+    LOAD V
+    LDI 10
+    MULT
+    ADD
+    STORE V
+    LOAD I
+    INC
+    STORE I
+    JMP P_DIGIT
+P_END_DROP:
+    DROP
+P_END:
+    LOAD I
+    LOAD START
+    SUB
+    LDI 1
+    BNZ
+    JMP P_NONE
+    LOAD NEG
+    LDI 3
+    BZ
+    LOAD V
+    NEG
+    STORE V
+    LOAD I
+    LOAD POS
+    SUB
+    STORE C
+    RET
+P_NONE:
+    LDI 0
+    STORE V
+    LDI 0
+    STORE C
+    RET
+
+; [i] -> [TEXT[i]], the high byte of a word comes first.
+GETC:
+    SWAP
+    DUP
+    LDI 1
+    SHR
+    LOAD LD_TEXT1
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    SWAP
+    LDI 1
+    AND
+    LDI 2
+    BNZ
+    LDI 8
+    SHR
+    LDI 255
+    AND
+    SWAP
+    RET
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    OP_LOAD:    .WORD 0x5000
+    LD_SLOT:    .WORD 0x5000    ; LOAD x
+                .WORD 0x2000    ; SWAP
+                .WORD 0x9000    ; RET
+    LD_TEXT1:   .WORD 0
+    MASK:       .WORD 0x7FFF
+    ROUNDS:     .WORD 500
+    POS:        .WORD 0
+    START:      .WORD 0
+    I:          .WORD 0
+    V:          .WORD 0
+    C:          .WORD 0
+    NEG:        .WORD 0
+    SUM:        .WORD 0
+    TEXT:       .STRING "-10 4747 -381 5 -458 27821 14630 -325 87 -9453 -11844 24405 390 -281 -297 -1628 53 -23 -4797 -109 32 50 -23 -4506 -31070 20 -253 302 7 143 16 -32539 29 -9 -273 -1513 1154 15291 -120 -27 -242 3 -27 -7"
@@ -0,0 +1,113 @@
+; Parses the numbers in TEXT, ROUNDS times with TRAP 11 (parse), and
+; adds them all up. Prints the sum masked to 15 bits.
+; parse_loop.asm is the same as a guest loop.
+
+.CODE
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    LDI 0
+    STORE POS
+NEXT:
+    JAL PARSE
+    LOAD C
+    LDI 1
+    BNZ
+    JMP ROUND_END
+    LOAD SUM
+    LOAD V
+    ADD
+    STORE SUM
+    LOAD POS
+    LOAD C
+    ADD
+    STORE POS
+    JMP NEXT
+ROUND_END:
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LOAD SUM
+    LOAD MASK
+    AND
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+PARSE:
+    LDI TEXT
+    LOAD POS
+    LDI 10
+    TRAP 11
+    STORE C
+    STORE V
+    RET
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    MASK:       .WORD 0x7FFF
+    ROUNDS:     .WORD 500
+    POS:        .WORD 0
+    V:          .WORD 0
+    C:          .WORD 0
+    SUM:        .WORD 0
+    TEXT:       .STRING "-10 4747 -381 5 -458 27821 14630 -325 87 -9453 -11844 24405 390 -281 -297 -1628 53 -23 -4797 -109 32 50 -23 -4506 -31070 20 -253 302 7 143 16 -32539 29 -9 -273 -1513 1154 15291 -120 -27 -242 3 -27 -7"
@@ -0,0 +1,208 @@
+; Compares the packed strings TEXT and OTHER, which differ in the last
+; character, ROUNDS times, two characters at a time through a patched
+; LOAD. Adds up the results (1 every time) and prints the sum.
+; strcmp_trap.asm does the same with TRAP 8.
+
+.CODE
+    LDI TEXT
+    INC
+    LOAD OP_LOAD
+    ADD
+    STORE LD_TEXT1
+    LDI OTHER
+    INC
+    LOAD OP_LOAD
+    ADD
+    STORE LD_OTHER1
+
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL STRCMP
+    LOAD SUM
+    LOAD R
+    ADD
+    STORE SUM
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LOAD SUM
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+; R = -1, 0 or 1 as TEXT comes before, is or comes after OTHER. The high
+; byte is the first character and the one after the last is 0, so as far
+; as the shorter one goes a word compares two characters at once.
+STRCMP:
+    LOAD TEXT
+    STORE N
+    LOAD OTHER
+    LOAD N
+    SUB
+    LDI 2
+    BP
+    LOAD OTHER
+    STORE N
+    LOAD N
+    INC
+    LDI 1
+    SHR
+    STORE WORDS
+    LDI 0
+    STORE I
+S_LOOP:
+    LOAD I
+    LOAD WORDS
+    SUB
+    LDI 1
+    BN
+    JMP S_LENGTH
+    LOAD I
+    LOAD LD_TEXT1
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    LOAD I
+    LOAD LD_OTHER1
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    STORE Y
+    STORE X
+    LOAD X
+    LOAD Y
+    LDI 4
+    BNE
+    LOAD I
+    INC
+    STORE I
+    JMP S_LOOP
+    JMP DIFFER
+; The shorter one comes first.
+S_LENGTH:
+    LOAD TEXT
+    LOAD OTHER
+    SUB
+    DUP
+    LDI 4
+    BNZ
+    DROP
+    LDI 0
+    STORE R
+    RET
+    JMP SIGN
+
+; Unsigned: the top 15 bits first, then the last one.
+DIFFER:
+    LOAD X
+    LDI 1
+    SHR
+    LOAD HALF_MASK
+    AND
+    LOAD Y
+    LDI 1
+    SHR
+    LOAD HALF_MASK
+    AND
+    SUB
+    DUP
+    LDI 8
+    BNZ
+    DROP
+    LOAD X
+    LDI 1
+    AND
+    LOAD Y
+    LDI 1
+    AND
+    SUB
+; R = -1 or 1, the sign of what is on the stack.
+SIGN:
+    LDI 3
+    BN
+    LDI 1
+    STORE R
+    RET
+    LDI -1
+    STORE R
+    RET
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    OP_LOAD:    .WORD 0x5000
+    LD_SLOT:    .WORD 0x5000    ; LOAD x
+                .WORD 0x2000    ; SWAP
+                .WORD 0x9000    ; RET
+    LD_TEXT1:   .WORD 0
+    LD_OTHER1:  .WORD 0
+    HALF_MASK:  .WORD 0x7FFF
+    ROUNDS:     .WORD 2000
+    N:          .WORD 0
+    WORDS:      .WORD 0
+    I:          .WORD 0
+    X:          .WORD 0
+    Y:          .WORD 0
+    R:          .WORD 0
+    SUM:        .WORD 0
+    TEXT:       .STRING "The quick brown fox jumps over the lazy dog, then naps in the shade of an old oak tree. Pack my box with five dozen liquor jugs! How vexingly quick daft zebras jump, while sphinx of black quartz judges my vow. Waltz, bad nymph, for quick jigs vex. Bright vixens jump, dozy fowl quack. 0123456789 and back again: 9876543210."
+    OTHER:      .STRING "The quick brown fox jumps over the lazy dog, then naps in the shade of an old oak tree. Pack my box with five dozen liquor jugs! How vexingly quick daft zebras jump, while sphinx of black quartz judges my vow. Waltz, bad nymph, for quick jigs vex. Bright vixens jump, dozy fowl quack. 0123456789 and back again: 9876543210!"
@@ -0,0 +1,84 @@
+; Prints TEXT a character at a time, ROUNDS times, every character a
+; one character string of its own for TRAP 1. putc_console.asm does the
+; same with STORE -2048, it needs the console (pvm --console).
+
+.CODE
+    LDI TEXT
+    INC
+    LOAD OP_LOAD
+    ADD
+    STORE LD_TEXT1
+    LOAD TEXT
+    LDI 1
+    SHR
+    STORE WORDS
+
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL PRINT_TEXT
+    LDI 10
+    JAL EMIT
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    TRAP 2
+
+; TEXT's words through a patched LOAD, the high byte then the low one.
+PRINT_TEXT:
+    LDI 0
+    STORE I
+P_LOOP:
+    LOAD I
+    LOAD LD_TEXT1
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    DUP
+    LDI 8
+    SHR
+    JAL EMIT
+    LDI 255
+    AND
+    JAL EMIT
+    LOAD I
+    INC
+    DUP
+    STORE I
+    LOAD WORDS
+    SUB
+    LDI 1
+    BZ
+    JMP P_LOOP
+    RET
+
+; Prints the character under the return address.
+EMIT:
+    SWAP
+    LDI 8
+    SHL
+    STORE CH1
+    LDI 1
+    LDI CH
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    OP_LOAD:    .WORD 0x5000
+    LD_SLOT:    .WORD 0x5000    ; LOAD x
+                .WORD 0x2000    ; SWAP
+                .WORD 0x9000    ; RET
+    LD_TEXT1:   .WORD 0
+    ROUNDS:     .WORD 50
+    WORDS:      .WORD 0
+    I:          .WORD 0
+    CH:         .WORD 1
+    CH1:        .WORD 0
+    TEXT:       .STRING "Sphinx of black quartz, judge my vow. Pack my box with five dozen liquor jugs."
@@ -0,0 +1,273 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pvmd.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+// pload: a load generator for pvmd. Each of -c clients sends runs of the
+// image back to back, a new one as soon as the last one is done, and
+// every request is timed from sending it to its PVMD_DONE. Reports
+// throughput and latency percentiles.
+//
+//     bin/pvmd &
+//     bin/pload -c 4 -n 20000 bin/bench/strings.bin
+
+#define DEFAULT_CLIENTS  4
+#define DEFAULT_REQUESTS 10000
+#define DEFAULT_WARMUP   100     // Per client, not timed.
+
+typedef struct
+{
+    int        count;           // Timed requests.
+    double    *latencies;       // ns, count of them.
+    int        failed;
+    pthread_t  thread;
+} Client;
+
+static const char *socket_path = PVMD_SOCKET;
+static char        image[PVMD_MAX_IMAGE];
+static size_t      image_size;
+static char       *input;
+static size_t      input_size;
+static PvmdRun     run;
+static int         reconnect = 0;   // A new connection for every request.
+static int         warmup = DEFAULT_WARMUP;
+
+
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-c CLIENTS] [-n REQUESTS] [-w WARMUP] [--reconnect]\n", name);
+    fprintf(stderr, "       %*s [--socket=PATH] [--gas=N] [--input=FILE] IMAGE\n", (int)strlen(name), "");
+    fprintf(stderr, "  -c CLIENTS:    Concurrent clients (default %d)\n", DEFAULT_CLIENTS);
+    fprintf(stderr, "  -n REQUESTS:   Timed requests, all clients together (default %d)\n", DEFAULT_REQUESTS);
+    fprintf(stderr, "  -w WARMUP:     Untimed requests per client first (default %d)\n", DEFAULT_WARMUP);
+    fprintf(stderr, "  --reconnect:   Connect for every request, not once per client\n");
+    fprintf(stderr, "  --input=FILE:  The guest's stdin (default: empty)\n");
+    exit(EXIT_FAILURE);
+}
+
+
+
+// One run, its output thrown away. -1 if it didn't come back as a run.
+static int request(int fd, char *reply)
+{
+    if (pvmd_send(fd, PVMD_RUN, &run, sizeof(run), input, input_size) != 0)
+        return -1;
+
+    PvmdFrame frame;
+    while (0 == pvmd_recv(fd, &frame, reply, PVMD_MAX_FRAME))
+    {
+        if (PVMD_DONE == frame.type)
+        {
+            PvmdDone done;
+            memcpy(&done, reply, sizeof(done));
+            return PVM_ERROR == done.status ? -1 : 0;
+        }
+        if (PVMD_STDOUT != frame.type && PVMD_STDERR != frame.type)
+            return -1;
+    }
+    return -1;
+}
+
+
+
+static void *client_main(void *arg)
+{
+    Client *c = arg;
+    char *reply = malloc(PVMD_MAX_FRAME);
+    int fd = -1;
+
+    for (int i = -warmup; i < c->count && reply; i++)
+    {
+        double start = now_ns();
+        if (-1 == fd && -1 == (fd = pvmd_connect(socket_path)))
+        {
+            c->failed++;
+            continue;
+        }
+
+        if (request(fd, reply) != 0)
+        {
+            c->failed++;
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        if (reconnect)
+        {
+            close(fd);
+            fd = -1;
+        }
+
+        if (i >= 0)
+            c->latencies[i] = now_ns() - start;
+    }
+
+    if (fd >= 0)
+        close(fd);
+    free(reply);
+    return NULL;
+}
+
+
+
+// Puts the image once up front, so no client has to.
+static int put_image(void)
+{
+    int fd = pvmd_connect(socket_path);
+    if (-1 == fd)
+    {
+        fprintf(stderr, "Can't reach pvmd on %s: %s\n", socket_path, strerror(errno));
+        return -1;
+    }
+
+    PvmdFrame frame;
+    uint64_t id = 0;
+    int ok = 0 == pvmd_send(fd, PVMD_PUT, image, image_size, NULL, 0) &&
+             0 == pvmd_recv(fd, &frame, &id, sizeof(id)) && PVMD_IMAGE == frame.type;
+    close(fd);
+
+    if (!ok)
+    {
+        fprintf(stderr, "pvmd didn't take the image\n");
+        return -1;
+    }
+    run.image = id;
+    return 0;
+}
+
+
+
+static size_t read_file(const char *path, char *buf, size_t size)
+{
+    FILE *f = fopen(path, "rb");
+    if (NULL == f)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    size_t n = fread(buf, 1, size, f);
+    fclose(f);
+    return n;
+}
+
+
+
+int main(int argc, char **argv)
+{
+    int clients = DEFAULT_CLIENTS;
+    int requests = DEFAULT_REQUESTS;
+    const char *image_path = NULL;
+    const char *input_path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        int has_value = i + 1 < argc;
+
+        if (0 == strcmp(argv[i], "-c") && has_value)
+            clients = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-n") && has_value)
+            requests = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-w") && has_value)
+            warmup = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "--reconnect"))
+            reconnect = 1;
+        else if (0 == strncmp(argv[i], "--socket=", 9) && argv[i][9])
+            socket_path = argv[i] + 9;
+        else if (0 == strncmp(argv[i], "--gas=", 6) && atoll(argv[i] + 6) > 0)
+            run.gas = (uint64_t)atoll(argv[i] + 6);
+        else if (0 == strncmp(argv[i], "--input=", 8) && argv[i][8])
+            input_path = argv[i] + 8;
+        else if ('-' == argv[i][0] || image_path)
+            usage(argv[0]);
+        else
+            image_path = argv[i];
+    }
+
+    if (NULL == image_path || clients < 1 || requests < clients || warmup < 0)
+        usage(argv[0]);
+
+    image_size = read_file(image_path, image, sizeof(image));
+    input = malloc(PVMD_MAX_INPUT);
+    if (NULL == input)
+    {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    if (input_path)
+        input_size = read_file(input_path, input, PVMD_MAX_INPUT);
+
+    if (0 == image_size || put_image() != 0)
+        return EXIT_FAILURE;
+
+    Client *all = calloc(clients, sizeof(Client));
+    double *latencies = calloc(requests, sizeof(double));
+    if (NULL == all || NULL == latencies)
+    {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+
+    double start = now_ns();
+    for (int i = 0; i < clients; i++)
+    {
+        all[i].latencies = latencies + (size_t)requests * i / clients;
+        all[i].count     = (int)((size_t)requests * (i + 1) / clients - (size_t)requests * i / clients);
+        int err = pthread_create(&all[i].thread, NULL, client_main, &all[i]);
+        if (err != 0)
+        {
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            return EXIT_FAILURE;
+        }
+    }
+
+    int failed = 0;
+    for (int i = 0; i < clients; i++)
+    {
+        pthread_join(all[i].thread, NULL);
+        failed += all[i].failed;
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    // Failed requests left a 0 behind, they go first and are skipped.
+    qsort(latencies, requests, sizeof(double), compare_doubles);
+    int timed = 0;
+    while (timed < requests && latencies[timed] > 0)
+        timed++;
+    double *ok = latencies + (requests - timed);
+
+#   define PERCENTILE(p) (timed ? ok[(int)((timed - 1) * (p) / 100.0)] / 1e3 : 0.0)
+
+    printf("** %d requests on %d clients%s, %d failed, %.0f req/s **\n", requests, clients,
+           reconnect ? " (reconnecting)" : "", failed, timed / elapsed);
+    printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+           PERCENTILE(50), PERCENTILE(90), PERCENTILE(99), PERCENTILE(99.9), PERCENTILE(100));
+
+    free(all);
+    free(latencies);
+    free(input);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,212 @@
+#include "isa_defs.h"
+
+
+
+// pmicro: per-instruction microbenchmarks.
+//
+//   pmicro -d DIR        writes one image per kernel into DIR
+//   pmicro --table FILE  prints a cost table from pbench's report on them
+//
+// Each image is a loop of one kernel unrolled to fill about 1800 words,
+// run enough times for a few million instructions. Kernels leave the
+// stack as they found it. A taken branch jumps over one word, the
+// not-taken one has an offset of 0, so both paths run the same words.
+// LDI + BNZ is fused by the interpreter, so bnz_* measure the fused pair.
+
+#define BODY_WORDS    1800
+#define TARGET_INSTR  4000000
+#define MAX_KERNEL    6
+
+#define F1(op, func) ((word_t)(((op) << 12) | (func)))
+#define F2(op, imm)  ((word_t)(((op) << 12) | ((imm) & 0x0FFF)))
+
+#define LDI(x)    F2(OP_LDI, x)
+#define LOAD(x)   F2(OP_LOAD, x)
+#define STORE(x)  F2(OP_STORE, x)
+#define JMP(x)    F2(OP_JMP, x)
+#define JAL(x)    F2(OP_JAL, x)
+#define ALU(f)    F1(OP_ALU_LOGIC, f)
+#define STK(f)    F1(OP_STACK_OPS, f)
+#define BRANCH(f) F1(OP_BRANCH, f)
+#define RET       F1(OP_RET, 0)
+#define HALT      F1(OP_HALT, 0)
+
+typedef struct
+{
+    const char *name;
+    int         setup;              // Values pushed once, before the loop.
+    int         length;             // Words in body.
+    int         executed;           // Of those, how many run.
+    word_t      body[MAX_KERNEL];
+} Kernel;
+
+static const Kernel KERNELS[] = {
+    { "jmp",        0, 1, 1, { JMP(0) } },
+    { "ldi_drop",   0, 2, 2, { LDI(1), STK(FUNC_DROP) } },
+    { "dup_drop",   1, 2, 2, { STK(FUNC_DUP), STK(FUNC_DROP) } },
+    { "over_drop",  2, 2, 2, { STK(FUNC_OVER), STK(FUNC_DROP) } },
+    { "swap",       2, 1, 1, { STK(FUNC_SWAP) } },
+    { "ldi_add",    1, 2, 2, { LDI(1), ALU(FUNC_ADD) } },
+    { "ldi_sub",    1, 2, 2, { LDI(1), ALU(FUNC_SUB) } },
+    { "ldi_mult",   1, 2, 2, { LDI(1), ALU(FUNC_MULT) } },
+    { "ldi_div",    1, 3, 3, { LDI(3), ALU(FUNC_DIV), STK(FUNC_DROP) } },
+    { "ldi_and",    1, 2, 2, { LDI(1), ALU(FUNC_AND) } },
+    { "ldi_or",     1, 2, 2, { LDI(1), ALU(FUNC_OR) } },
+    { "ldi_xor",    1, 2, 2, { LDI(1), ALU(FUNC_XOR) } },
+    { "ldi_shl",    1, 2, 2, { LDI(1), ALU(FUNC_SHL) } },
+    { "ldi_shr",    1, 2, 2, { LDI(1), ALU(FUNC_SHR) } },
+    { "neg",        1, 1, 1, { ALU(FUNC_NEG) } },
+    { "inc",        1, 1, 1, { ALU(FUNC_INC) } },
+    { "dec",        1, 1, 1, { ALU(FUNC_DEC) } },
+    { "abs",        1, 1, 1, { ALU(FUNC_ABS) } },
+    { "not",        1, 1, 1, { ALU(FUNC_NOT) } },
+    { "load_drop",  0, 2, 2, { LOAD(1), STK(FUNC_DROP) } },
+    { "ldi_store",  0, 2, 2, { LDI(1), STORE(1) } },
+    { "load_store", 0, 2, 2, { LOAD(1), STORE(2) } },
+    { "beq_taken",  0, 5, 4, { LDI(1), LDI(1), LDI(1), BRANCH(FUNC_BEQ), HALT } },
+    { "beq_not",    0, 4, 4, { LDI(1), LDI(2), LDI(0), BRANCH(FUNC_BEQ) } },
+    { "bne_taken",  0, 5, 4, { LDI(1), LDI(2), LDI(1), BRANCH(FUNC_BNE), HALT } },
+    { "bne_not",    0, 4, 4, { LDI(1), LDI(1), LDI(0), BRANCH(FUNC_BNE) } },
+    { "bz_taken",   0, 4, 3, { LDI(0), LDI(1), BRANCH(FUNC_BZ), HALT } },
+    { "bz_not",     0, 3, 3, { LDI(1), LDI(0), BRANCH(FUNC_BZ) } },
+    { "bnz_taken",  0, 4, 3, { LDI(1), LDI(1), BRANCH(FUNC_BNZ), HALT } },
+    { "bnz_not",    0, 3, 3, { LDI(0), LDI(0), BRANCH(FUNC_BNZ) } },
+    { "bn_taken",   0, 4, 3, { LDI(-1), LDI(1), BRANCH(FUNC_BN), HALT } },
+    { "bn_not",     0, 3, 3, { LDI(1), LDI(0), BRANCH(FUNC_BN) } },
+    { "bp_taken",   0, 4, 3, { LDI(1), LDI(1), BRANCH(FUNC_BP), HALT } },
+    { "bp_not",     0, 3, 3, { LDI(0), LDI(0), BRANCH(FUNC_BP) } },
+    // JAL to the RET two words down, which comes back to the JMP over it.
+    { "jal_ret",    0, 3, 3, { JAL(1), JMP(1), RET } },
+};
+
+#define KERNEL_COUNT ((int)(sizeof(KERNELS) / sizeof(KERNELS[0])))
+
+
+
+// [setup] loop: [kernel x n] LOAD 0; DEC; DUP; STORE 0; LDI back; BNZ  HALT
+// The iteration count lives at BR + 0, the kernels use BR + 1 and BR + 2.
+static void write_image(const Kernel *k, const char *dir)
+{
+    static word_t image[MEMORY_SIZE];
+    memset(image, 0, sizeof(image));
+
+    word_t pc = CODE_START;
+    for (int i = 0; i < k->setup; i++)
+        image[pc++] = LDI(1);
+
+    word_t loop = pc;
+    int copies = BODY_WORDS / k->length;
+    for (int c = 0; c < copies; c++)
+        for (int i = 0; i < k->length; i++)
+            image[pc++] = k->body[i];
+
+    image[pc++] = LOAD(0);
+    image[pc++] = ALU(FUNC_DEC);
+    image[pc++] = STK(FUNC_DUP);
+    image[pc++] = STORE(0);
+    image[pc] = LDI(loop - (pc + 2));
+    pc++;
+    image[pc++] = BRANCH(FUNC_BNZ);
+    image[pc++] = HALT;
+
+    long per_iteration = (long)copies * k->executed + 6;
+    long iterations = TARGET_INSTR / per_iteration;
+    if (iterations < 1)
+        iterations = 1;
+    if (iterations > 0xFFFF)
+        iterations = 0xFFFF;
+
+    word_t br = pc;
+    image[0] = br;
+    image[br] = (word_t)iterations;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.bin", dir, k->name);
+    FILE *f = fopen(path, "wb");
+    if (NULL == f || fwrite(image, sizeof(word_t), br + 3, f) != (size_t)(br + 3))
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    fclose(f);
+}
+
+
+
+// Reads the lines pbench writes, one workload per line.
+static void print_table(const char *report)
+{
+    FILE *f = fopen(report, "r");
+    if (NULL == f)
+    {
+        perror(report);
+        exit(EXIT_FAILURE);
+    }
+
+    double median[KERNEL_COUNT], p95[KERNEL_COUNT];
+    int found[KERNEL_COUNT] = {0};
+    char line[512];
+
+    while (fgets(line, sizeof(line), f))
+    {
+        char name[64];
+        double m, p;
+        const char *n  = strstr(line, "\"name\": \"");
+        const char *ms = strstr(line, "\"median\": ");
+        const char *ps = strstr(line, "\"p95\": ");
+        if (NULL == n || NULL == ms || NULL == ps ||
+            1 != sscanf(n + 9, "%63[^\"]", name) ||
+            1 != sscanf(ms + 10, "%lf", &m) || 1 != sscanf(ps + 7, "%lf", &p))
+            continue;
+
+        for (int i = 0; i < KERNEL_COUNT; i++)
+        {
+            if (0 == strcmp(KERNELS[i].name, name))
+            {
+                median[i] = m;
+                p95[i] = p;
+                found[i] = 1;
+            }
+        }
+    }
+    fclose(f);
+
+    // jmp 0 does nothing but dispatch.
+    double dispatch = found[0] ? median[0] : 0.0;
+
+    printf("%-12s %6s %10s %10s %10s %8s\n",
+           "kernel", "instr", "ns/instr", "p95", "ns/kernel", "vs jmp");
+    for (int i = 0; i < KERNEL_COUNT; i++)
+    {
+        if (!found[i])
+            continue;
+        printf("%-12s %6d %10.3f %10.3f %10.3f", KERNELS[i].name, KERNELS[i].executed,
+               median[i], p95[i], median[i] * KERNELS[i].executed);
+        if (dispatch > 0)
+            printf(" %7.2fx", median[i] / dispatch);
+        printf("\n");
+    }
+}
+
+
+
+int main(int argc, char **argv)
+{
+    if (3 == argc && 0 == strcmp(argv[1], "-d"))
+    {
+        for (int i = 0; i < KERNEL_COUNT; i++)
+            write_image(&KERNELS[i], argv[2]);
+        printf("Wrote %d images to %s\n", KERNEL_COUNT, argv[2]);
+        return EXIT_SUCCESS;
+    }
+    if (3 == argc && 0 == strcmp(argv[1], "--table"))
+    {
+        print_table(argv[2]);
+        return EXIT_SUCCESS;
+    }
+
+    fprintf(stderr, "Usage: %s -d DIR | --table REPORT.json\n", argv[0]);
+    fprintf(stderr, "  -d DIR:       Write one image per kernel into DIR\n");
+    fprintf(stderr, "  --table FILE: Print the cost of each kernel from a pbench report\n");
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,251 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "isa_defs.h"
+#include "string_utils.h"
+#include <time.h>
+
+
+
+// pstrings: packed string conversions, string lengths 1 to 4096. Checks
+// every kernel against the byte at a time loops they replaced, wrapping
+// round the end of memory included, then prints ns per call for each.
+//
+//     pstrings [-n CHARS]    CHARS converted per measurement (default 8M)
+
+#define MAX_LENGTH    4096
+#define DEFAULT_CHARS (8 << 20)
+#define REPS          3         // Best of.
+
+static const char *KERNEL_NAMES[] = { "avx2", "sse2", "scalar" };
+#define KERNEL_NAME_COUNT ((int)(sizeof(KERNEL_NAMES) / sizeof(KERNEL_NAMES[0])))
+
+static const int LENGTHS[] = { 1, 2, 3, 4, 7, 8, 15, 16, 31, 32, 63, 64, 100, 128,
+                               255, 256, 512, 1000, 1024, 2048, 4095, 4096 };
+#define LENGTH_COUNT ((int)(sizeof(LENGTHS) / sizeof(LENGTHS[0])))
+
+static word_t memory[MEMORY_SIZE];
+static char   chars[MAX_LENGTH + 1];
+static volatile char sink;
+
+
+
+// **What there was before**
+// A malloc and a character at a time, as TRAP 1 and TRAP 3 did. Not
+// inlined, the ones in string_utils.c can't be either.
+
+__attribute__((noinline))
+static char *old_unpack(const word_t *m, word_t addr)
+{
+    word_t count = m[addr];
+    char *tmp = malloc(count + 1);
+    if (!tmp)
+        return NULL;
+    for (word_t i = 0; i < count; i++)
+        tmp[i] = GET_CHAR_FROM_WORD(m[(word_t)(addr + 1 + i / 2)], i);
+    tmp[count] = '\0';
+    return tmp;
+}
+
+__attribute__((noinline))
+static void old_pack(word_t *m, word_t addr, const char *buffer, word_t count)
+{
+    m[addr] = count;
+    for (word_t i = 0; i < count; i++)
+    {
+        word_t idx = (word_t)(addr + 1 + i / 2);
+        if (0 == i % 2)
+            m[idx] = (buffer[i] & 0xFF) << 8;
+        else
+            m[idx] |= (buffer[i] & 0xFF);
+    }
+}
+
+
+
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+
+
+// Every length up to 300 and some longer ones, at the start, middle and
+// end of memory, and from every offset into them.
+static int check(const char *kernel)
+{
+    static const word_t ADDRS[] = { 0x0000, 0x1234, 0xFFF0, 0xFFFE, 0xFFFF };
+    static word_t expected[MEMORY_SIZE];
+    int failures = 0;
+
+    for (int len = 0; len <= 300 + MAX_LENGTH; len += len < 300 ? 1 : 379)
+    {
+        int n = len > MAX_LENGTH ? MAX_LENGTH : len;
+        for (int i = 0; i < n; i++)
+            chars[i] = (char)(' ' + (i * 7 + len) % 95);
+
+        for (size_t a = 0; a < sizeof(ADDRS) / sizeof(ADDRS[0]); a++)
+        {
+            word_t addr = ADDRS[a];
+            memset(memory, 0xA5, sizeof(memory));
+            memset(expected, 0xA5, sizeof(expected));
+            old_pack(expected, addr, chars, (word_t)n);
+            buf_pack(memory, addr, chars, (word_t)n);
+            if (memcmp(memory, expected, sizeof(memory)) != 0)
+            {
+                fprintf(stderr, "%s: buf_pack of %d at 0x%04X is wrong\n", kernel, n, addr);
+                failures++;
+                continue;
+            }
+
+            char *want = old_unpack(expected, addr);
+            char got[MAX_LENGTH + 1];
+            if (str_unpack(memory, addr, got, sizeof(got)) != n || strcmp(got, want) != 0)
+            {
+                fprintf(stderr, "%s: str_unpack of %d at 0x%04X is wrong\n", kernel, n, addr);
+                failures++;
+            }
+            for (int from = 0; from <= n && from < 40; from++)
+            {
+                buf_unpack(memory, addr, got, (word_t)from, (word_t)(n - from));
+                if (memcmp(got, want + from, n - from) != 0)
+                {
+                    fprintf(stderr, "%s: buf_unpack of %d from %d at 0x%04X is wrong\n",
+                            kernel, n, from, addr);
+                    failures++;
+                }
+            }
+            free(want);
+        }
+    }
+    return failures;
+}
+
+
+
+// ns per call, best of REPS.
+static double time_unpack(int len, long chars_per_rep, int old)
+{
+    buf_pack(memory, 0x2000, chars, (word_t)len);
+    long calls = chars_per_rep / len + 1;
+    double best = 1e300;
+    char out[MAX_LENGTH + 1];
+
+    for (int r = 0; r < REPS; r++)
+    {
+        double start = now_ns();
+        for (long c = 0; c < calls; c++)
+        {
+            if (old)
+            {
+                char *s = old_unpack(memory, 0x2000);
+                sink = s[len - 1];
+                free(s);
+            }
+            else
+            {
+                str_unpack(memory, 0x2000, out, sizeof(out));
+                sink = out[len - 1];
+            }
+        }
+        double ns = (now_ns() - start) / calls;
+        if (ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+static double time_pack(int len, long chars_per_rep, int old)
+{
+    long calls = chars_per_rep / len + 1;
+    double best = 1e300;
+
+    for (int r = 0; r < REPS; r++)
+    {
+        double start = now_ns();
+        for (long c = 0; c < calls; c++)
+        {
+            if (old)
+                old_pack(memory, 0x2000, chars, (word_t)len);
+            else
+                buf_pack(memory, 0x2000, chars, (word_t)len);
+            sink = (char)memory[0x2001];
+        }
+        double ns = (now_ns() - start) / calls;
+        if (ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+
+
+int main(int argc, char **argv)
+{
+    long chars_per_rep = DEFAULT_CHARS;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-n") && i + 1 < argc && atol(argv[i + 1]) > 0)
+            chars_per_rep = atol(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Usage: %s [-n CHARS]\n", argv[0]);
+            fprintf(stderr, "  -n CHARS: Characters converted per measurement (default %d)\n",
+                    DEFAULT_CHARS);
+            return EXIT_FAILURE;
+        }
+    }
+
+    const char *best = str_kernel();
+    const char *usable[KERNEL_NAME_COUNT];
+    int kernels = 0;
+    int failures = 0;
+
+    for (int k = 0; k < KERNEL_NAME_COUNT; k++)
+    {
+        if (str_set_kernel(KERNEL_NAMES[k]) != 0)
+            continue;
+        usable[kernels++] = KERNEL_NAMES[k];
+        failures += check(KERNEL_NAMES[k]);
+    }
+    if (failures)
+    {
+        fprintf(stderr, "%d conversions were wrong\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("** Checked %d kernels, %s is the one in use **\n", kernels, best);
+
+    for (int i = 0; i < MAX_LENGTH; i++)
+        chars[i] = (char)('a' + i % 26);
+
+    for (int pack = 0; pack < 2; pack++)
+    {
+        printf("\n%-12s %8s", pack ? "buf_pack" : "str_unpack", "old");
+        for (int k = 0; k < kernels; k++)
+            printf(" %8s", usable[k]);
+        printf("   ns per call, speedup of %s\n", best);
+
+        for (int l = 0; l < LENGTH_COUNT; l++)
+        {
+            int len = LENGTHS[l];
+            double old = pack ? time_pack(len, chars_per_rep, 1) : time_unpack(len, chars_per_rep, 1);
+            double ours = 0;
+
+            printf("%-12d %8.1f", len, old);
+            for (int k = 0; k < kernels; k++)
+            {
+                str_set_kernel(usable[k]);
+                double ns = pack ? time_pack(len, chars_per_rep, 0) : time_unpack(len, chars_per_rep, 0);
+                if (0 == strcmp(usable[k], best))
+                    ours = ns;
+                printf(" %8.1f", ns);
+            }
+            printf("   %6.1fx\n", old / ours);
+        }
+    }
+
+    str_set_kernel(best);
+    return EXIT_SUCCESS;
+}
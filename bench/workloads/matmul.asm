@@ -0,0 +1,772 @@
+; C = A * B for two 16x16 integer matrices, ROUNDS times, with MULT.
+; Prints the weighted checksum of C (as in sort.asm) and its trace.
+;
+; Element accesses go through patched LOAD/STORE words, as in
+; sieve.asm. Mostly index arithmetic (SHL, ADD) around the MULT.
+
+.CODE
+    LDI A
+    LOAD OP_LOAD
+    ADD
+    STORE LD_A
+    LDI B
+    LOAD OP_LOAD
+    ADD
+    STORE LD_B
+    LDI C
+    LOAD OP_LOAD
+    ADD
+    STORE LD_C
+    LDI C
+    LOAD OP_STORE
+    ADD
+    STORE ST_C
+
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL MATMUL
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    JAL CHECKSUM
+    LOAD SUM
+    STORE NUM
+    JAL PRINT_NUM
+    JAL TRACE
+    LOAD SUM
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+MATMUL:
+    LDI 0
+    STORE I
+M_ROW:
+    LOAD I
+    LDI 16
+    SUB
+    LDI 1
+    BN
+    RET
+    LDI 0
+    STORE J
+M_COL:
+    LOAD J
+    LDI 16
+    SUB
+    LDI 1
+    BN
+    JMP M_NEXT_ROW
+    LDI 0
+    STORE ACC
+    LDI 0
+    STORE K
+M_DOT:
+    LOAD K
+    LDI 16
+    SUB
+    LDI 1
+    BN
+    JMP M_STORE
+    ; A[i][k]
+    LOAD I
+    LDI 4
+    SHL
+    LOAD K
+    ADD
+    LOAD LD_A
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    ; B[k][j]
+    LOAD K
+    LDI 4
+    SHL
+    LOAD J
+    ADD
+    LOAD LD_B
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    MULT
+    LOAD ACC
+    ADD
+    STORE ACC
+    LOAD K
+    INC
+    STORE K
+    JMP M_DOT
+M_STORE:
+    ; C[i][j] = acc
+    LOAD ACC
+    LOAD I
+    LDI 4
+    SHL
+    LOAD J
+    ADD
+    LOAD ST_C
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD J
+    INC
+    STORE J
+    JMP M_COL
+M_NEXT_ROW:
+    LOAD I
+    INC
+    STORE I
+    JMP M_ROW
+
+; SUM = (sum of C[n] * (n + 1)) & 0x7FFF
+CHECKSUM:
+    LDI 0
+    STORE SUM
+    LDI 256
+    STORE I
+C_LOOP:
+    LOAD I
+    DEC
+    DUP
+    STORE I
+    LOAD LD_C
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    LOAD I
+    INC
+    MULT
+    LOAD SUM
+    ADD
+    STORE SUM
+    LOAD I
+    LDI 1
+    BZ
+    JMP C_LOOP
+    LOAD SUM
+    LOAD MASK
+    AND
+    STORE SUM
+    RET
+
+; SUM = sum of C[i][i]
+TRACE:
+    LDI 0
+    STORE SUM
+    LDI 16
+    STORE I
+T_LOOP:
+    LOAD I
+    DEC
+    DUP
+    STORE I
+    LDI 17
+    MULT
+    LOAD LD_C
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    LOAD SUM
+    ADD
+    STORE SUM
+    LOAD I
+    LDI 1
+    BZ
+    JMP T_LOOP
+    RET
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    OP_LOAD:    .WORD 0x5000
+    OP_STORE:   .WORD 0x6000
+    LD_SLOT:    .WORD 0x5000    ; LOAD x
+                .WORD 0x2000    ; SWAP
+                .WORD 0x9000    ; RET
+    ST_THUNK:   .WORD 0x2000    ; SWAP
+    ST_SLOT:    .WORD 0x6000    ; STORE x
+                .WORD 0x9000    ; RET
+    LD_A:       .WORD 0
+    LD_B:       .WORD 0
+    LD_C:       .WORD 0
+    ST_C:       .WORD 0
+    MASK:       .WORD 0x7FFF
+    ROUNDS:     .WORD 50
+    I:          .WORD 0
+    J:          .WORD 0
+    K:          .WORD 0
+    ACC:        .WORD 0
+    SUM:        .WORD 0
+    ; Row major, values below 16.
+    A:          .WORD 12
+                .WORD 0
+                .WORD 0
+                .WORD 1
+                .WORD 13
+                .WORD 6
+                .WORD 5
+                .WORD 9
+                .WORD 1
+                .WORD 5
+                .WORD 8
+                .WORD 1
+                .WORD 7
+                .WORD 9
+                .WORD 2
+                .WORD 9
+                .WORD 15
+                .WORD 1
+                .WORD 8
+                .WORD 2
+                .WORD 4
+                .WORD 14
+                .WORD 12
+                .WORD 0
+                .WORD 9
+                .WORD 13
+                .WORD 15
+                .WORD 13
+                .WORD 4
+                .WORD 5
+                .WORD 13
+                .WORD 13
+                .WORD 12
+                .WORD 15
+                .WORD 7
+                .WORD 6
+                .WORD 4
+                .WORD 8
+                .WORD 14
+                .WORD 11
+                .WORD 5
+                .WORD 8
+                .WORD 4
+                .WORD 12
+                .WORD 13
+                .WORD 0
+                .WORD 3
+                .WORD 0
+                .WORD 10
+                .WORD 5
+                .WORD 10
+                .WORD 14
+                .WORD 5
+                .WORD 15
+                .WORD 12
+                .WORD 14
+                .WORD 14
+                .WORD 0
+                .WORD 6
+                .WORD 2
+                .WORD 11
+                .WORD 5
+                .WORD 3
+                .WORD 3
+                .WORD 0
+                .WORD 14
+                .WORD 2
+                .WORD 14
+                .WORD 13
+                .WORD 13
+                .WORD 3
+                .WORD 11
+                .WORD 10
+                .WORD 1
+                .WORD 4
+                .WORD 1
+                .WORD 3
+                .WORD 15
+                .WORD 13
+                .WORD 11
+                .WORD 4
+                .WORD 5
+                .WORD 13
+                .WORD 9
+                .WORD 4
+                .WORD 15
+                .WORD 3
+                .WORD 6
+                .WORD 1
+                .WORD 5
+                .WORD 12
+                .WORD 12
+                .WORD 14
+                .WORD 10
+                .WORD 15
+                .WORD 10
+                .WORD 14
+                .WORD 5
+                .WORD 10
+                .WORD 1
+                .WORD 0
+                .WORD 14
+                .WORD 11
+                .WORD 2
+                .WORD 8
+                .WORD 8
+                .WORD 13
+                .WORD 7
+                .WORD 1
+                .WORD 0
+                .WORD 9
+                .WORD 4
+                .WORD 5
+                .WORD 9
+                .WORD 8
+                .WORD 11
+                .WORD 8
+                .WORD 6
+                .WORD 9
+                .WORD 1
+                .WORD 8
+                .WORD 4
+                .WORD 8
+                .WORD 5
+                .WORD 5
+                .WORD 13
+                .WORD 8
+                .WORD 10
+                .WORD 0
+                .WORD 13
+                .WORD 6
+                .WORD 9
+                .WORD 4
+                .WORD 1
+                .WORD 14
+                .WORD 8
+                .WORD 7
+                .WORD 5
+                .WORD 10
+                .WORD 7
+                .WORD 15
+                .WORD 10
+                .WORD 13
+                .WORD 1
+                .WORD 5
+                .WORD 10
+                .WORD 4
+                .WORD 13
+                .WORD 11
+                .WORD 12
+                .WORD 7
+                .WORD 7
+                .WORD 12
+                .WORD 5
+                .WORD 2
+                .WORD 3
+                .WORD 8
+                .WORD 4
+                .WORD 7
+                .WORD 10
+                .WORD 12
+                .WORD 12
+                .WORD 15
+                .WORD 12
+                .WORD 3
+                .WORD 0
+                .WORD 5
+                .WORD 4
+                .WORD 15
+                .WORD 0
+                .WORD 0
+                .WORD 9
+                .WORD 5
+                .WORD 6
+                .WORD 4
+                .WORD 10
+                .WORD 12
+                .WORD 15
+                .WORD 7
+                .WORD 7
+                .WORD 4
+                .WORD 9
+                .WORD 5
+                .WORD 0
+                .WORD 6
+                .WORD 1
+                .WORD 3
+                .WORD 14
+                .WORD 15
+                .WORD 9
+                .WORD 3
+                .WORD 3
+                .WORD 11
+                .WORD 12
+                .WORD 12
+                .WORD 3
+                .WORD 4
+                .WORD 2
+                .WORD 7
+                .WORD 15
+                .WORD 8
+                .WORD 2
+                .WORD 9
+                .WORD 5
+                .WORD 11
+                .WORD 10
+                .WORD 4
+                .WORD 9
+                .WORD 1
+                .WORD 15
+                .WORD 12
+                .WORD 1
+                .WORD 10
+                .WORD 6
+                .WORD 10
+                .WORD 3
+                .WORD 12
+                .WORD 14
+                .WORD 2
+                .WORD 0
+                .WORD 1
+                .WORD 3
+                .WORD 5
+                .WORD 13
+                .WORD 5
+                .WORD 4
+                .WORD 6
+                .WORD 5
+                .WORD 14
+                .WORD 15
+                .WORD 12
+                .WORD 0
+                .WORD 9
+                .WORD 1
+                .WORD 13
+                .WORD 2
+                .WORD 9
+                .WORD 0
+                .WORD 5
+                .WORD 4
+                .WORD 14
+                .WORD 4
+                .WORD 9
+                .WORD 2
+                .WORD 7
+                .WORD 9
+                .WORD 14
+                .WORD 9
+                .WORD 7
+                .WORD 6
+                .WORD 8
+                .WORD 15
+                .WORD 8
+                .WORD 11
+                .WORD 3
+                .WORD 15
+    B:          .WORD 3
+                .WORD 12
+                .WORD 4
+                .WORD 11
+                .WORD 11
+                .WORD 15
+                .WORD 13
+                .WORD 1
+                .WORD 12
+                .WORD 7
+                .WORD 3
+                .WORD 9
+                .WORD 6
+                .WORD 15
+                .WORD 15
+                .WORD 3
+                .WORD 10
+                .WORD 6
+                .WORD 6
+                .WORD 3
+                .WORD 1
+                .WORD 12
+                .WORD 10
+                .WORD 10
+                .WORD 15
+                .WORD 0
+                .WORD 12
+                .WORD 3
+                .WORD 11
+                .WORD 7
+                .WORD 8
+                .WORD 2
+                .WORD 11
+                .WORD 12
+                .WORD 14
+                .WORD 13
+                .WORD 1
+                .WORD 11
+                .WORD 2
+                .WORD 8
+                .WORD 7
+                .WORD 11
+                .WORD 3
+                .WORD 1
+                .WORD 12
+                .WORD 15
+                .WORD 12
+                .WORD 0
+                .WORD 12
+                .WORD 11
+                .WORD 12
+                .WORD 12
+                .WORD 1
+                .WORD 6
+                .WORD 5
+                .WORD 13
+                .WORD 12
+                .WORD 4
+                .WORD 7
+                .WORD 6
+                .WORD 1
+                .WORD 1
+                .WORD 10
+                .WORD 14
+                .WORD 6
+                .WORD 13
+                .WORD 13
+                .WORD 3
+                .WORD 9
+                .WORD 10
+                .WORD 2
+                .WORD 13
+                .WORD 4
+                .WORD 6
+                .WORD 6
+                .WORD 3
+                .WORD 2
+                .WORD 8
+                .WORD 1
+                .WORD 1
+                .WORD 14
+                .WORD 13
+                .WORD 2
+                .WORD 4
+                .WORD 0
+                .WORD 0
+                .WORD 8
+                .WORD 11
+                .WORD 6
+                .WORD 11
+                .WORD 0
+                .WORD 14
+                .WORD 4
+                .WORD 0
+                .WORD 1
+                .WORD 11
+                .WORD 12
+                .WORD 5
+                .WORD 9
+                .WORD 4
+                .WORD 11
+                .WORD 3
+                .WORD 5
+                .WORD 10
+                .WORD 9
+                .WORD 14
+                .WORD 3
+                .WORD 7
+                .WORD 15
+                .WORD 2
+                .WORD 8
+                .WORD 15
+                .WORD 6
+                .WORD 2
+                .WORD 0
+                .WORD 4
+                .WORD 4
+                .WORD 0
+                .WORD 10
+                .WORD 12
+                .WORD 5
+                .WORD 11
+                .WORD 15
+                .WORD 3
+                .WORD 10
+                .WORD 12
+                .WORD 6
+                .WORD 0
+                .WORD 5
+                .WORD 14
+                .WORD 8
+                .WORD 9
+                .WORD 0
+                .WORD 0
+                .WORD 4
+                .WORD 5
+                .WORD 0
+                .WORD 13
+                .WORD 3
+                .WORD 5
+                .WORD 13
+                .WORD 6
+                .WORD 8
+                .WORD 1
+                .WORD 14
+                .WORD 4
+                .WORD 15
+                .WORD 4
+                .WORD 6
+                .WORD 0
+                .WORD 3
+                .WORD 7
+                .WORD 1
+                .WORD 14
+                .WORD 13
+                .WORD 15
+                .WORD 13
+                .WORD 13
+                .WORD 0
+                .WORD 6
+                .WORD 8
+                .WORD 15
+                .WORD 5
+                .WORD 9
+                .WORD 14
+                .WORD 9
+                .WORD 6
+                .WORD 6
+                .WORD 15
+                .WORD 10
+                .WORD 13
+                .WORD 4
+                .WORD 2
+                .WORD 11
+                .WORD 10
+                .WORD 0
+                .WORD 12
+                .WORD 10
+                .WORD 7
+                .WORD 12
+                .WORD 14
+                .WORD 7
+                .WORD 12
+                .WORD 5
+                .WORD 2
+                .WORD 11
+                .WORD 1
+                .WORD 8
+                .WORD 3
+                .WORD 11
+                .WORD 7
+                .WORD 4
+                .WORD 15
+                .WORD 0
+                .WORD 5
+                .WORD 14
+                .WORD 14
+                .WORD 4
+                .WORD 4
+                .WORD 7
+                .WORD 15
+                .WORD 13
+                .WORD 9
+                .WORD 13
+                .WORD 7
+                .WORD 9
+                .WORD 6
+                .WORD 4
+                .WORD 9
+                .WORD 13
+                .WORD 15
+                .WORD 3
+                .WORD 4
+                .WORD 13
+                .WORD 12
+                .WORD 14
+                .WORD 15
+                .WORD 10
+                .WORD 4
+                .WORD 7
+                .WORD 5
+                .WORD 15
+                .WORD 4
+                .WORD 3
+                .WORD 1
+                .WORD 10
+                .WORD 2
+                .WORD 14
+                .WORD 8
+                .WORD 11
+                .WORD 5
+                .WORD 14
+                .WORD 8
+                .WORD 14
+                .WORD 0
+                .WORD 8
+                .WORD 4
+                .WORD 8
+                .WORD 2
+                .WORD 5
+                .WORD 13
+                .WORD 3
+                .WORD 15
+                .WORD 1
+                .WORD 0
+                .WORD 10
+                .WORD 12
+                .WORD 10
+                .WORD 2
+                .WORD 3
+                .WORD 13
+                .WORD 3
+                .WORD 12
+                .WORD 0
+                .WORD 15
+                .WORD 11
+    C:          .WORD 0         ; 256 words from here on.
@@ -0,0 +1,33 @@
+; Prints LINE COUNT times, a TRAP 1 per line: what a program that logs
+; as it goes does. Nearly all of it is guest I/O, so this is the one to
+; watch for the cost of a TRAP 1 (compare pvm --unbuffered).
+
+.CODE
+LOOP:
+    LOAD COUNT
+    LDI 1
+    BNZ
+    JMP DONE
+    LDI 1
+    LDI LINE
+    TRAP 1
+    DROP
+    LOAD COUNT
+    DEC
+    STORE COUNT
+    JMP LOOP
+
+DONE:
+    TRAP 2
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    COUNT:      .WORD 5000
+    LINE:       .WORD 14        ; "Hello, world!\n"
+                .WORD 0x4865
+                .WORD 0x6C6C
+                .WORD 0x6F2C
+                .WORD 0x2077
+                .WORD 0x6F72
+                .WORD 0x6C64
+                .WORD 0x210A
@@ -0,0 +1,135 @@
+; Recursive calls through JAL/RET, ROUNDS times: a naive fib(23)
+; (92735 calls, 28657) and a sum of 1..1000 that goes 1000 calls deep
+; (500500, printed masked to 15 bits: 8980).
+;
+; Arguments and results are passed on the stack, under the saved LR
+; that JAL pushes.
+
+.CODE
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    LOAD FIB_N
+    JAL FIB
+    STORE FIB_RESULT
+    LOAD SUM_N
+    JAL SUM_REC
+    LOAD MASK
+    AND
+    STORE SUM_RESULT
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LOAD FIB_RESULT
+    STORE NUM
+    JAL PRINT_NUM
+    LOAD SUM_RESULT
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+; fib(n) = n < 2 ? n : fib(n - 1) + fib(n - 2)
+FIB:
+    SWAP
+    DUP
+    LDI 2
+    SUB
+    LDI 1
+    BN
+    JMP FIB_REC
+    SWAP
+    RET
+FIB_REC:
+    DUP
+    DEC
+    JAL FIB
+    SWAP
+    LDI 2
+    SUB
+    JAL FIB
+    ADD
+    SWAP
+    RET
+
+; sum(n) = n == 0 ? 0 : n + sum(n - 1)
+SUM_REC:
+    SWAP
+    DUP
+    LDI 1
+    BNZ
+    JMP SUM_BASE
+    DUP
+    DEC
+    JAL SUM_REC
+    ADD
+SUM_BASE:
+    SWAP
+    RET
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    MASK:       .WORD 0x7FFF
+    ROUNDS:     .WORD 8
+    FIB_N:      .WORD 23
+    SUM_N:      .WORD 1000
+    FIB_RESULT: .WORD 0
+    SUM_RESULT: .WORD 0
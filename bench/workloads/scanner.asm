@@ -0,0 +1,287 @@
+; Scans a text byte by byte, ROUNDS times: counts lines, words, letters,
+; vowels and digits, and hashes every byte (h = h * 33 + c).
+; Prints the counts from one pass, then the hash masked to 15 bits.
+;
+; TEXT is a run of length-prefixed strings (one per line) ending with
+; an empty one. Words are read in order and split with SHR/AND; the
+; classification is all compares and branches, BEQ for the vowels.
+
+.CODE
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    LDI 0
+    STORE LINES
+    LDI 0
+    STORE WORDS
+    LDI 0
+    STORE LETTERS
+    LDI 0
+    STORE VOWELS
+    LDI 0
+    STORE DIGITS
+    JAL SCAN
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LOAD LINES
+    STORE NUM
+    JAL PRINT_NUM
+    LOAD WORDS
+    STORE NUM
+    JAL PRINT_NUM
+    LOAD LETTERS
+    STORE NUM
+    JAL PRINT_NUM
+    LOAD VOWELS
+    STORE NUM
+    JAL PRINT_NUM
+    LOAD DIGITS
+    STORE NUM
+    JAL PRINT_NUM
+    LOAD H
+    LOAD MASK
+    AND
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+SCAN:
+    LDI TEXT
+    STORE P
+S_STRING:
+    LOAD P
+    LOAD OP_LOAD
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    DUP
+    STORE LEFT
+    LDI 1
+    BNZ
+    RET
+    LOAD LINES
+    INC
+    STORE LINES
+    LDI 0
+    STORE INWORD
+S_WORD:
+    LOAD LEFT
+    LDI 1
+    BNZ
+    JMP S_NEXT_STRING
+    LOAD P
+    INC
+    DUP
+    STORE P
+    LOAD OP_LOAD
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    ; High byte first.
+    DUP
+    LDI 8
+    SHR
+    LDI 255
+    AND
+    JAL CLASSIFY
+    LOAD LEFT
+    DEC
+    DUP
+    STORE LEFT
+    LDI 1
+    BNZ
+    JMP S_ODD
+    LDI 255
+    AND
+    JAL CLASSIFY
+    LOAD LEFT
+    DEC
+    STORE LEFT
+    JMP S_WORD
+S_ODD:
+    DROP
+S_NEXT_STRING:
+    LOAD P
+    INC
+    STORE P
+    JMP S_STRING
+
+; [c] -> []
+CLASSIFY:
+    SWAP
+    DUP
+    STORE CH
+    LOAD H
+    LDI 5
+    SHL
+    LOAD H
+    ADD
+    ADD
+    STORE H
+    ; 'a' <= (c | 32) <= 'z'
+    LOAD CH
+    LDI 32
+    OR
+    DUP
+    STORE LOWER
+    LDI 97
+    SUB
+    INC
+    LDI 1
+    BP
+    JMP NOT_LETTER
+    LDI 122
+    LOAD LOWER
+    SUB
+    INC
+    LDI 1
+    BP
+    JMP NOT_LETTER
+    LOAD LETTERS
+    INC
+    STORE LETTERS
+    ; A new word if we weren't in one.
+    LOAD INWORD
+    LDI 3
+    BNZ
+    LOAD WORDS
+    INC
+    STORE WORDS
+    LDI 1
+    STORE INWORD
+    ; Each BEQ jumps to VOWEL, 21 words after the first LOAD.
+    LOAD LOWER
+    LDI 97
+    LDI 17
+    BEQ
+    LOAD LOWER
+    LDI 101
+    LDI 13
+    BEQ
+    LOAD LOWER
+    LDI 105
+    LDI 9
+    BEQ
+    LOAD LOWER
+    LDI 111
+    LDI 5
+    BEQ
+    LOAD LOWER
+    LDI 117
+    LDI 1
+    BEQ
+    RET
+VOWEL:
+    LOAD VOWELS
+    INC
+    STORE VOWELS
+    RET
+NOT_LETTER:
+    LDI 0
+    STORE INWORD
+    ; '0' <= c <= '9'
+    LOAD CH
+    LDI 48
+    SUB
+    INC
+    LDI 1
+    BP
+    RET
+    LDI 57
+    LOAD CH
+    SUB
+    INC
+    LDI 1
+    BP
+    RET
+    LOAD DIGITS
+    INC
+    STORE DIGITS
+    RET
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    OP_LOAD:    .WORD 0x5000
+    LD_SLOT:    .WORD 0x5000    ; LOAD x
+                .WORD 0x2000    ; SWAP
+                .WORD 0x9000    ; RET
+    MASK:       .WORD 0x7FFF
+    ROUNDS:     .WORD 80
+    P:          .WORD 0
+    LEFT:       .WORD 0
+    CH:         .WORD 0
+    LOWER:      .WORD 0
+    INWORD:     .WORD 0
+    H:          .WORD 0
+    LINES:      .WORD 0
+    WORDS:      .WORD 0
+    LETTERS:    .WORD 0
+    VOWELS:     .WORD 0
+    DIGITS:     .WORD 0
+    TEXT:       .STRING "It was the best of times, it was the worst of times, it was the age of wisdom, it was the age of foolishness, it was the epoch of belief, it was the epoch of incredulity, it was the season of Light, it was the season of Darkness, it was the spring of hope, it was the winter of despair, we had everything before us, we had nothing before us."
+                .STRING "In 1859 the book came out in 31 weekly parts, priced at 1 penny each, and by 1860 it had sold over 100000 copies. Prices were 2s 6d for the bound volume, 45 chapters long, in 3 books."
+                .STRING "Call me Ishmael. Some years ago, never mind how long precisely, having little or no money in my purse, and nothing particular to interest me on shore, I thought I would sail about a little and see the watery part of the world. It is a way I have of driving off the spleen and regulating the circulation."
+                .STRING "ERROR 404 at line 1723, column 88 - unexpected token. WARNING 12 at line 17 - unused variable x9. 3 errors, 7 warnings, build 2024-10-18 finished in 12.75 seconds with exit code 2."
+                .STRING "All happy families are alike, each unhappy family is unhappy in its own way. Everything was in confusion in the Oblonskys house. The wife had discovered that the husband was carrying on an intrigue with a French girl, who had been a governess in their family."
+                .STRING "the end"
+                .WORD 0         ; End of TEXT.
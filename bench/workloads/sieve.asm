@@ -0,0 +1,202 @@
+; Sieve of Eratosthenes over 2000 flags in the data area, run PASSES
+; times. Prints the number of primes below 2000 (303).
+;
+; There is no indirect addressing, so A[i] goes through a LOAD or STORE
+; in the data area whose offset is patched first (LD_SLOT, ST_SLOT).
+; Stresses STORE into code, re-decoding and JAL/RET.
+
+.CODE
+    ; Offsets of SIEVE[0] for the patched LOAD/STORE.
+    LDI SIEVE
+    LOAD OP_LOAD
+    ADD
+    STORE LD_BASE
+    LDI SIEVE
+    LOAD OP_STORE
+    ADD
+    STORE ST_BASE
+
+PASS:
+    LOAD PASSES
+    LDI 1
+    BNZ
+    JMP DONE
+
+    ; SIEVE[i] = 0 for i = N - 1 down to 0.
+    LOAD N
+    STORE I
+CLEAR:
+    LOAD I
+    DEC
+    DUP
+    STORE I
+    LDI 0
+    SWAP
+    LOAD ST_BASE
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD I
+    LDI 1
+    BZ
+    JMP CLEAR
+
+    ; for (i = 2; i * i < N; i++)
+    LDI 2
+    STORE I
+OUTER:
+    LOAD I
+    DUP
+    MULT
+    DUP
+    STORE J
+    LOAD N
+    SUB
+    LDI 1
+    BN
+    JMP COUNT_PRIMES
+    LOAD I
+    LOAD LD_BASE
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    LDI 1
+    BZ
+    JMP NEXT_I
+
+    ; for (j = i * i; j < N; j += i) SIEVE[j] = 1
+MARK:
+    LOAD J
+    LOAD N
+    SUB
+    LDI 1
+    BN
+    JMP NEXT_I
+    LDI 1
+    LOAD J
+    LOAD ST_BASE
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD J
+    LOAD I
+    ADD
+    STORE J
+    JMP MARK
+
+NEXT_I:
+    LOAD I
+    INC
+    STORE I
+    JMP OUTER
+
+COUNT_PRIMES:
+    LDI 0
+    STORE PRIMES
+    LDI 2
+    STORE I
+COUNT_LOOP:
+    LOAD I
+    LOAD N
+    SUB
+    LDI 1
+    BN
+    JMP PASS_END
+    LOAD I
+    LOAD LD_BASE
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    NOT
+    LOAD PRIMES
+    ADD
+    STORE PRIMES
+    LOAD I
+    INC
+    STORE I
+    JMP COUNT_LOOP
+
+PASS_END:
+    LOAD PASSES
+    DEC
+    STORE PASSES
+    JMP PASS
+
+DONE:
+    LOAD PRIMES
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    OP_LOAD:    .WORD 0x5000
+    OP_STORE:   .WORD 0x6000
+    LD_BASE:    .WORD 0
+    ST_BASE:    .WORD 0
+    LD_SLOT:    .WORD 0x5000    ; LOAD x
+                .WORD 0x2000    ; SWAP
+                .WORD 0x9000    ; RET
+    ST_THUNK:   .WORD 0x2000    ; SWAP
+    ST_SLOT:    .WORD 0x6000    ; STORE x
+                .WORD 0x9000    ; RET
+    PASSES:     .WORD 60
+    N:          .WORD 2000
+    I:          .WORD 0
+    J:          .WORD 0
+    PRIMES:     .WORD 0
+    SIEVE:      .WORD 0         ; N words from here on, past the end of the image.
@@ -0,0 +1,608 @@
+; Bubble sort, then insertion sort, of the same 300 word array, ROUNDS
+; times. Each sort works on a fresh copy of ORIG. Prints a weighted
+; checksum of the sorted array after each one (the same number twice).
+;
+; Array accesses go through patched LOAD/STORE words, as in sieve.asm.
+; Mostly compare and swap, with a lot of SUB + BP.
+
+.CODE
+    LDI ORIG
+    LOAD OP_LOAD
+    ADD
+    STORE LD_ORIG
+    LDI WORK
+    LOAD OP_LOAD
+    ADD
+    STORE LD_WORK
+    LDI WORK
+    LOAD OP_STORE
+    ADD
+    STORE ST_WORK
+
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL COPY
+    JAL BUBBLE
+    JAL CHECKSUM
+    LOAD SUM
+    STORE SUM_BUBBLE
+    JAL COPY
+    JAL INSERTION
+    JAL CHECKSUM
+    LOAD SUM
+    STORE SUM_INSERTION
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LOAD SUM_BUBBLE
+    STORE NUM
+    JAL PRINT_NUM
+    LOAD SUM_INSERTION
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+; WORK[i] = ORIG[i]
+COPY:
+    LOAD LEN
+    STORE I
+COPY_LOOP:
+    LOAD I
+    DEC
+    DUP
+    STORE I
+    LOAD LD_ORIG
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    LOAD I
+    LOAD ST_WORK
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD I
+    LDI 1
+    BZ
+    JMP COPY_LOOP
+    RET
+
+BUBBLE:
+    LOAD LEN
+    DEC
+    STORE M
+B_OUTER:
+    LOAD M
+    LDI 1
+    BNZ
+    RET
+    LDI 0
+    STORE I
+B_INNER:
+    LOAD I
+    LOAD M
+    SUB
+    LDI 1
+    BN
+    JMP B_NEXT
+    LOAD I
+    LOAD LD_WORK
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    DUP
+    STORE A
+    LOAD I
+    INC
+    LOAD LD_WORK
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    DUP
+    STORE B
+    SUB
+    LDI 1
+    BP
+    JMP B_STEP
+    LOAD B
+    LOAD I
+    LOAD ST_WORK
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD A
+    LOAD I
+    INC
+    LOAD ST_WORK
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+B_STEP:
+    LOAD I
+    INC
+    STORE I
+    JMP B_INNER
+B_NEXT:
+    LOAD M
+    DEC
+    STORE M
+    JMP B_OUTER
+
+INSERTION:
+    LDI 1
+    STORE I
+I_OUTER:
+    LOAD I
+    LOAD LEN
+    SUB
+    LDI 1
+    BN
+    RET
+    LOAD I
+    LOAD LD_WORK
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    STORE KEY
+    LOAD I
+    DEC
+    STORE J
+I_INNER:
+    LOAD J
+    INC
+    LDI 1
+    BP
+    JMP I_PLACE
+    LOAD J
+    LOAD LD_WORK
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    DUP
+    LOAD KEY
+    SUB
+    LDI 1
+    BP
+    JMP I_PLACE_DROP
+    LOAD J
+    INC
+    LOAD ST_WORK
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD J
+    DEC
+    STORE J
+    JMP I_INNER
+I_PLACE_DROP:
+    DROP
+I_PLACE:
+    LOAD KEY
+    LOAD J
+    INC
+    LOAD ST_WORK
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD I
+    INC
+    STORE I
+    JMP I_OUTER
+
+; SUM = (sum of WORK[i] * (i + 1)) & 0x7FFF
+CHECKSUM:
+    LDI 0
+    STORE SUM
+    LOAD LEN
+    STORE I
+C_LOOP:
+    LOAD I
+    DEC
+    DUP
+    STORE I
+    LOAD LD_WORK
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    LOAD I
+    INC
+    MULT
+    LOAD SUM
+    ADD
+    STORE SUM
+    LOAD I
+    LDI 1
+    BZ
+    JMP C_LOOP
+    LOAD SUM
+    LOAD MASK
+    AND
+    STORE SUM
+    RET
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    OP_LOAD:    .WORD 0x5000
+    OP_STORE:   .WORD 0x6000
+    LD_SLOT:    .WORD 0x5000    ; LOAD x
+                .WORD 0x2000    ; SWAP
+                .WORD 0x9000    ; RET
+    ST_THUNK:   .WORD 0x2000    ; SWAP
+    ST_SLOT:    .WORD 0x6000    ; STORE x
+                .WORD 0x9000    ; RET
+    LD_ORIG:    .WORD 0
+    LD_WORK:    .WORD 0
+    ST_WORK:    .WORD 0
+    MASK:       .WORD 0x7FFF
+    ROUNDS:     .WORD 4
+    LEN:        .WORD 300
+    I:          .WORD 0
+    J:          .WORD 0
+    M:          .WORD 0
+    A:          .WORD 0
+    B:          .WORD 0
+    KEY:        .WORD 0
+    SUM:        .WORD 0
+    SUM_BUBBLE: .WORD 0
+    SUM_INSERTION: .WORD 0
+    ; 300 pseudo-random values below 1000.
+    ORIG:       .WORD 468
+                .WORD 988
+                .WORD 117
+                .WORD 498
+                .WORD 927
+                .WORD 45
+                .WORD 741
+                .WORD 122
+                .WORD 410
+                .WORD 261
+                .WORD 52
+                .WORD 659
+                .WORD 758
+                .WORD 87
+                .WORD 875
+                .WORD 368
+                .WORD 233
+                .WORD 212
+                .WORD 661
+                .WORD 496
+                .WORD 191
+                .WORD 65
+                .WORD 471
+                .WORD 96
+                .WORD 781
+                .WORD 596
+                .WORD 212
+                .WORD 244
+                .WORD 661
+                .WORD 514
+                .WORD 643
+                .WORD 350
+                .WORD 576
+                .WORD 51
+                .WORD 234
+                .WORD 882
+                .WORD 23
+                .WORD 983
+                .WORD 166
+                .WORD 479
+                .WORD 992
+                .WORD 833
+                .WORD 345
+                .WORD 782
+                .WORD 97
+                .WORD 112
+                .WORD 915
+                .WORD 992
+                .WORD 933
+                .WORD 621
+                .WORD 4
+                .WORD 273
+                .WORD 265
+                .WORD 529
+                .WORD 287
+                .WORD 590
+                .WORD 358
+                .WORD 130
+                .WORD 910
+                .WORD 335
+                .WORD 364
+                .WORD 809
+                .WORD 453
+                .WORD 437
+                .WORD 995
+                .WORD 20
+                .WORD 328
+                .WORD 274
+                .WORD 857
+                .WORD 108
+                .WORD 356
+                .WORD 19
+                .WORD 978
+                .WORD 950
+                .WORD 230
+                .WORD 527
+                .WORD 691
+                .WORD 466
+                .WORD 229
+                .WORD 436
+                .WORD 532
+                .WORD 597
+                .WORD 265
+                .WORD 998
+                .WORD 889
+                .WORD 711
+                .WORD 480
+                .WORD 998
+                .WORD 255
+                .WORD 588
+                .WORD 172
+                .WORD 284
+                .WORD 911
+                .WORD 946
+                .WORD 174
+                .WORD 789
+                .WORD 380
+                .WORD 256
+                .WORD 329
+                .WORD 354
+                .WORD 588
+                .WORD 121
+                .WORD 102
+                .WORD 606
+                .WORD 256
+                .WORD 147
+                .WORD 739
+                .WORD 974
+                .WORD 292
+                .WORD 394
+                .WORD 234
+                .WORD 869
+                .WORD 29
+                .WORD 659
+                .WORD 851
+                .WORD 31
+                .WORD 373
+                .WORD 282
+                .WORD 362
+                .WORD 138
+                .WORD 392
+                .WORD 978
+                .WORD 358
+                .WORD 771
+                .WORD 284
+                .WORD 528
+                .WORD 894
+                .WORD 446
+                .WORD 843
+                .WORD 902
+                .WORD 659
+                .WORD 626
+                .WORD 680
+                .WORD 432
+                .WORD 541
+                .WORD 544
+                .WORD 243
+                .WORD 512
+                .WORD 631
+                .WORD 330
+                .WORD 884
+                .WORD 618
+                .WORD 458
+                .WORD 204
+                .WORD 880
+                .WORD 111
+                .WORD 203
+                .WORD 556
+                .WORD 639
+                .WORD 314
+                .WORD 660
+                .WORD 800
+                .WORD 842
+                .WORD 933
+                .WORD 395
+                .WORD 995
+                .WORD 309
+                .WORD 856
+                .WORD 580
+                .WORD 191
+                .WORD 416
+                .WORD 654
+                .WORD 7
+                .WORD 186
+                .WORD 437
+                .WORD 312
+                .WORD 225
+                .WORD 345
+                .WORD 737
+                .WORD 382
+                .WORD 467
+                .WORD 629
+                .WORD 595
+                .WORD 26
+                .WORD 309
+                .WORD 23
+                .WORD 462
+                .WORD 274
+                .WORD 257
+                .WORD 580
+                .WORD 606
+                .WORD 816
+                .WORD 983
+                .WORD 985
+                .WORD 668
+                .WORD 564
+                .WORD 939
+                .WORD 822
+                .WORD 345
+                .WORD 637
+                .WORD 81
+                .WORD 250
+                .WORD 356
+                .WORD 993
+                .WORD 556
+                .WORD 258
+                .WORD 4
+                .WORD 970
+                .WORD 817
+                .WORD 800
+                .WORD 228
+                .WORD 181
+                .WORD 999
+                .WORD 261
+                .WORD 322
+                .WORD 136
+                .WORD 74
+                .WORD 727
+                .WORD 909
+                .WORD 19
+                .WORD 212
+                .WORD 9
+                .WORD 338
+                .WORD 732
+                .WORD 587
+                .WORD 741
+                .WORD 318
+                .WORD 535
+                .WORD 912
+                .WORD 170
+                .WORD 128
+                .WORD 740
+                .WORD 660
+                .WORD 822
+                .WORD 838
+                .WORD 183
+                .WORD 523
+                .WORD 658
+                .WORD 523
+                .WORD 317
+                .WORD 630
+                .WORD 375
+                .WORD 195
+                .WORD 811
+                .WORD 546
+                .WORD 212
+                .WORD 567
+                .WORD 407
+                .WORD 226
+                .WORD 852
+                .WORD 207
+                .WORD 539
+                .WORD 301
+                .WORD 570
+                .WORD 667
+                .WORD 869
+                .WORD 839
+                .WORD 253
+                .WORD 0
+                .WORD 63
+                .WORD 728
+                .WORD 625
+                .WORD 394
+                .WORD 439
+                .WORD 927
+                .WORD 386
+                .WORD 494
+                .WORD 807
+                .WORD 620
+                .WORD 25
+                .WORD 52
+                .WORD 594
+                .WORD 88
+                .WORD 45
+                .WORD 38
+                .WORD 499
+                .WORD 925
+                .WORD 592
+                .WORD 372
+                .WORD 925
+                .WORD 45
+                .WORD 215
+                .WORD 867
+                .WORD 505
+                .WORD 948
+                .WORD 119
+                .WORD 266
+                .WORD 971
+                .WORD 220
+                .WORD 751
+                .WORD 74
+                .WORD 612
+                .WORD 836
+                .WORD 289
+                .WORD 24
+                .WORD 406
+                .WORD 904
+                .WORD 560
+                .WORD 180
+                .WORD 929
+                .WORD 55
+                .WORD 665
+                .WORD 646
+                .WORD 48
+                .WORD 30
+                .WORD 529
+                .WORD 614
+                .WORD 786
+                .WORD 680
+                .WORD 107
+    WORK:       .WORD 0         ; LEN words from here on.
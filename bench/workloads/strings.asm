@@ -0,0 +1,292 @@
+; Reverses a string in place, ROUNDS times, hashing it after every
+; pass (h = h * 31 + c). Then prints the string, the string reversed,
+; and the hash masked to 15 bits.
+;
+; The string comes from stdin (TRAP 0) when there is any, TEXT otherwise.
+; The expected output is for an empty stdin (< /dev/null).
+; Byte access to packed strings: SHR, AND and OR on every character.
+
+.CODE
+    LDI TEXT
+    LOAD OP_LOAD
+    ADD
+    STORE LD_TEXT
+    LDI BUF
+    INC
+    LOAD OP_LOAD
+    ADD
+    STORE LD_BUF1
+    LDI BUF
+    INC
+    LOAD OP_STORE
+    ADD
+    STORE ST_BUF1
+
+    LDI 0
+    LDI BUF
+    LOAD MAX_READ
+    TRAP 0
+    LDI 1
+    BP
+    JAL COPY_TEXT
+
+ROUND:
+    LOAD ROUNDS
+    LDI 1
+    BNZ
+    JMP DONE
+    JAL REVERSE
+    JAL HASH
+    LOAD ROUNDS
+    DEC
+    STORE ROUNDS
+    JMP ROUND
+
+DONE:
+    LDI 1
+    LDI BUF
+    TRAP 1
+    DROP
+    LDI 1
+    LDI NEWLINE
+    TRAP 1
+    DROP
+    JAL REVERSE
+    LDI 1
+    LDI BUF
+    TRAP 1
+    DROP
+    LDI 1
+    LDI NEWLINE
+    TRAP 1
+    DROP
+    LOAD H
+    LOAD MASK
+    AND
+    STORE NUM
+    JAL PRINT_NUM
+    TRAP 2
+
+; BUF = TEXT, length word included.
+COPY_TEXT:
+    LOAD TEXT
+    INC
+    LDI 1
+    SHR
+    INC
+    STORE I
+COPY_LOOP:
+    LOAD I
+    DEC
+    DUP
+    STORE I
+    LOAD LD_TEXT
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    LOAD I
+    LOAD ST_BUF1
+    DEC
+    ADD
+    STORE ST_SLOT
+    JAL ST_THUNK
+    LOAD I
+    LDI 1
+    BZ
+    JMP COPY_LOOP
+    RET
+
+; Swaps BUF[i] and BUF[j] until they meet.
+REVERSE:
+    LDI 0
+    STORE RI
+    LOAD BUF
+    DEC
+    STORE RJ
+R_LOOP:
+    LOAD RI
+    LOAD RJ
+    SUB
+    LDI 1
+    BN
+    RET
+    LOAD RI
+    JAL GETC
+    LOAD RJ
+    JAL GETC
+    LOAD RI
+    SWAP
+    JAL PUTC
+    LOAD RJ
+    SWAP
+    JAL PUTC
+    LOAD RI
+    INC
+    STORE RI
+    LOAD RJ
+    DEC
+    STORE RJ
+    JMP R_LOOP
+
+; H = H * 31 + c for every character of BUF.
+HASH:
+    LDI 0
+    STORE I
+H_LOOP:
+    LOAD I
+    LOAD BUF
+    SUB
+    LDI 1
+    BN
+    RET
+    LOAD I
+    JAL GETC
+    LOAD H
+    LDI 31
+    MULT
+    ADD
+    STORE H
+    LOAD I
+    INC
+    STORE I
+    JMP H_LOOP
+
+; [i] -> [BUF[i]], the high byte of a word comes first.
+GETC:
+    SWAP
+    DUP
+    LDI 1
+    SHR
+    LOAD LD_BUF1
+    ADD
+    STORE LD_SLOT
+    JAL LD_SLOT
+    SWAP
+    LDI 1
+    AND
+    LDI 2
+    BNZ
+    LDI 8
+    SHR
+    LDI 255
+    AND
+    SWAP
+    RET
+
+; [i, c] -> [], BUF[i] = c.
+PUTC:
+    SWAP
+    STORE CHAR
+    SWAP
+    DUP
+    LDI 1
+    SHR
+    DUP
+    LOAD LD_BUF1
+    ADD
+    STORE LD_SLOT
+    LOAD ST_BUF1
+    ADD
+    STORE ST_SLOT
+    JAL LD_SLOT
+    SWAP
+    LDI 1
+    AND
+    LDI 6
+    BNZ
+    ; Even: keep the low byte.
+    LDI 255
+    AND
+    LOAD CHAR
+    LDI 8
+    SHL
+    JMP PUT_MERGE
+    ; Odd: keep the high byte.
+    LOAD HIGH_MASK
+    AND
+    LOAD CHAR
+PUT_MERGE:
+    OR
+    JAL ST_THUNK
+    RET
+
+; Prints NUM (0 to 32767) as five digits and a newline.
+PRINT_NUM:
+    LOAD NUM
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LDI 10
+    OR
+    STORE NUM_W3
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W2
+    LDI 10
+    DIV
+    SWAP
+    LDI 48
+    ADD
+    STORE TMP
+    LDI 48
+    ADD
+    LDI 8
+    SHL
+    LOAD TMP
+    OR
+    STORE NUM_W1
+    LDI 1
+    LDI NUMBUF
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NUM:        .WORD 0
+    TMP:        .WORD 0
+    NUMBUF:     .WORD 6         ; "00000\n", filled in by PRINT_NUM.
+    NUM_W1:     .WORD 0x3030
+    NUM_W2:     .WORD 0x3030
+    NUM_W3:     .WORD 0x300A
+    NEWLINE:    .WORD 1
+                .WORD 0x0A00
+    OP_LOAD:    .WORD 0x5000
+    OP_STORE:   .WORD 0x6000
+    LD_SLOT:    .WORD 0x5000    ; LOAD x
+                .WORD 0x2000    ; SWAP
+                .WORD 0x9000    ; RET
+    ST_THUNK:   .WORD 0x2000    ; SWAP
+    ST_SLOT:    .WORD 0x6000    ; STORE x
+                .WORD 0x9000    ; RET
+    LD_TEXT:    .WORD 0
+    LD_BUF1:    .WORD 0         ; Both point at the first word of characters.
+    ST_BUF1:    .WORD 0
+    MASK:       .WORD 0x7FFF
+    HIGH_MASK:  .WORD 0xFF00
+    MAX_READ:   .WORD 400
+    ROUNDS:     .WORD 250
+    I:          .WORD 0
+    RI:         .WORD 0
+    RJ:         .WORD 0
+    CHAR:       .WORD 0
+    H:          .WORD 0
+    TEXT:       .STRING "The quick brown fox jumps over the lazy dog, then naps in the shade of an old oak tree. Pack my box with five dozen liquor jugs! How vexingly quick daft zebras jump, while sphinx of black quartz judges my vow. Waltz, bad nymph, for quick jigs vex. Bright vixens jump, dozy fowl quack. 0123456789 and back again: 9876543210."
+    BUF:        .WORD 0         ; Length, then up to 200 words, past the image.
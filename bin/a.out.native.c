@@ -0,0 +1,333 @@
+// Generated by paot from a.out.bin, do not edit.
+
+#include "aot_runtime.h"
+
+#define CODE_END 0x0053
+
+static const word_t IMAGE[197] = {
+    0x0053, 0x5008, 0x4001, 0x3003, 0x7014, 0x4000, 0x6009, 0x8017, 0x500B, 0x4001, 0x3003, 0x7009,
+    0x500C, 0x500A, 0x1000, 0x600C, 0x5009, 0x500B, 0x1000, 0x6009, 0x7FF2, 0x5008, 0x1006, 0x6008,
+    0x7FE8, 0x500C, 0x5007, 0x1009, 0x6001, 0x8008, 0xE002, 0x400D, 0x5009, 0x400A, 0xE00B, 0x600B,
+    0x600A, 0x9000, 0x5001, 0x400A, 0x1003, 0x2000, 0x4030, 0x1000, 0x4008, 0x100C, 0x400A, 0x100A,
+    0x6006, 0x400A, 0x1003, 0x2000, 0x4030, 0x1000, 0x6002, 0x400A, 0x1003, 0x2000, 0x4030, 0x1000,
+    0x4008, 0x100C, 0x5002, 0x100A, 0x6005, 0x400A, 0x1003, 0x2000, 0x4030, 0x1000, 0x6002, 0x4030,
+    0x1000, 0x4008, 0x100C, 0x5002, 0x100A, 0x6004, 0x4001, 0x4003, 0xE001, 0x2002, 0x9000, 0x0000,
+    0x0000, 0x0000, 0x0006, 0x3030, 0x3030, 0x300A, 0x7FFF, 0x01F4, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x00C7, 0x2D31, 0x3020, 0x3437, 0x3437, 0x202D, 0x3338, 0x3120, 0x3520, 0x2D34, 0x3538, 0x2032,
+    0x3738, 0x3231, 0x2031, 0x3436, 0x3330, 0x202D, 0x3332, 0x3520, 0x3837, 0x202D, 0x3934, 0x3533,
+    0x202D, 0x3131, 0x3834, 0x3420, 0x3234, 0x3430, 0x3520, 0x3339, 0x3020, 0x2D32, 0x3831, 0x202D,
+    0x3239, 0x3720, 0x2D31, 0x3632, 0x3820, 0x3533, 0x202D, 0x3233, 0x202D, 0x3437, 0x3937, 0x202D,
+    0x3130, 0x3920, 0x3332, 0x2035, 0x3020, 0x2D32, 0x3320, 0x2D34, 0x3530, 0x3620, 0x2D33, 0x3130,
+    0x3730, 0x2032, 0x3020, 0x2D32, 0x3533, 0x2033, 0x3032, 0x2037, 0x2031, 0x3433, 0x2031, 0x3620,
+    0x2D33, 0x3235, 0x3339, 0x2032, 0x3920, 0x2D39, 0x202D, 0x3237, 0x3320, 0x2D31, 0x3531, 0x3320,
+    0x3131, 0x3534, 0x2031, 0x3532, 0x3931, 0x202D, 0x3132, 0x3020, 0x2D32, 0x3720, 0x2D32, 0x3432,
+    0x2033, 0x202D, 0x3237, 0x202D, 0x3700,
+};
+
+static const word_t DYNAMIC[1] = { 0
+};
+
+// n/t are the two top words, v the top word as signed.
+#define BINARY(e) do { CHECK_STACK_UNDERFLOW(sp, 2); word_t t = MEMORY[sp++], n = MEMORY[sp]; \
+                       MEMORY[sp] = (word_t)(e); } while (0)
+#define UNARY(e)  do { CHECK_STACK_UNDERFLOW(sp, 1); sword_t v = (sword_t)MEMORY[sp]; \
+                       MEMORY[sp] = (word_t)(e); } while (0)
+#define DISPATCH(target) do { pc = (target); \
+                       goto *(pc < CODE_END ? LABELS[pc] : &&interpret); } while (0)
+#define STEP(addr) do { pc = (addr); goto interpret; } while (0)
+
+int main(void)
+{
+    aot_start(IMAGE, 197, CODE_END, DYNAMIC, 0);
+
+    static void *const LABELS[CODE_END > 0 ? CODE_END : 1] = {
+        [0] = &&interpret,
+        [0x0001] = &&L0001,
+        [0x0002] = &&L0002,
+        [0x0003] = &&L0003,
+        [0x0004] = &&L0004,
+        [0x0005] = &&L0005,
+        [0x0006] = &&L0006,
+        [0x0007] = &&L0007,
+        [0x0008] = &&L0008,
+        [0x0009] = &&L0009,
+        [0x000A] = &&L000A,
+        [0x000B] = &&L000B,
+        [0x000C] = &&L000C,
+        [0x000D] = &&L000D,
+        [0x000E] = &&L000E,
+        [0x000F] = &&L000F,
+        [0x0010] = &&L0010,
+        [0x0011] = &&L0011,
+        [0x0012] = &&L0012,
+        [0x0013] = &&L0013,
+        [0x0014] = &&L0014,
+        [0x0015] = &&L0015,
+        [0x0016] = &&L0016,
+        [0x0017] = &&L0017,
+        [0x0018] = &&L0018,
+        [0x0019] = &&L0019,
+        [0x001A] = &&L001A,
+        [0x001B] = &&L001B,
+        [0x001C] = &&L001C,
+        [0x001D] = &&L001D,
+        [0x001E] = &&L001E,
+        [0x001F] = &&L001F,
+        [0x0020] = &&L0020,
+        [0x0021] = &&L0021,
+        [0x0022] = &&L0022,
+        [0x0023] = &&L0023,
+        [0x0024] = &&L0024,
+        [0x0025] = &&L0025,
+        [0x0026] = &&L0026,
+        [0x0027] = &&L0027,
+        [0x0028] = &&L0028,
+        [0x0029] = &&L0029,
+        [0x002A] = &&L002A,
+        [0x002B] = &&L002B,
+        [0x002C] = &&L002C,
+        [0x002D] = &&L002D,
+        [0x002E] = &&L002E,
+        [0x002F] = &&L002F,
+        [0x0030] = &&L0030,
+        [0x0031] = &&L0031,
+        [0x0032] = &&L0032,
+        [0x0033] = &&L0033,
+        [0x0034] = &&L0034,
+        [0x0035] = &&L0035,
+        [0x0036] = &&L0036,
+        [0x0037] = &&L0037,
+        [0x0038] = &&L0038,
+        [0x0039] = &&L0039,
+        [0x003A] = &&L003A,
+        [0x003B] = &&L003B,
+        [0x003C] = &&L003C,
+        [0x003D] = &&L003D,
+        [0x003E] = &&L003E,
+        [0x003F] = &&L003F,
+        [0x0040] = &&L0040,
+        [0x0041] = &&L0041,
+        [0x0042] = &&L0042,
+        [0x0043] = &&L0043,
+        [0x0044] = &&L0044,
+        [0x0045] = &&L0045,
+        [0x0046] = &&L0046,
+        [0x0047] = &&L0047,
+        [0x0048] = &&L0048,
+        [0x0049] = &&L0049,
+        [0x004A] = &&L004A,
+        [0x004B] = &&L004B,
+        [0x004C] = &&L004C,
+        [0x004D] = &&L004D,
+        [0x004E] = &&L004E,
+        [0x004F] = &&L004F,
+        [0x0050] = &&L0050,
+        [0x0051] = &&L0051,
+        [0x0052] = &&L0052,
+    };
+
+    register word_t sp = REGS.SP;
+    register word_t lr = REGS.LR;
+    word_t pc;
+
+    DISPATCH(CODE_START);
+
+interpret:
+    REGS.SP = sp; REGS.LR = lr;
+    pc = aot_step(pc);
+    sp = REGS.SP; lr = REGS.LR;
+    DISPATCH(pc);
+
+L0001:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x005B];
+L0002:
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    { int taken = MEMORY[sp + 0] != 0; sp += 1;
+      if (taken) goto L0005; }
+    goto L0004;
+L0003:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    { word_t off = MEMORY[sp]; int taken = MEMORY[sp + 1] != 0; sp += 2;
+      if (taken) DISPATCH(0x0004 + sign_extend_12(off)); }
+L0004:
+    goto L0019;
+L0005:
+    MEMORY[--sp] = 0x0000;
+L0006:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x005C] = MEMORY[sp++];
+L0007:
+    CHECK_STACK_OVERFLOW(sp, 1); MEMORY[--sp] = lr; lr = 0x0008;
+    goto L001F;
+L0008:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x005E];
+L0009:
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    { int taken = MEMORY[sp + 0] != 0; sp += 1;
+      if (taken) goto L000C; }
+    goto L000B;
+L000A:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    { word_t off = MEMORY[sp]; int taken = MEMORY[sp + 1] != 0; sp += 2;
+      if (taken) DISPATCH(0x000B + sign_extend_12(off)); }
+L000B:
+    goto L0015;
+L000C:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x005F];
+L000D:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x005D];
+L000E:
+    BINARY(n + t);
+L000F:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x005F] = MEMORY[sp++];
+L0010:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x005C];
+L0011:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x005E];
+L0012:
+    BINARY(n + t);
+L0013:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x005C] = MEMORY[sp++];
+L0014:
+    goto L0007;
+L0015:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x005B];
+L0016:
+    UNARY(v - 1);
+L0017:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x005B] = MEMORY[sp++];
+L0018:
+    goto L0001;
+L0019:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x005F];
+L001A:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x005A];
+L001B:
+    BINARY(n & t);
+L001C:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x0054] = MEMORY[sp++];
+L001D:
+    CHECK_STACK_OVERFLOW(sp, 1); MEMORY[--sp] = lr; lr = 0x001E;
+    goto L0026;
+L001E:
+    REGS.SP = sp; REGS.LR = lr; aot_trap(2, 0x001E); sp = REGS.SP;
+L001F:
+    MEMORY[--sp] = 0x000D;
+L0020:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x005C];
+L0021:
+    MEMORY[--sp] = 0x000A;
+L0022:
+    REGS.SP = sp; REGS.LR = lr; aot_trap(11, 0x0022); sp = REGS.SP;
+L0023:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x005E] = MEMORY[sp++];
+L0024:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x005D] = MEMORY[sp++];
+L0025:
+    CHECK_STACK_UNDERFLOW(sp, 1); pc = lr; lr = MEMORY[sp++]; DISPATCH(pc);
+L0026:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x0054];
+L0027:
+    MEMORY[--sp] = 0x000A;
+L0028:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    { sword_t t = (sword_t)MEMORY[sp], n = (sword_t)MEMORY[sp + 1];
+      if (0 == t) aot_div_zero();
+      MEMORY[sp + 1] = (word_t)(n % t); MEMORY[sp] = (word_t)(n / t); }
+L0029:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    { word_t t = MEMORY[sp]; MEMORY[sp] = MEMORY[sp + 1]; MEMORY[sp + 1] = t; }
+L002A:
+    MEMORY[--sp] = 0x0030;
+L002B:
+    BINARY(n + t);
+L002C:
+    MEMORY[--sp] = 0x0008;
+L002D:
+    BINARY((sword_t)n << (sword_t)t);
+L002E:
+    MEMORY[--sp] = 0x000A;
+L002F:
+    BINARY(n | t);
+L0030:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x0059] = MEMORY[sp++];
+L0031:
+    MEMORY[--sp] = 0x000A;
+L0032:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    { sword_t t = (sword_t)MEMORY[sp], n = (sword_t)MEMORY[sp + 1];
+      if (0 == t) aot_div_zero();
+      MEMORY[sp + 1] = (word_t)(n % t); MEMORY[sp] = (word_t)(n / t); }
+L0033:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    { word_t t = MEMORY[sp]; MEMORY[sp] = MEMORY[sp + 1]; MEMORY[sp + 1] = t; }
+L0034:
+    MEMORY[--sp] = 0x0030;
+L0035:
+    BINARY(n + t);
+L0036:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x0055] = MEMORY[sp++];
+L0037:
+    MEMORY[--sp] = 0x000A;
+L0038:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    { sword_t t = (sword_t)MEMORY[sp], n = (sword_t)MEMORY[sp + 1];
+      if (0 == t) aot_div_zero();
+      MEMORY[sp + 1] = (word_t)(n % t); MEMORY[sp] = (word_t)(n / t); }
+L0039:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    { word_t t = MEMORY[sp]; MEMORY[sp] = MEMORY[sp + 1]; MEMORY[sp + 1] = t; }
+L003A:
+    MEMORY[--sp] = 0x0030;
+L003B:
+    BINARY(n + t);
+L003C:
+    MEMORY[--sp] = 0x0008;
+L003D:
+    BINARY((sword_t)n << (sword_t)t);
+L003E:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x0055];
+L003F:
+    BINARY(n | t);
+L0040:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x0058] = MEMORY[sp++];
+L0041:
+    MEMORY[--sp] = 0x000A;
+L0042:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    { sword_t t = (sword_t)MEMORY[sp], n = (sword_t)MEMORY[sp + 1];
+      if (0 == t) aot_div_zero();
+      MEMORY[sp + 1] = (word_t)(n % t); MEMORY[sp] = (word_t)(n / t); }
+L0043:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    { word_t t = MEMORY[sp]; MEMORY[sp] = MEMORY[sp + 1]; MEMORY[sp + 1] = t; }
+L0044:
+    MEMORY[--sp] = 0x0030;
+L0045:
+    BINARY(n + t);
+L0046:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x0055] = MEMORY[sp++];
+L0047:
+    MEMORY[--sp] = 0x0030;
+L0048:
+    BINARY(n + t);
+L0049:
+    MEMORY[--sp] = 0x0008;
+L004A:
+    BINARY((sword_t)n << (sword_t)t);
+L004B:
+    CHECK_STACK_OVERFLOW(sp, 1); sp--; MEMORY[sp] = MEMORY[0x0055];
+L004C:
+    BINARY(n | t);
+L004D:
+    CHECK_STACK_UNDERFLOW(sp, 1); MEMORY[0x0057] = MEMORY[sp++];
+L004E:
+    MEMORY[--sp] = 0x0001;
+L004F:
+    MEMORY[--sp] = 0x0003;
+L0050:
+    REGS.SP = sp; REGS.LR = lr; aot_trap(1, 0x0050); sp = REGS.SP;
+L0051:
+    CHECK_STACK_UNDERFLOW(sp, 1); sp++;
+L0052:
+    CHECK_STACK_UNDERFLOW(sp, 1); pc = lr; lr = MEMORY[sp++]; DISPATCH(pc);
+}
@@ -1,79 +1,406 @@
-
 #include "isa_defs.h"
 #include "string_utils.h"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 #ifndef NO_LOG
 #include <stdio.h>
 __attribute__((weak)) FILE *log_file = NULL;
+
+// The simulator has its own, which also writes out the trace.
+__attribute__((weak)) void close_log(void)
+{
+    if (log_file)
+        fclose(log_file);
+}
 #endif
 
 
 
-word_t str_pack(const char *str, word_t start_address)
+// **Byte swapping kernels**
+// "Hi" packs to 0x4869, which the host keeps as the bytes 69 48. Both
+// ways, characters to words and words to characters, a run of words is
+// just its byte pairs swapped. Only on a little-endian host, elsewhere
+// it's PACK_CHARS() and GET_CHAR_FROM_WORD() a word at a time.
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#   define SWAP_KERNELS 1
+#else
+#   define SWAP_KERNELS 0
+#endif
+
+typedef void swap_fn(void *dst, const void *src, size_t words);
+
+static void swap_scalar(void *dst, const void *src, size_t words)
 {
-    size_t len = strlen(str);
-    word_t words_written = 0;
+    const unsigned char *s = src;
+    unsigned char *d = dst;
+    for (size_t i = 0; i < words; i++)
+    {
+        unsigned char hi = s[2 * i + 1];
+        d[2 * i + 1] = s[2 * i];
+        d[2 * i]     = hi;
+    }
+}
 
-    // First, write the length of the string as the first word.
-    MEMORY[start_address] = (word_t)len;
-    words_written++;
+#if defined(__x86_64__)
 
-    for (size_t i = 0; i < len; i += 2)
+// No byte shuffle before SSSE3, a shift each way does it.
+static void swap_sse2(void *dst, const void *src, size_t words)
+{
+    const char *s = src;
+    char *d = dst;
+    size_t i = 0;
+
+    for (; i + 8 <= words; i += 8)
     {
-        char c1 = str[i];
-        char c2 = (i + 1 < len) ? str[i + 1] : 0;
-        
-        word_t packed_word = ((word_t)c1 << 8) | (word_t)c2;
-        MEMORY[start_address + words_written] = packed_word;
-        words_written++;
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + 2 * i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(d + 2 * i), v);
     }
-    
-    return words_written;
+    swap_scalar(d + 2 * i, s + 2 * i, words - i);
+}
+
+__attribute__((target("avx2")))
+static void swap_avx2(void *dst, const void *src, size_t words)
+{
+    const __m256i order = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                           1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const char *s = src;
+    char *d = dst;
+    size_t i = 0;
+
+    for (; i + 32 <= words; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s + 2 * i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s + 2 * i + 32));
+        _mm256_storeu_si256((__m256i *)(d + 2 * i),      _mm256_shuffle_epi8(a, order));
+        _mm256_storeu_si256((__m256i *)(d + 2 * i + 32), _mm256_shuffle_epi8(b, order));
+    }
+    for (; i + 16 <= words; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s + 2 * i));
+        _mm256_storeu_si256((__m256i *)(d + 2 * i), _mm256_shuffle_epi8(a, order));
+    }
+
+    // The rest stays in VEX code, calling swap_sse2() for it costs an
+    // AVX to SSE transition that takes longer than all of the above.
+    for (; i + 8 <= words; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s + 2 * i));
+        _mm_storeu_si128((__m128i *)(d + 2 * i), _mm_shuffle_epi8(a, _mm256_castsi256_si128(order)));
+    }
+    for (; i < words; i++)
+    {
+        char hi = s[2 * i + 1];
+        d[2 * i + 1] = s[2 * i];
+        d[2 * i]     = hi;
+    }
+}
+
+static int has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+static int always(void)
+{
+    return 1;
 }
 
+// Best first.
+static const struct
+{
+    const char *name;
+    swap_fn    *swap;
+    int       (*usable)(void);
+} KERNELS[] = {
+#if defined(__x86_64__)
+    { "avx2",   swap_avx2,   has_avx2 },
+    { "sse2",   swap_sse2,   always },
+#endif
+    { "scalar", swap_scalar, always },
+};
 
+#define KERNEL_COUNT ((int)(sizeof(KERNELS) / sizeof(KERNELS[0])))
 
-string_t str_unpack(word_t buf_offset)
+// Into KERNELS, picked on first use. That may be on several threads at
+// once (pvm --batch, pvmd), they all pick the same one.
+static int kernel = -1;
+
+
+
+static int pick_kernel(void)
 {
-    word_t addr = REGS.BR + buf_offset;
-    word_t count = MEMORY[addr]; // Read the length prefix.
-    
-    char *tmp = malloc(count + 1);
-    if (!tmp)
+    int k = 0;
+    while (!KERNELS[k].usable())
+        k++;
+    __atomic_store_n(&kernel, k, __ATOMIC_RELEASE);
+    return k;
+}
+
+
+
+int str_set_kernel(const char *name)
+{
+    for (int k = 0; k < KERNEL_COUNT; k++)
     {
-        perror("malloc");
-        CLOSE_LOG();
-        exit(EXIT_FAILURE);
+        if (0 == strcmp(name, KERNELS[k].name) && KERNELS[k].usable())
+        {
+            __atomic_store_n(&kernel, k, __ATOMIC_RELEASE);
+            return 0;
+        }
     }
+    return -1;
+}
 
-    // Start reading from the word *after* the length prefix.
-    for (word_t i = 0; i < count; i++)
+
+
+static int current_kernel(void)
+{
+    int k = __atomic_load_n(&kernel, __ATOMIC_ACQUIRE);
+    return k < 0 ? pick_kernel() : k;
+}
+
+
+
+static swap_fn *swap_words(void)
+{
+    return KERNELS[current_kernel()].swap;
+}
+
+
+
+const char *str_kernel(void)
+{
+    return KERNELS[current_kernel()].name;
+}
+
+
+
+// Shorter than this it's not worth a call through KERNELS.
+#define SHORT_WORDS 8
+
+// Both take words of memory from at on, carrying on at 0 past the end.
+static void chars_to_words(word_t *memory, word_t at, const char *chars, size_t words)
+{
+    if (!SWAP_KERNELS || words < SHORT_WORDS)
     {
-        char c = GET_CHAR_FROM_WORD(MEMORY[addr + 1 + i / 2], i);
-        tmp[i] = c;
+        for (size_t i = 0; i < words; i++)
+            memory[(word_t)(at + i)] = PACK_CHARS(chars[2 * i], chars[2 * i + 1]);
+        return;
     }
-    tmp[count] = '\0';
 
-    string_t res = { .str = tmp, .count = count };
-    return res;
+    swap_fn *swap = swap_words();
+    while (words > 0)
+    {
+        size_t run = (size_t)MEMORY_SIZE - at;
+        if (run > words)
+            run = words;
+        swap(memory + at, chars, run);
+        chars += 2 * run;
+        words -= run;
+        at    += run;
+    }
 }
 
+static void words_to_chars(char *chars, const word_t *memory, word_t at, size_t words)
+{
+    if (!SWAP_KERNELS || words < SHORT_WORDS)
+    {
+        for (size_t i = 0; i < words; i++)
+        {
+            word_t w = memory[(word_t)(at + i)];
+            chars[2 * i]     = GET_CHAR_FROM_WORD(w, 0);
+            chars[2 * i + 1] = GET_CHAR_FROM_WORD(w, 1);
+        }
+        return;
+    }
 
+    swap_fn *swap = swap_words();
+    while (words > 0)
+    {
+        size_t run = (size_t)MEMORY_SIZE - at;
+        if (run > words)
+            run = words;
+        swap(chars, memory + at, run);
+        chars += 2 * run;
+        words -= run;
+        at    += run;
+    }
+}
 
-void buf_pack(const char *buffer, word_t buf_offset, word_t count)
+
+
+// **Packed strings**
+
+word_t str_pack(word_t *memory, const char *str, word_t start_address)
 {
-    word_t addr = REGS.BR + buf_offset;
+    word_t count = (word_t)strlen(str);
+    buf_pack(memory, start_address, str, count);
+
+    // The length word, then two characters a word.
+    return 1 + (count + 1) / 2;
+}
+
 
+
+word_t str_unpack(const word_t *memory, word_t addr, char *buffer, size_t size)
+{
+    word_t count = memory[addr]; // Read the length prefix.
+    if (0 == size)
+        return count;
+
+    word_t n = count < size ? count : (word_t)(size - 1);
+    buf_unpack(memory, addr, buffer, 0, n);
+    buffer[n] = '\0';
+    return count;
+}
+
+
+
+void buf_pack(word_t *memory, word_t addr, const char *buffer, word_t count)
+{
     // First, write the number of bytes read as the length prefix.
-    MEMORY[addr] = count;
+    memory[addr] = count;
+
+    // Then the content, from the next word. An odd one out gets a 0 low byte.
+    word_t at = addr + 1;
+    chars_to_words(memory, at, buffer, count / 2);
+    if (count % 2)
+        memory[(word_t)(at + count / 2)] = PACK_CHARS(buffer[count - 1], 0);
+}
 
-    // Start writing the buffer content from the next word.
-    for (word_t i = 0; i < count; i++)
+
+
+void buf_unpack(const word_t *memory, word_t addr, char *buffer, word_t from, word_t count)
+{
+    // Start reading from the word *after* the length prefix.
+    word_t at = addr + 1 + from / 2;
+    word_t i = 0;
+
+    if (from % 2 && count > 0)
+        buffer[i++] = GET_CHAR_FROM_WORD(memory[at++], 1);
+
+    word_t words = (count - i) / 2;
+    words_to_chars(buffer + i, memory, at, words);
+    i  += 2 * words;
+    at += words;
+
+    if (i < count)
+        buffer[i] = GET_CHAR_FROM_WORD(memory[at], 0);
+}
+
+
+
+// **Numbers**
+
+// The longest is -32768 in base 2.
+#define MAX_DIGITS 17
+
+static const char DIGITS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+// Base 10 two digits a division, "00" to "99".
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// A digit's value plus 1, 0 for anything else. Either case.
+static const unsigned char DIGIT_VALUES[256] = {
+    ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,
+    ['5'] = 6,  ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16, ['G'] = 17,
+    ['H'] = 18, ['I'] = 19, ['J'] = 20, ['K'] = 21, ['L'] = 22, ['M'] = 23, ['N'] = 24,
+    ['O'] = 25, ['P'] = 26, ['Q'] = 27, ['R'] = 28, ['S'] = 29, ['T'] = 30, ['U'] = 31,
+    ['V'] = 32, ['W'] = 33, ['X'] = 34, ['Y'] = 35, ['Z'] = 36,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16, ['g'] = 17,
+    ['h'] = 18, ['i'] = 19, ['j'] = 20, ['k'] = 21, ['l'] = 22, ['m'] = 23, ['n'] = 24,
+    ['o'] = 25, ['p'] = 26, ['q'] = 27, ['r'] = 28, ['s'] = 29, ['t'] = 30, ['u'] = 31,
+    ['v'] = 32, ['w'] = 33, ['x'] = 34, ['y'] = 35, ['z'] = 36,
+};
+
+
+
+word_t str_format_word(word_t *memory, word_t addr, word_t value, int base, int is_signed)
+{
+    char digits[MAX_DIGITS];
+    char *end = digits + MAX_DIGITS, *p = end;
+
+    int negative = is_signed && (sword_t)value < 0;
+    unsigned v = negative ? 0u - (sword_t)value : value;
+
+    // Back to front.
+    if (10 == base)
     {
-        word_t idx = (i / 2) + 1;
-        if (0 == i % 2)
-            MEMORY[addr + idx] = (buffer[i] & 0xFF) << 8;
+        for (; v >= 100; v /= 100)
+        {
+            p -= 2;
+            memcpy(p, DIGIT_PAIRS + 2 * (v % 100), 2);
+        }
+        if (v >= 10)
+        {
+            p -= 2;
+            memcpy(p, DIGIT_PAIRS + 2 * v, 2);
+        }
         else
-            MEMORY[addr + idx] |= (buffer[i] & 0xFF);
+            *--p = DIGITS[v];
+    }
+    else if (0 == (base & (base - 1)))
+    {
+        int shift = __builtin_ctz(base);
+        do
+            *--p = DIGITS[v & (base - 1)];
+        while (v >>= shift);
+    }
+    else
+    {
+        do
+            *--p = DIGITS[v % base];
+        while (v /= base);
+    }
+
+    if (negative)
+        *--p = '-';
+
+    word_t count = (word_t)(end - p);
+    buf_pack(memory, addr, p, count);
+    return count;
+}
+
+
+
+word_t str_parse_word(const word_t *memory, word_t addr, word_t from, int base, word_t *value)
+{
+    word_t length = memory[addr];
+    word_t i = from;
+
+#   define CHAR_AT(i) ((unsigned char)GET_CHAR_FROM_WORD(memory[(word_t)(addr + 1 + (i) / 2)], (i) % 2))
+
+    while (i < length && (' ' == CHAR_AT(i) || '\t' == CHAR_AT(i) || '\n' == CHAR_AT(i) || '\r' == CHAR_AT(i)))
+        i++;
+
+    int negative = i < length && '-' == CHAR_AT(i);
+    if (i < length && ('-' == CHAR_AT(i) || '+' == CHAR_AT(i)))
+        i++;
+
+    word_t first = i;
+    word_t v = 0;
+    for (unsigned d; i < length && (d = DIGIT_VALUES[CHAR_AT(i)]) != 0 && d <= (unsigned)base; i++)
+        v = v * base + d - 1;
+
+#   undef CHAR_AT
+
+    if (i == first)
+    {
+        *value = 0;
+        return 0;
     }
+    *value = negative ? (word_t)-v : v;
+    return i - from;
 }
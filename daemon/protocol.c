@@ -0,0 +1,134 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pvmd.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+
+// The pvmd wire protocol, see pvmd.h. Shared by pvmd, pvmc and pload.
+
+uint64_t pvmd_image_id(const void *image, size_t bytes)
+{
+    if (bytes > PVMD_MAX_IMAGE)
+        bytes = PVMD_MAX_IMAGE;
+    bytes &= ~(size_t)1;
+
+    const unsigned char *p = image;
+    uint64_t h = 14695981039346656037ull;   // FNV-1a
+    for (size_t i = 0; i < bytes; i++)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+
+
+int pvmd_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (-1 == fd)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+
+
+int pvmd_send(int fd, uint32_t type, const void *a, size_t a_size,
+              const void *b, size_t b_size)
+{
+    PvmdFrame frame = { type, (uint32_t)(a_size + b_size) };
+    struct iovec iov[3] = {
+        { &frame, sizeof(frame) },
+        { (void *)a, a_size },
+        { (void *)b, b_size }
+    };
+    int count = 3;
+    struct iovec *next = iov;
+
+    // Short writes are only likely with big payloads, pick up from there.
+    while (count > 0)
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov    = next;
+        msg.msg_iovlen = count;
+
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            return -1;
+        }
+
+        while (count > 0 && (size_t)n >= next->iov_len)
+        {
+            n -= next->iov_len;
+            next++;
+            count--;
+        }
+        if (count > 0)
+        {
+            next->iov_base = (char *)next->iov_base + n;
+            next->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+
+
+static int read_all(int fd, void *buf, size_t size)
+{
+    char *p = buf;
+    while (size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && EINTR == errno)
+            continue;
+        if (n <= 0)
+        {
+            if (0 == n)
+                errno = 0;
+            return -1;
+        }
+        p    += n;
+        size -= n;
+    }
+    return 0;
+}
+
+
+
+int pvmd_recv(int fd, PvmdFrame *frame, void *buf, size_t size)
+{
+    if (read_all(fd, frame, sizeof(*frame)) != 0)
+        return -1;
+    if (frame->length > size)
+    {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    return read_all(fd, buf, frame->length);
+}
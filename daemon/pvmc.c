@@ -0,0 +1,184 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pvmd.h"
+#include "isa_defs.h"
+#include <errno.h>
+#include <unistd.h>
+
+
+
+// pvmc: runs an image on pvmd, with this process's stdin, stdout and
+// stderr, and exits the way pvm would have.
+
+static char image[PVMD_MAX_IMAGE];
+static char request[PVMD_MAX_INPUT];     // The guest's stdin.
+static char reply[PVMD_MAX_FRAME];
+
+
+
+static size_t read_input(char *buf, size_t size)
+{
+    size_t total = 0;
+    while (total < size)
+    {
+        ssize_t n = read(STDIN_FILENO, buf + total, size - total);
+        if (n < 0 && EINTR == errno)
+            continue;
+        if (n <= 0)
+            break;
+        total += n;
+    }
+    return total;
+}
+
+
+
+static int write_all(int fd, const char *buf, size_t count)
+{
+    while (count > 0)
+    {
+        ssize_t n = write(fd, buf, count);
+        if (n < 0 && EINTR == errno)
+            continue;
+        if (n <= 0)
+            return -1;
+        buf   += n;
+        count -= n;
+    }
+    return 0;
+}
+
+
+
+// Asks for one run and passes its output on. 1 once it's done, 0 if pvmd
+// doesn't have the image, -1 if pvmd refused or went away.
+static int run_once(int fd, const PvmdRun *run, size_t input_size, PvmdDone *done)
+{
+    if (pvmd_send(fd, PVMD_RUN, run, sizeof(*run), request, input_size) != 0)
+        return -1;
+
+    PvmdFrame frame;
+    while (0 == pvmd_recv(fd, &frame, reply, sizeof(reply)))
+    {
+        switch (frame.type)
+        {
+            case PVMD_STDOUT:
+            case PVMD_STDERR:
+                write_all(PVMD_STDOUT == frame.type ? STDOUT_FILENO : STDERR_FILENO,
+                          reply, frame.length);
+                break;
+
+            case PVMD_DONE:
+                memcpy(done, reply, sizeof(*done));
+                return 1;
+
+            case PVMD_UNKNOWN:
+                return 0;
+
+            case PVMD_REFUSED:
+                fprintf(stderr, "pvmd refused: %.*s\n", (int)frame.length, reply);
+                return -1;
+
+            default:
+                fprintf(stderr, "pvmd sent something odd (%u)\n", frame.type);
+                return -1;
+        }
+    }
+
+    fprintf(stderr, "Lost pvmd: %s\n", errno ? strerror(errno) : "connection closed");
+    return -1;
+}
+
+
+
+static int put_image(int fd, size_t image_size)
+{
+    PvmdFrame frame;
+    if (pvmd_send(fd, PVMD_PUT, image, image_size, NULL, 0) != 0 ||
+        pvmd_recv(fd, &frame, reply, sizeof(reply)) != 0)
+    {
+        fprintf(stderr, "Lost pvmd: %s\n", errno ? strerror(errno) : "connection closed");
+        return -1;
+    }
+    if (PVMD_IMAGE != frame.type)
+    {
+        fprintf(stderr, "pvmd didn't take the image: %.*s\n", (int)frame.length, reply);
+        return -1;
+    }
+    return 0;
+}
+
+
+
+int main(int argc, char **argv)
+{
+    const char *socket_path = PVMD_SOCKET;
+    const char *image_path = NULL;
+    PvmdRun run = { 0, 0 };
+    int usage = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strncmp(argv[i], "--socket=", 9) && argv[i][9])
+            socket_path = argv[i] + 9;
+        else if (0 == strncmp(argv[i], "--gas=", 6) && atoll(argv[i] + 6) > 0)
+            run.gas = (uint64_t)atoll(argv[i] + 6);
+        else if ('-' != argv[i][0] && NULL == image_path)
+            image_path = argv[i];
+        else
+            usage = 1;
+    }
+    if (usage || NULL == image_path)
+    {
+        fprintf(stderr, "Usage: %s [--socket=PATH] [--gas=N] IMAGE\n", argv[0]);
+        fprintf(stderr, "  Runs IMAGE on pvmd with this stdin and stdout.\n");
+        fprintf(stderr, "  --socket=PATH: Where pvmd listens (default %s)\n", PVMD_SOCKET);
+        fprintf(stderr, "  --gas=N:       Stop it after N gas (default pvmd's limit)\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *f = fopen(image_path, "rb");
+    if (NULL == f)
+    {
+        perror(image_path);
+        return EXIT_FAILURE;
+    }
+    size_t image_size = fread(image, 1, sizeof(image), f);
+    fclose(f);
+    if (0 == image_size)
+    {
+        fprintf(stderr, "%s is empty\n", image_path);
+        return EXIT_FAILURE;
+    }
+
+    run.image = pvmd_image_id(image, image_size);
+    size_t input_size = read_input(request, PVMD_MAX_INPUT);
+
+    int fd = pvmd_connect(socket_path);
+    if (-1 == fd)
+    {
+        fprintf(stderr, "Can't reach pvmd on %s: %s\n", socket_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // Only sends the image if pvmd doesn't have it yet.
+    PvmdDone done;
+    int r = run_once(fd, &run, input_size, &done);
+    if (0 == r && 0 == put_image(fd, image_size))
+        r = run_once(fd, &run, input_size, &done);
+    close(fd);
+
+    if (r <= 0)
+    {
+        if (0 == r)
+            fprintf(stderr, "pvmd lost the image\n");
+        return EXIT_FAILURE;
+    }
+
+    if (PVM_ERROR == done.status)
+        fprintf(stderr, "%s\n", done.error);
+    else if (PVM_OUT_OF_GAS == done.status)
+        fprintf(stderr, "Out of gas after %llu instructions\n",
+                (unsigned long long)done.instructions);
+    return done.exit_code;
+}
@@ -0,0 +1,608 @@
+#define _GNU_SOURCE
+
+#include "pvmd.h"
+#include "pinnacle.h"
+#include "isa_defs.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+
+// pvmd: keeps VMs and images resident and runs what clients ask for, see
+// pvmd.h for the protocol.
+//
+// One dispatcher thread polls the listening socket and every idle
+// connection. A connection with a request waiting goes to a pool of
+// workers, each with its own VM; the worker answers that one request and
+// hands the connection back. So a client that keeps its connection open
+// doesn't tie up a worker in between requests.
+
+#define MAX_IMAGES        256
+#define MAX_CONNECTIONS   1024
+#define DEFAULT_GAS       1000000000ull     // Nothing runs forever.
+#define DEFAULT_OUTPUT    (1 << 20)
+#define RECEIVE_TIMEOUT   5                 // Seconds, for a request to arrive whole.
+#define TRAP_WRITE        1
+
+typedef struct
+{
+    uint64_t    id;
+    pvm_image  *image;
+    uint64_t    used;       // For evicting the least recently used one.
+} CachedImage;
+
+typedef struct
+{
+    pvm_vm     *vm;
+    char       *buffer;     // PVMD_MAX_FRAME, the request being served.
+    pthread_t   thread;
+} Worker;
+
+// What a run's I/O hooks need.
+typedef struct
+{
+    pvm_vm     *vm;
+    int         fd;
+    const char *input;
+    size_t      input_left;
+    size_t      output_left;
+    const char *failed;     // Why output stopped going out.
+} Run;
+
+static const char *socket_path = PVMD_SOCKET;
+static uint64_t    max_gas     = DEFAULT_GAS;
+static size_t      max_output  = DEFAULT_OUTPUT;
+
+static CachedImage      images[MAX_IMAGES];
+static int              image_count = 0;
+static uint64_t         image_clock = 0;
+static pthread_rwlock_t images_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+// Connections with a request waiting, for the workers.
+static int              ready[MAX_CONNECTIONS];
+static int              ready_head = 0;
+static int              ready_count = 0;
+// Connections the workers are done with, for the dispatcher.
+static int              returned[MAX_CONNECTIONS];
+static int              returned_count = 0;
+static int              stopping = 0;
+static pthread_mutex_t  queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   queue_cond = PTHREAD_COND_INITIALIZER;
+
+static int              wake_pipe[2] = { -1, -1 };
+static volatile sig_atomic_t got_signal = 0;
+static uint64_t         requests = 0;
+
+
+
+// **Image cache**
+
+// The caller holds images_lock, either way.
+static CachedImage *find_image(uint64_t id)
+{
+    for (int i = 0; i < image_count; i++)
+        if (images[i].id == id)
+            return &images[i];
+    return NULL;
+}
+
+
+
+// Loads the VM with image id. 0 if it isn't cached, -1 if it couldn't be
+// mapped. The VM holds on to the image, so it may be evicted right after.
+static int map_cached(pvm_vm *vm, uint64_t id)
+{
+    pthread_rwlock_rdlock(&images_lock);
+    CachedImage *c = find_image(id);
+    int mapped = 0;
+    if (c)
+    {
+        __atomic_store_n(&c->used, __atomic_add_fetch(&image_clock, 1, __ATOMIC_RELAXED),
+                         __ATOMIC_RELAXED);
+        mapped = pvm_map_image(vm, c->image) == 0 ? 1 : -1;
+    }
+    pthread_rwlock_unlock(&images_lock);
+    return mapped;
+}
+
+
+
+static int put_image(const void *image, size_t bytes, uint64_t *id)
+{
+    *id = pvmd_image_id(image, bytes);
+
+    pthread_rwlock_wrlock(&images_lock);
+    if (find_image(*id))
+    {
+        pthread_rwlock_unlock(&images_lock);
+        return 0;
+    }
+
+    pvm_image *loaded = pvm_image_create(image, bytes);
+    if (NULL == loaded)
+    {
+        pthread_rwlock_unlock(&images_lock);
+        return -1;
+    }
+
+    CachedImage *slot = &images[image_count];
+    if (MAX_IMAGES == image_count)
+    {
+        // Full, out goes the one that ran longest ago. VMs on it keep it.
+        slot = &images[0];
+        for (int i = 1; i < image_count; i++)
+            if (images[i].used < slot->used)
+                slot = &images[i];
+        pvm_image_destroy(slot->image);
+    }
+    else
+    {
+        image_count++;
+    }
+
+    slot->id    = *id;
+    slot->image = loaded;
+    slot->used  = __atomic_add_fetch(&image_clock, 1, __ATOMIC_RELAXED);
+    pthread_rwlock_unlock(&images_lock);
+    return 0;
+}
+
+
+
+// **Guest I/O**
+// stdin is what came with the request, stdout and stderr go back to the
+// client as the guest writes them. Guests get no files of their own.
+
+static long run_read(void *user, int fd, void *buf, size_t count)
+{
+    Run *run = user;
+    if (fd != 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    if (count > run->input_left)
+        count = run->input_left;
+    memcpy(buf, run->input, count);
+    run->input      += count;
+    run->input_left -= count;
+    return (long)count;
+}
+
+
+
+// Once output can't go out, the run stops at its next write.
+static long run_write(void *user, int fd, const void *buf, size_t count)
+{
+    Run *run = user;
+    if (fd != 1 && fd != 2)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (NULL == run->failed && count > run->output_left)
+        run->failed = "Output limit reached";
+    else if (NULL == run->failed &&
+             pvmd_send(run->fd, 1 == fd ? PVMD_STDOUT : PVMD_STDERR, buf, count, NULL, 0) != 0)
+        run->failed = "Client went away";
+
+    if (run->failed)
+    {
+        pvm_break_on_trap(run->vm, TRAP_WRITE);
+        errno = EPIPE;
+        return -1;
+    }
+    run->output_left -= count;
+    return (long)count;
+}
+
+
+
+static int run_open(void *user, const char *path, int flags)
+{
+    (void)user;
+    (void)path;
+    (void)flags;
+    errno = EACCES;
+    return -1;
+}
+
+
+
+static int run_close(void *user, int fd)
+{
+    (void)user;
+    (void)fd;
+    errno = EBADF;
+    return -1;
+}
+
+
+
+// **Requests**
+
+static int refuse(int fd, const char *why)
+{
+    pvmd_send(fd, PVMD_REFUSED, why, strlen(why), NULL, 0);
+    return -1;
+}
+
+
+
+static int serve_run(Worker *w, int fd, const PvmdFrame *frame)
+{
+    if (frame->length < sizeof(PvmdRun))
+        return refuse(fd, "Short run request");
+
+    PvmdRun request;
+    memcpy(&request, w->buffer, sizeof(request));
+
+    int mapped = map_cached(w->vm, request.image);
+    if (0 == mapped)
+        return pvmd_send(fd, PVMD_UNKNOWN, &request.image, sizeof(request.image), NULL, 0);
+    if (mapped < 0)
+        return refuse(fd, "Can't map the image");
+
+    Run run;
+    run.vm          = w->vm;
+    run.fd          = fd;
+    run.input       = w->buffer + sizeof(PvmdRun);
+    run.input_left  = frame->length - sizeof(PvmdRun);
+    run.output_left = max_output;
+    run.failed      = NULL;
+
+    pvm_io io = { &run, run_read, run_write, run_open, run_close };
+    pvm_set_io(w->vm, &io);
+    pvm_set_gas(w->vm, request.gas && request.gas < max_gas ? request.gas : max_gas);
+    pvm_break_on_trap(w->vm, -1);
+
+    PvmdDone done;
+    memset(&done, 0, sizeof(done));
+    done.status       = pvm_run(w->vm, 0);
+    done.instructions = pvm_instructions(w->vm);
+    done.gas          = pvm_gas_used(w->vm);
+
+    if (run.failed)
+    {
+        done.status = PVM_ERROR;
+        snprintf(done.error, sizeof(done.error), "%s", run.failed);
+    }
+
+    switch (done.status)
+    {
+        case PVM_EXITED:
+            done.exit_code = (exitcode_t)pvm_exit_status(w->vm);
+            break;
+        case PVM_HALTED:
+            done.exit_code = EXIT_SUCCESS;
+            break;
+        case PVM_ERROR:
+            done.exit_code = EXIT_FAILURE;
+            if (NULL == run.failed)
+                snprintf(done.error, sizeof(done.error), "%s", pvm_error(w->vm));
+            break;
+        default:
+            done.exit_code = EXIT_FAILURE;
+            break;
+    }
+
+    __atomic_add_fetch(&requests, 1, __ATOMIC_RELAXED);
+    return pvmd_send(fd, PVMD_DONE, &done, sizeof(done), NULL, 0);
+}
+
+
+
+// One request off fd. -1 if the connection should be closed.
+static int serve(Worker *w, int fd)
+{
+    PvmdFrame frame;
+    if (pvmd_recv(fd, &frame, w->buffer, PVMD_MAX_FRAME) != 0)
+        return EMSGSIZE == errno ? refuse(fd, "Request too big") : -1;
+
+    switch (frame.type)
+    {
+        case PVMD_PUT:
+        {
+            uint64_t id;
+            if (0 == frame.length || frame.length > PVMD_MAX_IMAGE)
+                return refuse(fd, "Bad image size");
+            if (put_image(w->buffer, frame.length, &id) != 0)
+                return refuse(fd, "Can't load the image");
+            return pvmd_send(fd, PVMD_IMAGE, &id, sizeof(id), NULL, 0);
+        }
+
+        case PVMD_RUN:
+            return serve_run(w, fd, &frame);
+
+        default:
+            return refuse(fd, "Unknown request");
+    }
+}
+
+
+
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&queue_lock);
+        while (0 == ready_count && !stopping)
+            pthread_cond_wait(&queue_cond, &queue_lock);
+        if (0 == ready_count)
+        {
+            pthread_mutex_unlock(&queue_lock);
+            return NULL;
+        }
+        int fd = ready[ready_head];
+        ready_head = (ready_head + 1) % MAX_CONNECTIONS;
+        ready_count--;
+        pthread_mutex_unlock(&queue_lock);
+
+        // Closed ones go back as -1, so the dispatcher can count them.
+        if (serve(w, fd) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+
+        pthread_mutex_lock(&queue_lock);
+        returned[returned_count++] = fd;
+        pthread_mutex_unlock(&queue_lock);
+        char c = 0;
+        while (write(wake_pipe[1], &c, 1) < 0 && EINTR == errno)
+            ;
+    }
+}
+
+
+
+// **Dispatcher**
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    got_signal = 1;
+    char c = 0;
+    ssize_t ignored = write(wake_pipe[1], &c, 1);
+    (void)ignored;
+}
+
+
+
+static int listen_on(const char *path)
+{
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (-1 == fd)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    // A socket left behind by a pvmd that didn't get to clean up.
+    int probe = pvmd_connect(path);
+    if (probe >= 0)
+    {
+        close(probe);
+        fprintf(stderr, "pvmd is already running on %s\n", path);
+        close(fd);
+        return -1;
+    }
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0)
+    {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+
+static void dispatch(int listen_fd)
+{
+    static int idle[MAX_CONNECTIONS];
+    static struct pollfd fds[MAX_CONNECTIONS + 2];
+    int idle_count = 0;
+    int busy = 0;       // With the workers.
+
+    while (!got_signal)
+    {
+        fds[0].fd = listen_fd;
+        fds[0].events = idle_count + busy < MAX_CONNECTIONS ? POLLIN : 0;
+        fds[1].fd = wake_pipe[0];
+        fds[1].events = POLLIN;
+        for (int i = 0; i < idle_count; i++)
+        {
+            fds[i + 2].fd = idle[i];
+            fds[i + 2].events = POLLIN;
+        }
+
+        int polled = idle_count;
+        if (poll(fds, polled + 2, -1) < 0)
+        {
+            if (EINTR == errno)
+                continue;
+            perror("poll");
+            return;
+        }
+
+        // Walked backwards, so the one moved into a handed over slot has
+        // already been looked at.
+        int handed = 0;
+        for (int i = polled - 1; i >= 0; i--)
+        {
+            if (0 == fds[i + 2].revents)
+                continue;
+            pthread_mutex_lock(&queue_lock);
+            ready[(ready_head + ready_count++) % MAX_CONNECTIONS] = idle[i];
+            pthread_mutex_unlock(&queue_lock);
+            idle[i] = idle[--idle_count];
+            busy++;
+            handed++;
+        }
+        if (handed)
+            pthread_cond_broadcast(&queue_cond);
+
+        if (fds[1].revents)
+        {
+            char drain[64];
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0)
+                ;
+            pthread_mutex_lock(&queue_lock);
+            for (int i = 0; i < returned_count; i++)
+                if (returned[i] >= 0)
+                    idle[idle_count++] = returned[i];
+            busy -= returned_count;
+            returned_count = 0;
+            pthread_mutex_unlock(&queue_lock);
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (fd >= 0)
+            {
+                // A request that starts arriving has this long to finish.
+                struct timeval timeout = { RECEIVE_TIMEOUT, 0 };
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                idle[idle_count++] = fd;
+            }
+        }
+    }
+
+    for (int i = 0; i < idle_count; i++)
+        close(idle[i]);
+}
+
+
+
+int main(int argc, char **argv)
+{
+    int threads = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strncmp(argv[i], "--socket=", 9) && argv[i][9])
+        {
+            socket_path = argv[i] + 9;
+        }
+        else if (0 == strncmp(argv[i], "--threads=", 10) && atoi(argv[i] + 10) > 0)
+        {
+            threads = atoi(argv[i] + 10);
+        }
+        else if (0 == strncmp(argv[i], "--gas=", 6) && atoll(argv[i] + 6) > 0)
+        {
+            max_gas = (uint64_t)atoll(argv[i] + 6);
+        }
+        else if (0 == strncmp(argv[i], "--max-output=", 13) && atoll(argv[i] + 13) > 0)
+        {
+            max_output = (size_t)atoll(argv[i] + 13);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--socket=PATH] [--threads=N] [--gas=N] [--max-output=BYTES]\n", argv[0]);
+            fprintf(stderr, "  --socket=PATH:      Where to listen (default %s)\n", PVMD_SOCKET);
+            fprintf(stderr, "  --threads=N:        Worker threads (default: one per CPU)\n");
+            fprintf(stderr, "  --gas=N:            Most gas a run may use (default %llu)\n", DEFAULT_GAS);
+            fprintf(stderr, "  --max-output=BYTES: Most a run may write (default %d)\n", DEFAULT_OUTPUT);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (pipe2(wake_pipe, O_CLOEXEC | O_NONBLOCK) != 0)
+    {
+        perror("pipe");
+        return EXIT_FAILURE;
+    }
+
+    int listen_fd = listen_on(socket_path);
+    if (-1 == listen_fd)
+        return EXIT_FAILURE;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    Worker *workers = calloc(threads, sizeof(Worker));
+    if (NULL == workers)
+    {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        workers[i].vm     = pvm_create();
+        workers[i].buffer = malloc(PVMD_MAX_FRAME);
+        if (NULL == workers[i].vm || NULL == workers[i].buffer)
+        {
+            perror("FATAL: Could not set up the workers");
+            return EXIT_FAILURE;
+        }
+        int err = pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+        if (err != 0)
+        {
+            fprintf(stderr, "FATAL: pthread_create: %s\n", strerror(err));
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("** pvmd on %s with %d threads **\n", socket_path, threads);
+    fflush(stdout);
+
+    dispatch(listen_fd);
+
+    // Runs in progress finish, the connections waiting are dropped.
+    pthread_mutex_lock(&queue_lock);
+    stopping = 1;
+    for (; ready_count > 0; ready_count--, ready_head = (ready_head + 1) % MAX_CONNECTIONS)
+        close(ready[ready_head]);
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        pvm_destroy(workers[i].vm);
+        free(workers[i].buffer);
+    }
+    free(workers);
+    for (int i = 0; i < returned_count; i++)
+        if (returned[i] >= 0)
+            close(returned[i]);
+
+    close(listen_fd);
+    unlink(socket_path);
+    for (int i = 0; i < image_count; i++)
+        pvm_image_destroy(images[i].image);
+
+    printf("** pvmd: %llu runs, %d images cached **\n", (unsigned long long)requests, image_count);
+    return EXIT_SUCCESS;
+}
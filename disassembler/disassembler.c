@@ -1,5 +1,7 @@
 
 #include "isa_defs.h"
+#include "trace.h"
+#include "profile.h"
 #include <ctype.h>
 
 
@@ -43,6 +45,174 @@ const char* branch_map[] = {
     [FUNC_BNZ] = "BNZ", [FUNC_BN] = "BN",   [FUNC_BP] = "BP"
 };
 
+// Opcodes without a func code.
+const char* op_map[16] = {
+    [OP_LDI] = "LDI", [OP_LOAD] = "LOAD", [OP_STORE] = "STORE",
+    [OP_JMP] = "JMP", [OP_JAL]  = "JAL",  [OP_RET]   = "RET",
+    [OP_TRAP] = "TRAP", [OP_HALT] = "HALT"
+};
+
+
+
+// Prints the mnemonic and operand, nothing else.
+void print_instruction(Instruction instr)
+{
+    uint16_t opcode = instr.fields.opcode;
+    uint16_t arg    = instr.fields.arg;
+
+    switch (__builtin_expect(opcode, OP_LDI))
+    {
+        case OP_ALU_LOGIC:
+            printf("%s", arg < ALU_FUNC_COUNT ? alu_map[arg] : "ILLEGAL");
+            break;
+        case OP_STACK_OPS:
+            printf("%s", arg < STACK_FUNC_COUNT ? stack_op_map[arg] : "ILLEGAL");
+            break;
+        case OP_BRANCH:
+            printf("%s", arg < BRANCH_FUNC_COUNT ? branch_map[arg] : "ILLEGAL");
+            break;
+        case OP_LDI:
+            printf("LDI %d", sign_extend_12(arg));
+            break;
+        case OP_LOAD:
+            printf("LOAD %d", sign_extend_12(arg));
+            break;
+        case OP_STORE:
+            printf("STORE %d", sign_extend_12(arg));
+            break;
+        case OP_JMP:
+            printf("JMP %d", sign_extend_12(arg));
+            break;
+        case OP_JAL:
+            printf("JAL %d", sign_extend_12(arg));
+            break;
+        case OP_TRAP:
+            printf("TRAP %d", arg);
+            break;
+        case OP_RET:
+            printf("RET");
+            break;
+        case OP_HALT:
+            printf("HALT");
+            break;
+        case OP_ILLEGAL:
+        default:
+            printf("ILLEGAL");
+            break;
+    }
+}
+
+
+
+// Renders a binary trace written by pvm (see trace.h).
+int print_trace(const char *filename)
+{
+    FILE *input = fopen(filename, "rb");
+    if (!input)
+    {
+        perror("Error opening trace file");
+        return EXIT_FAILURE;
+    }
+
+    TraceHeader header;
+    if (1 != fread(&header, sizeof(header), 1, input) ||
+        0 != memcmp(header.magic, TRACE_MAGIC, 4) ||
+        TRACE_VERSION != header.version ||
+        sizeof(TraceRecord) != header.record_size)
+    {
+        fprintf(stderr, "Error: %s is not a version %d pvm trace.\n", filename, TRACE_VERSION);
+        fclose(input);
+        return EXIT_FAILURE;
+    }
+
+    if (header.flags & TRACE_FLIGHT && header.dropped > 0)
+    {
+        printf("; ... %u earlier instructions not recorded\n", header.dropped);
+    }
+
+    TraceRecord record;
+    while (1 == fread(&record, sizeof(record), 1, input))
+    {
+        Instruction instr;
+        instr.raw = record.instr;
+        printf("\t[%#06X] SP: %#06X TOS: %#06X\t", record.pc, record.sp, record.tos);
+        print_instruction(instr);
+        printf("\t(%#06X)\n", instr.raw);
+    }
+
+    fclose(input);
+    return EXIT_SUCCESS;
+}
+
+
+
+// Counts from `pvm --profile`, merged into the listing with -p.
+static Profile profile;
+static int     have_profile = 0;
+
+int load_profile(const char *filename)
+{
+    FILE *input = fopen(filename, "r");
+    if (!input)
+    {
+        perror("Error opening profile");
+        return 0;
+    }
+
+    char line[128];
+    unsigned addr, op, func;
+    unsigned long long a, b;
+
+    while (fgets(line, sizeof(line), input))
+    {
+        if (1 == sscanf(line, "total %llu", &a))
+            profile.total = a;
+        else if (3 == sscanf(line, "branch %x %llu %llu", &addr, &a, &b) && addr < MEMORY_SIZE)
+            profile.taken[addr] = a, profile.not_taken[addr] = b;
+        else if (2 == sscanf(line, "pc %x %llu", &addr, &a) && addr < MEMORY_SIZE)
+            profile.pc[addr] = a;
+        else if (2 == sscanf(line, "call %x %llu", &addr, &a) && addr < MEMORY_SIZE)
+            profile.calls[addr] = a;
+        else if (3 == sscanf(line, "op %x %x %llu", &op, &func, &a) && op < 16 && func < 16)
+            profile.ops[op][func] = a;
+    }
+
+    fclose(input);
+    have_profile = 1;
+    return 1;
+}
+
+static double percent(uint64_t count)
+{
+    return profile.total ? 100.0 * count / profile.total : 0.0;
+}
+
+// Per-opcode totals, after the listing.
+void print_profile_summary(void)
+{
+    printf("\n; Executed %llu instructions\n", (unsigned long long)profile.total);
+    for (int op = 0; op < 16; op++)
+    {
+        for (int func = 0; func < 16; func++)
+        {
+            if (0 == profile.ops[op][func])
+                continue;
+
+            const char *name = op_map[op];
+            if (OP_ALU_LOGIC == op)
+                name = func < ALU_FUNC_COUNT ? alu_map[func] : NULL;
+            else if (OP_STACK_OPS == op)
+                name = func < STACK_FUNC_COUNT ? stack_op_map[func] : NULL;
+            else if (OP_BRANCH == op)
+                name = func < BRANCH_FUNC_COUNT ? branch_map[func] : NULL;
+
+            printf(";   %-8s %12llu  %5.1f%%\n", name ? name : "ILLEGAL",
+                   (unsigned long long)profile.ops[op][func],
+                   percent(profile.ops[op][func]));
+        }
+    }
+}
+
 
 
 int main(int argc, char **argv)
@@ -50,19 +220,39 @@ int main(int argc, char **argv)
     int simple_mode = 0;
     char *filename = NULL;
 
-    if (2 == argc)
+    for (int i = 1; i < argc; i++)
     {
-        filename = argv[1];
-    }
-    else if (3 == argc && 0 == strcmp(argv[1], "-s"))
-    {
-        simple_mode = 1;
-        filename = argv[2];
+        if (0 == strcmp(argv[i], "-s"))
+        {
+            simple_mode = 1;
+        }
+        else if (0 == strcmp(argv[i], "-t") && i + 1 < argc)
+        {
+            return print_trace(argv[i + 1]);
+        }
+        else if (0 == strcmp(argv[i], "-p") && i + 1 < argc)
+        {
+            if (!load_profile(argv[++i]))
+                return EXIT_FAILURE;
+        }
+        else if (NULL == filename && argv[i][0] != '-')
+        {
+            filename = argv[i];
+        }
+        else
+        {
+            filename = NULL;
+            break;
+        }
     }
-    else
+
+    if (NULL == filename)
     {
-        fprintf(stderr, "Usage: %s [-s] <binary_file.bin>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-s] [-p pvm.prof] <binary_file.bin>\n", argv[0]);
+        fprintf(stderr, "       %s -t <pvm.log>\n", argv[0]);
         fprintf(stderr, "  -s: Simple mode for re-assemblable output\n");
+        fprintf(stderr, "  -p: Show counts from pvm --profile next to each instruction\n");
+        fprintf(stderr, "  -t: Decode a binary execution trace\n");
         return EXIT_FAILURE;
     }
 
@@ -97,65 +287,39 @@ int main(int argc, char **argv)
     {
         Instruction instr;
         instr.raw = MEMORY[pc];
-        uint16_t opcode = instr.fields.opcode;
-        uint16_t arg    = instr.fields.arg;
         
         if (!simple_mode)
         {
             printf("\t[%#06X] ", pc);
+            if (have_profile)
+            {
+                printf("%12llu %5.1f%%  ", (unsigned long long)profile.pc[pc], percent(profile.pc[pc]));
+            }
         }
         else
         {
             printf("\t");
         }
 
-        switch (__builtin_expect(opcode, OP_LDI))
-        {
-            case OP_ALU_LOGIC:
-                printf("%s", alu_map[arg]);
-                break;
-            case OP_STACK_OPS:
-                printf("%s", stack_op_map[arg]);
-                break;
-            case OP_BRANCH:
-                printf("%s", branch_map[arg]);
-                break;
-            case OP_LDI:
-                printf("LDI %d", sign_extend_12(arg));
-                break;
-            case OP_LOAD:
-                printf("LOAD %d", sign_extend_12(arg));
-                break;
-            case OP_STORE:
-                printf("STORE %d", sign_extend_12(arg));
-                break;
-            case OP_JMP:
-                printf("JMP %d", sign_extend_12(arg));
-                break;
-            case OP_JAL:
-                printf("JAL %d", sign_extend_12(arg));
-                break;
-            case OP_TRAP:
-                printf("TRAP %d", arg);
-                break;
-            case OP_RET:
-                printf("RET");
-                break;
-            case OP_HALT:
-                printf("HALT");
-                break;
-            case OP_ILLEGAL:
-            default:
-                printf("ILLEGAL");
-                break;
-        }
+        print_instruction(instr);
         if (simple_mode)
         {
             printf("\n");
         }
         else
         {
-            printf("\t(%#06X)\n", instr.raw);
+            printf("\t(%#06X)", instr.raw);
+            if (have_profile && (profile.taken[pc] || profile.not_taken[pc]))
+            {
+                printf("\t; taken %llu, not taken %llu",
+                       (unsigned long long)profile.taken[pc],
+                       (unsigned long long)profile.not_taken[pc]);
+            }
+            if (have_profile && profile.calls[pc])
+            {
+                printf("\t; called %llu times", (unsigned long long)profile.calls[pc]);
+            }
+            printf("\n");
         }
     }
 
@@ -184,5 +348,10 @@ int main(int argc, char **argv)
         }    
     }
 
+    if (have_profile && !simple_mode)
+    {
+        print_profile_summary();
+    }
+
     return EXIT_SUCCESS;
 }
\ No newline at end of file
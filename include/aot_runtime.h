@@ -0,0 +1,24 @@
+#ifndef AOT_RUNTIME_H
+#define AOT_RUNTIME_H
+
+#include "isa_defs.h"
+
+// Support code for the programs paot generates.
+// They are linked with this, the trap handlers and string_utils.c.
+
+// Copies the image in and sets the registers up like pvm does.
+// dynamic lists the code addresses that are run through aot_step(),
+// because the program STOREs to them.
+void aot_start(const word_t *image, size_t words, word_t code_end,
+               const word_t *dynamic, size_t dynamic_count);
+
+// Runs the instruction at MEMORY[pc] against REGS, returns the next PC.
+word_t aot_step(word_t pc);
+
+// Same messages and exit codes as the simulator.
+void aot_trap(int trap, word_t pc);
+void aot_halt(word_t pc);
+void aot_illegal(word_t pc);
+void aot_div_zero(void);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+
+// Batch runner, `pvm --batch=MANIFEST`.
+// Every line of the manifest is a job, three paths apart by whitespace
+// and an optional priority (1 to 1000, see pvm_sched_add()):
+//     image stdin stdout [priority]
+// The guest's fd 0 and 1 are those files ("-" is /dev/null for either)
+// and fd 2 is pvm's stderr. Otherwise a job only reaches the files it
+// opened itself, up to 16 at once, and whatever it leaves open is closed
+// when it ends. Blank lines and lines starting with # are skipped.
+//
+// Jobs run on a pool of threads, each with its own VM. A thread starts
+// on its own share of the manifest and steals from the others once that
+// runs out, so a few long jobs don't leave the rest of the cores idle.
+// With a time slice each thread keeps up to BATCH_RESIDENT jobs going at
+// once and switches between them every slice instructions, so short jobs
+// aren't stuck behind long ones on the same thread either.
+//
+// The results file has a line per job, in manifest order:
+//     job status exit instructions gas turns image [error]
+// exit is what pvm would have exited with for that image, turns is how
+// many slices it took. gas is the same as instructions unless there's a
+// gas limit, every job gets the whole limit.
+
+#define BATCH_RESULTS_FILE "pvm.results"
+#define BATCH_RESIDENT     64
+
+// threads <= 0 means one per online CPU, slice 0 runs each job to the end
+// and gas 0 doesn't meter them. Returns non-zero if any job failed to load
+// or ended other than by HALT or TRAP 2, running out of gas included.
+int run_batch(const char *manifest, const char *results, int threads, uint64_t slice,
+              uint64_t gas);
+
+#endif
@@ -16,28 +16,30 @@
 #define CODE_START  0x0001          // The start address for program code.
 #define INITIAL_SP MEMORY_SIZE - 1  // The stack starts at top of the memory.
 
-// A function prototype.
-void load_memory(const char *filename);
-
 // The essential data types.
 typedef uint16_t word_t;
 typedef int16_t sword_t;
 
 #ifndef NO_LOG
     extern FILE *log_file;
-#   define CLOSE_LOG() do { if (log_file) fclose(log_file); } while(0)
+    void close_log(void);
+#   define CLOSE_LOG() close_log()
 #else
 #   define CLOSE_LOG() ((void)0)
 #endif
 
 // Stack macros.
+// The CHECK_STACK_ variants take the stack pointer, for code that keeps it
+// somewhere other than REGS.SP (like the interpreter loop).
 #ifdef BENCHMARK
-#   define CHECK_SP_OVERFLOW(n) ((void)0)
-#   define CHECK_SP_UNDERFLOW(n) ((void)0)
+#   define CHECK_STACK_OVERFLOW(sp, n) ((void)0)
+#   define CHECK_STACK_UNDERFLOW(sp, n) ((void)0)
 #else
-#   define CHECK_SP_UNDERFLOW(n) if (REGS.SP + n > INITIAL_SP) { fprintf(stderr, "Stack underflow\n"); CLOSE_LOG(); exit(EXIT_FAILURE); }
-#   define CHECK_SP_OVERFLOW(n)  if (REGS.SP < n) { fprintf(stderr, "Stack overflow\n"); CLOSE_LOG(); exit(EXIT_FAILURE); }
+#   define CHECK_STACK_UNDERFLOW(sp, n) if ((sp) + n > INITIAL_SP) { fprintf(stderr, "Stack underflow\n"); CLOSE_LOG(); exit(EXIT_FAILURE); }
+#   define CHECK_STACK_OVERFLOW(sp, n)  if ((sp) < n) { fprintf(stderr, "Stack overflow\n"); CLOSE_LOG(); exit(EXIT_FAILURE); }
 #endif
+#define CHECK_SP_UNDERFLOW(n) CHECK_STACK_UNDERFLOW(REGS.SP, n)
+#define CHECK_SP_OVERFLOW(n)  CHECK_STACK_OVERFLOW(REGS.SP, n)
 
 // Memory helpers.
 static inline char GET_CHAR_FROM_WORD(word_t w, int idx)
@@ -57,10 +59,6 @@ static inline sword_t sign_extend_12(int val)
     return (sword_t)val;
 }
 
-// TRAP Table Definitions.
-typedef void (*trap_handler_t)(void);
-extern trap_handler_t TRAP_TABLE[256];
-
 // In Unix-like systems, like Linux, the exit code is 1 byte long.
 typedef uint8_t exitcode_t;
 extern exitcode_t status; // Use extern to declare, not define
@@ -88,6 +86,7 @@ typedef struct
 } Registers;
 
 // Memory and Register Globals.
+// For the assembler and AOT programs, a VM has its own (see simulator.h).
 extern word_t    MEMORY[MEMORY_SIZE];
 extern Registers REGS;
 
@@ -129,7 +128,8 @@ enum AluFuncs
     FUNC_XOR  = 0x00B,
     // SHIFT
     FUNC_SHL  = 0x00C,
-    FUNC_SHR  = 0x00D
+    FUNC_SHR  = 0x00D,
+    ALU_FUNC_COUNT      // Not an instruction, keep it last.
 };
 
 enum StackOpsFuncs
@@ -137,7 +137,8 @@ enum StackOpsFuncs
     FUNC_SWAP = 0x000,
     FUNC_DUP  = 0x001,
     FUNC_DROP = 0x002,
-    FUNC_OVER = 0x003
+    FUNC_OVER = 0x003,
+    STACK_FUNC_COUNT    // Not an instruction, keep it last.
 };
 
 enum BranchFuncs
@@ -147,7 +148,8 @@ enum BranchFuncs
     FUNC_BZ  = 0x002,
     FUNC_BNZ = 0x003,
     FUNC_BN  = 0x004,
-    FUNC_BP  = 0x005
+    FUNC_BP  = 0x005,
+    BRANCH_FUNC_COUNT   // Not an instruction, keep it last.
 };
 
 #endif
@@ -0,0 +1,15 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "isa_defs.h"
+#include "simulator.h"
+
+// pvm_run() with the program running as native x86-64 code, from
+// vm->regs.PC to the end (there's no budget). Falls back to the
+// interpreter where that isn't possible. One VM at a time.
+pvm_status pvm_run_jit(pvm_vm *vm);
+
+// Throws away translations covering [addr, addr + count).
+void jit_invalidate(pvm_vm *vm, word_t addr, word_t count);
+
+#endif
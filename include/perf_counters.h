@@ -0,0 +1,32 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include "isa_defs.h"
+
+// Host hardware counters for the BENCHMARK build.
+// Uses perf_event_open where the kernel lets us, otherwise the TSC
+// (cycles only, and those are reference cycles rather than core ones).
+
+enum PerfCounter
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+typedef struct
+{
+    uint64_t value[PERF_COUNTER_COUNT];
+    int      valid[PERF_COUNTER_COUNT];
+    int      from_tsc;              // Only value[PERF_CYCLES], read with rdtsc.
+} PerfCounts;
+
+void perf_counters_start(void);
+void perf_counters_stop(PerfCounts *out);
+
+// One line, normalised by the guest instruction count.
+void perf_counters_report(FILE *out, const PerfCounts *counts, uint64_t guest_instructions);
+
+#endif
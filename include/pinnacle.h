@@ -0,0 +1,180 @@
+#ifndef PINNACLE_H
+#define PINNACLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// libpinnacle: the Pinnacle VM as a library.
+//
+// A pvm_vm owns its memory, registers, trap table and I/O hooks, so any
+// number of them can live in one process. Nothing in here exits: a run
+// ends with a pvm_status, errors come back as PVM_ERROR with the message
+// in pvm_error(). pvm is a small CLI on top of this.
+//
+//     pvm_vm *vm = pvm_create();
+//     pvm_load_image(vm, image, bytes);
+//     while (PVM_BUDGET == pvm_run(vm, 100000))
+//         ;   // Something else gets a turn.
+//     pvm_destroy(vm);
+//
+// Tracing, --profile, --sample and the JIT are process-wide debugging
+// aids of the pvm CLI, they are not meant for more than one VM at a time.
+
+#define PVM_MEMORY_WORDS 65536
+
+typedef struct pvm_vm pvm_vm;
+
+typedef enum
+{
+    PVM_HALTED,     // HALT, pvm_pc() is its address.
+    PVM_EXITED,     // TRAP 2, see pvm_exit_status().
+    PVM_BUDGET,     // Ran out of instructions, pvm_run() again to go on.
+    PVM_ERROR,      // See pvm_error(). Load an image before running again.
+    PVM_BREAK,      // Reached a pvm_break_at() or pvm_break_on_trap().
+    PVM_OUT_OF_GAS  // Used up what pvm_set_gas() allowed it.
+} pvm_status;
+
+// Guest I/O goes through these. fd is the guest's descriptor, the return
+// values are the ones of the POSIX calls. The defaults are those calls,
+// and so is any hook left NULL.
+typedef struct
+{
+    void  *user;
+    long (*read)(void *user, int fd, void *buf, size_t count);
+    long (*write)(void *user, int fd, const void *buf, size_t count);
+    int  (*open)(void *user, const char *path, int flags);
+    int  (*close)(void *user, int fd);
+} pvm_io;
+
+// TRAP n calls the handler for n. It takes its arguments off the guest
+// stack (pvm_pop) and may push results (pvm_push).
+typedef void (*pvm_trap_fn)(pvm_vm *vm);
+
+// NULL if out of memory.
+pvm_vm *pvm_create(void);
+void    pvm_destroy(pvm_vm *vm);
+
+// Loads a memory image (a.out.bin is one) and resets the registers the
+// way pvm starts a program. Anything past PVM_MEMORY_WORDS is ignored.
+// Returns the number of words loaded. Same as pvm_image_create() and
+// pvm_map_image() with an image only this VM uses.
+size_t  pvm_load_image(pvm_vm *vm, const void *image, size_t bytes);
+
+// A loaded image kept as a read-only template. VMs map it copy-on-write:
+// they share every page they don't write to, and pvm_reset() throws away
+// the ones they did. Meant for running one program many times over.
+typedef struct pvm_image pvm_image;
+
+// NULL if the template can't be made. Destroying it only drops the
+// caller's hold, VMs that map it keep it alive.
+pvm_image *pvm_image_create(const void *image, size_t bytes);
+void       pvm_image_destroy(pvm_image *image);
+
+// Loads image into vm, as pvm_load_image() would. -1 if it couldn't be
+// mapped, the VM has to be loaded again before it runs.
+int     pvm_map_image(pvm_vm *vm, pvm_image *image);
+
+// Back to the state right after the image was loaded, at the cost of the
+// pages the guest wrote. -1 if the VM has no template to go back to.
+int     pvm_reset(pvm_vm *vm);
+
+// Runs until HALT, TRAP 2 or an error. With max_instructions set it also
+// stops at the first jump, call, return or taken branch after that many
+// instructions; 0 means no limit.
+pvm_status pvm_run(pvm_vm *vm, uint64_t max_instructions);
+
+void    pvm_set_io(pvm_vm *vm, const pvm_io *io);
+void    pvm_set_trap(pvm_vm *vm, int trap, pvm_trap_fn handler);
+
+// Guest output is buffered: the write hook gets it when the buffer is
+// full, when the guest reads, switches descriptors or closes one, and
+// before pvm_run() returns. Stdin is read ahead. 0 turns both off, every
+// TRAP 0 and TRAP 1 is a hook call of its own.
+void    pvm_set_buffering(pvm_vm *vm, int buffered);
+
+// The console: with it on, STORE -2048 writes the low byte of the top of
+// the stack to stdout and LOAD -2047 pushes the next byte of stdin (-1
+// at the end of it), through the same buffers, no TRAP involved. They
+// decode to handlers of their own, so no other LOAD or STORE pays for
+// it, and off (the default) they're plain memory again. It stays across
+// loads. Only the interpreter has it, pvm_run_jit() falls back to that.
+#define PVM_CONSOLE_TX (-2048)
+#define PVM_CONSOLE_RX (-2047)
+void    pvm_set_console(pvm_vm *vm, int on);
+
+// Metering: with a limit set every instruction costs gas, 1 for most
+// and more for MULT, DIV and TRAP (the bulk memory ones more the more
+// words they take), and the run stops with PVM_OUT_OF_GAS
+// once it's used up. It's charged a straight run of code at a time, at
+// the jump that ends it, so the last run may take it a little over.
+// With a limit max_instructions of pvm_run() counts gas too. 0 turns
+// it off. The limit stays across loads, the gas used starts over.
+void     pvm_set_gas(pvm_vm *vm, uint64_t limit);
+// Since the image was loaded. Unmetered it's the same as pvm_instructions().
+uint64_t pvm_gas_used(const pvm_vm *vm);
+
+// Stops the run with PVM_BREAK the first time it gets to pc, or to a
+// TRAP trap, before that instruction runs. pvm_run() again carries on
+// from there. -1 clears it.
+void    pvm_break_at(pvm_vm *vm, int pc);
+void    pvm_break_on_trap(pvm_vm *vm, int trap);
+
+// Writes memory, registers, the instruction count and the files the
+// guest opened (path, mode and offset) to path. Only files opened while
+// on the host's I/O can be described. -1 with pvm_error() set if it can't.
+int     pvm_save_snapshot(pvm_vm *vm, const char *path);
+
+// Picks up where pvm_save_snapshot() left off. image is the program the
+// snapshot should be of (a.out.bin), a snapshot of anything else, of an
+// older build of it or in an older format is refused. The guest's files
+// are opened again at the same descriptors. Memory is mapped from the
+// snapshot copy-on-write, pvm_reset() goes back to it (but doesn't
+// reopen files). -1 with pvm_error() set if it can't be restored.
+int     pvm_restore(pvm_vm *vm, const char *path, const void *image, size_t bytes);
+
+// Green threads: a scheduler time-slices any number of VMs on the thread
+// that calls pvm_sched_run(), round robin. Each turn is a pvm_run() with
+// a budget, so a VM can't keep the others waiting for much longer than
+// its slice. A scheduler is for one thread, use one per thread.
+typedef struct pvm_sched pvm_sched;
+
+// What pvm_sched_run() hands back once a VM is done.
+typedef struct
+{
+    pvm_vm     *vm;
+    void       *user;       // As given to pvm_sched_add().
+    pvm_status  status;     // Anything but PVM_BUDGET.
+    uint64_t    turns;      // Slices it was given, pvm_instructions() says
+                            // how much of them it used.
+} pvm_task;
+
+// slice is the budget of a turn in instructions, 0 runs every VM to the
+// end in turn. NULL if out of memory.
+pvm_sched *pvm_sched_create(uint64_t slice);
+// Doesn't destroy the VMs still on it.
+void       pvm_sched_destroy(pvm_sched *s);
+
+// Queues a loaded VM at the back. A VM of priority n gets n slices a
+// turn (anything under 1 is 1), so it gets n times the share of the CPU
+// but nobody starves. -1 if out of memory.
+int        pvm_sched_add(pvm_sched *s, pvm_vm *vm, int priority, void *user);
+
+// Runs the queued VMs until one of them halts, exits, fails, breaks or
+// runs out of gas, takes it off and fills in *done. 0 if there's nothing left to run.
+int        pvm_sched_run(pvm_sched *s, pvm_task *done);
+size_t     pvm_sched_count(const pvm_sched *s);
+
+// For trap handlers: stack access, and a way out that ends the run with
+// PVM_ERROR (it doesn't return).
+void     pvm_push(pvm_vm *vm, uint16_t value);
+uint16_t pvm_pop(pvm_vm *vm);
+void     pvm_fail(pvm_vm *vm, const char *fmt, ...)
+    __attribute__((noreturn, format(printf, 2, 3)));
+
+uint16_t   *pvm_memory(pvm_vm *vm);             // PVM_MEMORY_WORDS of it.
+uint16_t    pvm_pc(const pvm_vm *vm);
+int         pvm_exit_status(const pvm_vm *vm);
+uint64_t    pvm_instructions(const pvm_vm *vm); // Since the image was loaded.
+const char *pvm_error(const pvm_vm *vm);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "isa_defs.h"
+
+// Exact execution profile, filled in by `pvm --profile`.
+// Superinstructions are turned off while profiling, so every guest
+// instruction is counted on its own address.
+
+#define PROFILE_FILE    "pvm.prof"
+#define PROFILE_VERSION 1
+
+typedef struct
+{
+    uint64_t pc[MEMORY_SIZE];           // Executions per address.
+    uint64_t taken[MEMORY_SIZE];        // Per branch address.
+    uint64_t not_taken[MEMORY_SIZE];
+    uint64_t calls[MEMORY_SIZE];        // Per JAL target.
+    uint64_t ops[16][16];               // [opcode][func], func is 0 where unused.
+    uint64_t total;
+} Profile;
+
+extern Profile PROFILE;
+
+// Called before the instruction at pc runs.
+void profile_instruction(const word_t *memory, word_t pc);
+
+// Text file, one record per line:
+//   total <n>
+//   pc <addr> <count>
+//   branch <addr> <taken> <not taken>
+//   call <addr> <count>
+//   op <opcode> <func> <count>
+// Addresses and opcodes are hex. pdis -p merges it into a listing.
+int write_profile(const char *filename);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef PVMD_H
+#define PVMD_H
+
+#include "pinnacle.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// pvmd: a resident pvm that takes runs over a Unix socket, and the
+// protocol its clients (pvmc, pload) speak.
+//
+// Images are cached by content: a client asks for a run of an image id
+// (pvmd_image_id() of the image) and only sends the image itself when
+// pvmd says it doesn't have it. A connection can carry any number of
+// requests, one after the other:
+//
+//     PVMD_PUT image              -> PVMD_IMAGE id
+//     PVMD_RUN PvmdRun stdin      -> PVMD_STDOUT/PVMD_STDERR ..., PVMD_DONE
+//                                 -> PVMD_UNKNOWN if the image isn't cached
+//
+// Anything pvmd can't make sense of gets PVMD_REFUSED and the connection
+// is closed. Everything is in host byte order, it's a local socket.
+
+#define PVMD_SOCKET         "/tmp/pvmd.sock"
+#define PVMD_MAX_IMAGE      (PVM_MEMORY_WORDS * 2)
+#define PVMD_MAX_INPUT      (1 << 20)
+#define PVMD_MAX_FRAME      (sizeof(PvmdRun) + PVMD_MAX_INPUT)
+
+enum
+{
+    // Client to pvmd.
+    PVMD_PUT = 1,   // The image.
+    PVMD_RUN,       // PvmdRun, then the guest's stdin.
+
+    // pvmd to client.
+    PVMD_IMAGE,     // uint64_t id of the image just put.
+    PVMD_STDOUT,    // Some of what the guest wrote to fd 1,
+    PVMD_STDERR,    // or to fd 2, as it writes it.
+    PVMD_DONE,      // PvmdDone, the end of a run.
+    PVMD_UNKNOWN,   // No such image, put it and ask again.
+    PVMD_REFUSED    // Why, as text.
+};
+
+// Every message is one of these and length bytes of payload.
+typedef struct
+{
+    uint32_t type;
+    uint32_t length;
+} PvmdFrame;
+
+typedef struct
+{
+    uint64_t image;
+    uint64_t gas;           // 0 for pvmd's limit, it's never more than that.
+} PvmdRun;
+
+typedef struct
+{
+    int32_t  status;        // A pvm_status.
+    int32_t  exit_code;     // What pvm would have exited with.
+    uint64_t instructions;
+    uint64_t gas;
+    char     error[256];    // With PVM_ERROR.
+} PvmdDone;
+
+// FNV-1a of the part of the image a VM would load.
+uint64_t pvmd_image_id(const void *image, size_t bytes);
+
+// -1 with errno set if it can't.
+int pvmd_connect(const char *path);
+
+// One message, header and both parts of the payload in one go.
+int pvmd_send(int fd, uint32_t type, const void *a, size_t a_size,
+              const void *b, size_t b_size);
+
+// Reads the next message, its payload into buf. -1 on EOF (errno 0), on
+// an error, or if the payload is bigger than size (EMSGSIZE).
+int pvmd_recv(int fd, PvmdFrame *frame, void *buf, size_t size);
+
+#endif
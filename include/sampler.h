@@ -0,0 +1,26 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "isa_defs.h"
+#include "simulator.h"
+
+// Statistical profiler, `pvm --sample[=HZ]`.
+// SIGPROF asks the interpreter for a sample; it takes it before the next
+// instruction runs, so the signal handler itself touches nothing else.
+// Call stacks are rebuilt from LR and the saved LRs that JAL leaves on
+// the stack. There are no frame markers, so any stack word that points
+// just after a JAL (and fits the chain) is taken for one.
+
+#define SAMPLE_DEFAULT_HZ   997
+#define SAMPLE_FOLDED_FILE  "pvm.folded"    // For flamegraph.pl and friends.
+#define SAMPLE_HIST_FILE    "pvm.samples"   // Per-PC and stack depth histograms.
+#define SAMPLE_MAX_FRAMES   64
+
+// Provided by the interpreter, called from the signal handler.
+void request_sample(void);
+
+int  sampler_start(int hz);
+void sampler_record(const pvm_vm *vm, word_t pc, word_t sp, word_t tos);
+int  write_samples(void);
+
+#endif
@@ -0,0 +1,153 @@
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include "isa_defs.h"
+#include "pinnacle.h"
+#include "superinstructions.h"
+#include <setjmp.h>
+#include <sys/types.h>
+
+typedef pvm_trap_fn trap_handler_t;
+
+// Pre-decoded instruction, one per word of memory (see run_simulator).
+typedef struct
+{
+    void    *handler;   // Label inside run_simulator.
+    sword_t  operand;   // Sign-extended immediate/offset, or the raw arg.
+} DecodedInstr;
+
+// A memory image as a file, mapped MAP_PRIVATE by every VM that runs it
+// (see pinnacle.c). Once one of them has decoded it, the code part of its
+// decoded cache is kept the same way, so a reset doesn't decode again.
+// A snapshot is one too, that starts further along.
+struct pvm_image
+{
+    int        fd;
+    off_t      offset;          // Of memory in the file.
+    size_t     words;
+    uint64_t   hash;            // Of the program it was loaded from.
+    Registers  start;
+    uint64_t   instructions;    // Already run at start.
+    int        refs;            // Its creator and every VM on it.
+
+    int        cache_state;
+    int        cache_fd;
+    size_t     cache_bytes;     // Page-rounded, fused heads may reach past BR.
+};
+
+// Per VM, for pvm_set_buffering().
+#define OUTPUT_BUFFER 8192
+#define INPUT_BUFFER  4096
+
+// Everything a running program can touch. The public side is pinnacle.h.
+struct pvm_vm
+{
+    word_t         *memory;             // MEMORY_SIZE words.
+    Registers       regs;
+    exitcode_t      status;             // Left by TRAP 2.
+    uint64_t        instructions;
+    uint64_t        gas_used;
+    uint64_t        gas_limit;          // 0 when not metered.
+    uint64_t        bulk_gas;           // Left by TRAPs 5 to 8 for op_trap.
+    uint64_t        fused_hits[FUSED_PATTERN_COUNT];    // For --stats.
+    trap_handler_t  traps[256];
+    pvm_io          io;
+
+    // Where DISPATCH fetches from. request_sample() points it at a table
+    // whose every entry is op_sample, for exactly one instruction.
+    DecodedInstr   *code_cache;
+    DecodedInstr   *volatile cache_base;
+    int             cache_ready;        // Cleared by loading an image.
+
+    // Where memory is mapped from, and what code_cache is.
+    pvm_image      *image;
+    int             cache_mapped;
+
+    // One-shot stops, see pvm_break_at(). -1 when unset.
+    int             break_pc;
+    int             break_trap;
+
+    // Host descriptors the guest opened with TRAP 3, what a snapshot
+    // takes along. Ones past 255 can't be told apart.
+    uint64_t        open_files[4];
+    int             untracked_files;
+
+    // Guest output held back for output_fd, and stdin read ahead, see
+    // trap_handlers.c. Nothing is held back once pvm_run() returns.
+    int             buffered;
+    int             console;            // See pvm_set_console().
+    int             output_fd;
+    size_t          output_used;
+    size_t          input_pos, input_used;
+    char            output[OUTPUT_BUFFER];
+    char            input[INPUT_BUFFER];
+
+    jmp_buf         bail;               // pvm_fail() lands here.
+    char            error[256];
+};
+
+// What metered instructions cost (see pvm_set_gas()), everything else
+// costs 1. They're about how much slower these are than an ADD.
+#define GAS_MULT 2
+#define GAS_DIV  4
+#define GAS_TRAP 20
+// The bulk memory TRAPs (5 to 8) cost 1 more for every this many words.
+#define GAS_WORDS 16
+
+// How code_cache is mapped (see pinnacle.c).
+#define MAPPED_NONE  0      // It's the VM's own, anything may be in it.
+#define MAPPED_BLANK 1      // Nothing decoded yet.
+#define MAPPED_IMAGE 2      // The image's decoded code, blank after it.
+
+// Inside the VM a failed check ends the run rather than the process.
+// These expect the pvm_vm *vm they check in scope.
+#undef CHECK_STACK_UNDERFLOW
+#undef CHECK_STACK_OVERFLOW
+#undef CHECK_SP_UNDERFLOW
+#undef CHECK_SP_OVERFLOW
+#ifdef BENCHMARK
+#   define CHECK_STACK_OVERFLOW(sp, n) ((void)0)
+#   define CHECK_STACK_UNDERFLOW(sp, n) ((void)0)
+#else
+#   define CHECK_STACK_UNDERFLOW(sp, n) if ((sp) + n > INITIAL_SP) { pvm_fail(vm, "Stack underflow"); }
+#   define CHECK_STACK_OVERFLOW(sp, n)  if ((sp) < n) { pvm_fail(vm, "Stack overflow"); }
+#endif
+#define CHECK_SP_UNDERFLOW(n) CHECK_STACK_UNDERFLOW(vm->regs.SP, n)
+#define CHECK_SP_OVERFLOW(n)  CHECK_STACK_OVERFLOW(vm->regs.SP, n)
+
+// The interpreter. pvm_run() is this plus catching pvm_fail().
+pvm_status run_simulator(pvm_vm *vm, uint64_t max_instructions);
+
+// Set before running to fill in PROFILE (see profile.h).
+extern int profiling;
+// Non-zero: sample the guest this many times a second (see sampler.h).
+extern int sample_hz;
+
+// Shared by the interpreter and the JIT.
+// execute_trap() returns non-zero when the program exited (TRAP 2).
+int  execute_trap(pvm_vm *vm, int trap, word_t pc);
+void illegal_instruction(pvm_vm *vm, word_t pc) __attribute__((noreturn));
+
+// Writes out what the guest has written so far. Every way out of a run
+// goes through here.
+void flush_guest_output(pvm_vm *vm);
+
+// The console's two registers, a byte at a time (see pvm_set_console()).
+// console_read() returns 0xFFFF at the end of stdin.
+void   console_write(pvm_vm *vm, word_t c);
+word_t console_read(pvm_vm *vm);
+
+// Drops pre-decoded instructions after a host-side write to memory.
+void invalidate_code_cache(pvm_vm *vm, word_t addr, word_t count);
+
+// The interpreter calls this right after it decoded a freshly loaded
+// image, so other VMs on the same image can map the result.
+void share_code_cache(pvm_vm *vm, void *decode_handler);
+
+// Images from somewhere other than pvm_image_create() (snapshot.c).
+pvm_image *image_from_file(int fd, off_t offset, const Registers *start,
+                           uint64_t instructions, uint64_t hash);
+uint64_t   hash_image(const void *image, size_t bytes);
+
+#endif
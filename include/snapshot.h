@@ -0,0 +1,43 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "isa_defs.h"
+
+// VM snapshot file, `pvm --snapshot-at` writes one, `pvm --restore`
+// resumes from it (see pvm_save_snapshot() in pinnacle.h).
+// A SnapshotHeader at the start, then all of memory at SNAPSHOT_MEMORY_AT
+// so it can be mapped straight from the file. Anything that doesn't match
+// this build exactly is refused, so bump SNAPSHOT_VERSION with any change
+// to the layout or to what a restored VM expects.
+
+#define SNAPSHOT_MAGIC      "PVMS"
+#define SNAPSHOT_VERSION    1
+#define SNAPSHOT_FILE       "pvm.snap"
+#define SNAPSHOT_MEMORY_AT  65536       // Page aligned for pages up to 64K.
+#define SNAPSHOT_MAX_FILES  32
+#define SNAPSHOT_PATH_SIZE  256
+
+// A file the guest had open. It's opened again at the same descriptor.
+typedef struct
+{
+    int32_t  fd;
+    int32_t  flags;                     // Access mode and O_APPEND.
+    int64_t  offset;
+    char     path[SNAPSHOT_PATH_SIZE];  // Absolute.
+} SnapshotFile;
+
+typedef struct
+{
+    char         magic[4];
+    uint16_t     version;
+    uint16_t     header_size;           // sizeof(SnapshotHeader).
+    uint32_t     memory_words;          // MEMORY_SIZE.
+    uint32_t     file_count;
+    uint64_t     image_hash;            // Of the program it's a snapshot of.
+    uint64_t     instructions;          // Run before the snapshot.
+    Registers    regs;
+    SnapshotFile files[SNAPSHOT_MAX_FILES];
+    uint64_t     checksum;              // FNV-1a of everything before it.
+} SnapshotHeader;
+
+#endif
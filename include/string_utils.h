@@ -1,19 +1,35 @@
-
 #ifndef STRING_UTILS_H
 #define STRING_UTILS_H
 
 #include "isa_defs.h"
 
-// To manage strings and length easily
-// with our helper functions.
-typedef struct
-{
-    word_t count;
-    char   *str;
-} string_t;
+// Packed strings: a length word, then two characters a word, high byte
+// first. They work on whichever memory they're given, addresses are
+// absolute and wrap at the end of it like any other. Nothing here
+// allocates, the caller brings the buffer.
+
+// Returns the words it took.
+word_t str_pack(word_t *memory, const char *str, word_t start_address);
+// As a C string into buffer, cut short if it takes more than size bytes.
+// Returns the full length, like snprintf().
+word_t str_unpack(const word_t *memory, word_t addr, char *buffer, size_t size);
+void buf_pack(word_t *memory, word_t addr, const char *buffer, word_t count);
+// Characters from..from+count of the string at addr, no terminator.
+void buf_unpack(const word_t *memory, word_t addr, char *buffer, word_t from, word_t count);
+
+// Numbers, in base 2 to 36: value as a packed string at addr, signed or
+// not, returns its length. Parsing skips blanks, takes a sign and then
+// as many digits as there are, from character from of the string at
+// addr on. Returns the characters it took, 0 (and a value of 0) if there
+// was no number. Too many digits wrap, like the ALU does.
+word_t str_format_word(word_t *memory, word_t addr, word_t value, int base, int is_signed);
+word_t str_parse_word(const word_t *memory, word_t addr, word_t from, int base, word_t *value);
 
-word_t str_pack(const char *str, word_t start_address);
-string_t str_unpack(word_t buf_offset);
-void buf_pack(const char *buffer, word_t buf_offset, word_t count);
+// The conversions are byte swaps, done with whatever this CPU has best:
+// "avx2", "sse2" or "scalar". str_set_kernel() picks another one (for
+// benchmarking), -1 if there's no such kernel or the CPU can't run it.
+// A big-endian host doesn't use any of them.
+const char *str_kernel(void);
+int str_set_kernel(const char *name);
 
 #endif
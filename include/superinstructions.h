@@ -0,0 +1,41 @@
+
+#ifndef SUPERINSTRUCTIONS_H
+#define SUPERINSTRUCTIONS_H
+
+#include "isa_defs.h"
+
+// Longest idiom we are willing to fuse.
+#define MAX_FUSED_LENGTH 4
+
+// A single instruction slot of a pattern. It matches when (raw & mask) == value.
+typedef struct
+{
+    word_t mask;
+    word_t value;
+} InstrMatch;
+
+// The ids double as indexes into the simulator's table of fused handlers,
+// so a new idiom needs an id, an entry in FUSED_PATTERNS and a handler.
+typedef enum
+{
+    FUSE_LOAD_LDI_DIV_DROP,
+    FUSE_LOAD_DUP_LOAD_ADD,
+    FUSE_LDI_LDI_TRAP_WRITE,
+    FUSE_LDI_BNZ,
+    FUSED_PATTERN_COUNT
+} FusedPatternId;
+
+typedef struct
+{
+    const char *name;
+    int         length;
+    InstrMatch  match[MAX_FUSED_LENGTH];
+} FusedPattern;
+
+extern const FusedPattern FUSED_PATTERNS[FUSED_PATTERN_COUNT];
+
+int  match_fused_pattern(const word_t *memory, word_t addr);
+// hits is a VM's fused_hits, FUSED_PATTERN_COUNT of them.
+void print_fused_stats(FILE *out, const uint64_t *hits);
+
+#endif
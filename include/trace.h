@@ -0,0 +1,55 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "isa_defs.h"
+
+// Binary execution trace.
+// The interpreter drops one fixed-size record per instruction into a ring
+// buffer. By default every full ring is written to pvm.log in one go; as
+// a flight recorder only the last TRACE_RING_SIZE records are kept, and
+// written when the log is closed (HALT, exit or any fatal error).
+// pdis -t renders the file.
+
+#define TRACE_MAGIC         "PVMT"
+#define TRACE_VERSION       1
+#define TRACE_RING_SIZE     (1 << 16)   // Records, keep it a power of two.
+#define TRACE_FLIGHT        0x1         // Header flag: only the tail was kept.
+
+typedef struct
+{
+    char     magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t flags;
+    uint32_t dropped;                   // Records lost off the front (flight recorder).
+} TraceHeader;
+
+typedef struct
+{
+    word_t pc;
+    word_t sp;
+    word_t instr;
+    word_t tos;
+} TraceRecord;
+
+extern TraceRecord TRACE_RING[TRACE_RING_SIZE];
+extern uint64_t    trace_count;        // Records written so far.
+extern int         trace_streaming;
+extern int         trace_enabled;      // Between trace_open() and trace_flush().
+
+void trace_open(FILE *log, int flight_recorder);
+void trace_spill(void);                 // Writes out a full ring.
+void trace_flush(void);                 // Writes whatever hasn't been written yet.
+
+static inline void trace_record(word_t pc, word_t sp, word_t instr, word_t tos)
+{
+    TraceRecord *r = &TRACE_RING[trace_count & (TRACE_RING_SIZE - 1)];
+    r->pc    = pc;
+    r->sp    = sp;
+    r->instr = instr;
+    r->tos   = tos;
+    if (0 == (++trace_count & (TRACE_RING_SIZE - 1)) && trace_streaming)
+        trace_spill();
+}
+
+#endif
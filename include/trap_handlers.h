@@ -3,10 +3,16 @@
 #define TRAP_HANDLERS_H
 
 #include "isa_defs.h"
+#include "simulator.h"
 
 // Could be changed later, but sounds reasonable right now.
 #define MAX_STACK_READ_SIZE 4096
+// Longest path TRAP 3 takes, with its terminator.
+#define MAX_PATH_LENGTH     4096
 
-void initialize_trap_table(void);
+// Plain read/write/open/close, what a new VM starts with.
+extern const pvm_io HOST_IO;
+
+void initialize_trap_table(pvm_vm *vm);
 
 #endif
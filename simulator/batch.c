@@ -0,0 +1,683 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
+#include "pinnacle.h"
+#include "isa_defs.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+typedef struct
+{
+    char       *image;
+    char       *in_path;
+    char       *out_path;
+    int         priority;
+    pvm_image  *loaded;         // Shared by every job on the same image,
+    int         owns_image;     // and destroyed through the first one.
+    int         load_errno;     // Why it isn't loaded, if it isn't.
+
+    // Filled in by whichever worker ran it.
+    pvm_status  result;
+    int         exit_code;
+    uint64_t    instructions;
+    uint64_t    gas;
+    uint64_t    turns;
+    char        error[128];
+} Job;
+
+// Work-stealing deque of job indexes (Chase-Lev). The owner pops at the
+// bottom, thieves take from the top. Everything is pushed before the
+// workers start, so it never grows and a slot is never reused.
+typedef struct
+{
+    size_t  *items;
+    int64_t  top;
+    int64_t  bottom;
+} Deque;
+
+// Descriptors behind the guest's stdin and stdout, and the ones it opened
+// itself. Every other host descriptor belongs to some other job, or to
+// the runner.
+#define JOB_MAX_FILES 16
+
+typedef struct
+{
+    int in;
+    int out;
+    int opened[JOB_MAX_FILES];
+    int opened_count;
+} JobFiles;
+
+// A VM and the job it's running, if any.
+typedef struct
+{
+    pvm_vm     *vm;
+    Job        *job;
+    JobFiles    files;
+} Slot;
+
+typedef struct
+{
+    Deque       deque;
+    pvm_sched  *sched;
+    Slot       *slots;
+    Slot      **idle;           // The slots with no job, a stack.
+    int         idle_count;
+    uint32_t    seed;           // For picking victims.
+    pthread_t   thread;
+
+    // Keeps the next worker's deque off this one's cache line.
+    char        pad[64];
+} Worker;
+
+#define STEAL_OK    0
+#define STEAL_EMPTY 1
+#define STEAL_LOST  2   // Someone else got it, try again.
+
+static Job    *jobs = NULL;
+static size_t  job_count = 0;
+static Worker *workers = NULL;
+static int     worker_count = 0;
+static int     resident = 1;    // Jobs a worker runs at once.
+static uint64_t slice = 0;
+static uint64_t gas_limit = 0;
+
+
+
+// **Deque**
+
+// Owner only, and only before the workers start.
+static void deque_push(Deque *d, size_t job)
+{
+    d->items[d->bottom] = job;
+    d->bottom++;
+}
+
+
+
+// Owner only. Returns 0 when the deque is empty.
+static int deque_pop(Deque *d, size_t *job)
+{
+    int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+
+    if (t > b)
+    {
+        __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    *job = d->items[b];
+    if (t < b)
+        return 1;
+
+    // The last one, a thief may be after it too.
+    int won = __atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    __atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+    return won;
+}
+
+
+
+// Any thread.
+static int deque_steal(Deque *d, size_t *job)
+{
+    int64_t t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+
+    if (t >= b)
+        return STEAL_EMPTY;
+
+    size_t x = d->items[t];
+    if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        return STEAL_LOST;
+
+    *job = x;
+    return STEAL_OK;
+}
+
+
+
+// Nothing is added once the workers run, so a sweep that finds every
+// deque empty means there is nothing left anywhere.
+static int steal(Worker *self, size_t *job)
+{
+    for (;;)
+    {
+        int lost = 0;
+
+        // xorshift32, so thieves don't all line up on the same victim.
+        self->seed ^= self->seed << 13;
+        self->seed ^= self->seed >> 17;
+        self->seed ^= self->seed << 5;
+        int start = self->seed % worker_count;
+
+        for (int i = 0; i < worker_count; i++)
+        {
+            Worker *victim = &workers[(start + i) % worker_count];
+            if (victim == self)
+                continue;
+
+            int r = deque_steal(&victim->deque, job);
+            if (STEAL_OK == r)
+                return 1;
+            lost |= STEAL_LOST == r;
+        }
+
+        if (!lost)
+            return 0;
+    }
+}
+
+
+
+// **Jobs**
+
+// Where fd is in files->opened, -1 if the job didn't open it.
+static int opened_by_job(const JobFiles *files, int fd)
+{
+    for (int i = 0; i < files->opened_count; i++)
+        if (files->opened[i] == fd)
+            return i;
+    return -1;
+}
+
+
+
+static long job_read(void *user, int fd, void *buf, size_t count)
+{
+    JobFiles *files = user;
+    if (fd != 0 && opened_by_job(files, fd) < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    return read(0 == fd ? files->in : fd, buf, count);
+}
+
+
+
+// fd 2 is the runner's stderr, as it is pvm's.
+static long job_write(void *user, int fd, const void *buf, size_t count)
+{
+    JobFiles *files = user;
+    if (fd != 1 && fd != 2 && opened_by_job(files, fd) < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    return write(1 == fd ? files->out : fd, buf, count);
+}
+
+
+
+static int job_open(void *user, const char *path, int flags)
+{
+    JobFiles *files = user;
+    if (JOB_MAX_FILES == files->opened_count)
+    {
+        errno = EMFILE;
+        return -1;
+    }
+
+    int fd = open(path, flags | O_CLOEXEC, 0644);
+    if (fd != -1)
+        files->opened[files->opened_count++] = fd;
+    return fd;
+}
+
+
+
+// Only what it opened, its stdin and stdout are closed with the job.
+static int job_close(void *user, int fd)
+{
+    JobFiles *files = user;
+    int i = opened_by_job(files, fd);
+    if (i < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    files->opened[i] = files->opened[--files->opened_count];
+    return close(fd);
+}
+
+
+
+// Everything the job had, whatever it left open.
+static void close_job_files(JobFiles *files)
+{
+    close(files->in);
+    close(files->out);
+    while (files->opened_count > 0)
+        close(files->opened[--files->opened_count]);
+}
+
+
+
+static void job_failed(Job *job, const char *what, const char *path, int err)
+{
+    job->result    = PVM_ERROR;
+    job->exit_code = EXIT_FAILURE;
+    snprintf(job->error, sizeof(job->error), "%s %s: %s", what, path, strerror(err));
+}
+
+
+
+static int open_job_file(const char *path, int flags)
+{
+    if (0 == strcmp(path, "-"))
+        path = "/dev/null";
+    return open(path, flags, 0644);
+}
+
+
+
+// Gets job going on slot's VM. Returns 0 if it failed before it started.
+static int start_job(Slot *slot, Job *job)
+{
+    if (NULL == job->loaded)
+    {
+        job_failed(job, "Can't load", job->image, job->load_errno);
+        return 0;
+    }
+
+    JobFiles *files = &slot->files;
+    files->opened_count = 0;
+    files->in = open_job_file(job->in_path, O_RDONLY);
+    if (-1 == files->in)
+    {
+        job_failed(job, "Can't open", job->in_path, errno);
+        return 0;
+    }
+    files->out = open_job_file(job->out_path, O_WRONLY | O_CREAT | O_TRUNC);
+    if (-1 == files->out)
+    {
+        job_failed(job, "Can't create", job->out_path, errno);
+        close(files->in);
+        return 0;
+    }
+
+    // A VM that ran the same image last only has to reset.
+    if (pvm_map_image(slot->vm, job->loaded) != 0)
+    {
+        job_failed(job, "Can't map", job->image, errno);
+        close(files->in);
+        close(files->out);
+        return 0;
+    }
+
+    pvm_io io = { files, job_read, job_write, job_open, job_close };
+    pvm_set_io(slot->vm, &io);
+    pvm_set_gas(slot->vm, gas_limit);
+    slot->job = job;
+    return 1;
+}
+
+
+
+static void finish_job(Slot *slot, const pvm_task *task)
+{
+    Job *job = slot->job;
+
+    job->result       = task->status;
+    job->instructions = pvm_instructions(slot->vm);
+    job->gas          = pvm_gas_used(slot->vm);
+    job->turns        = task->turns;
+
+    switch (job->result)
+    {
+        case PVM_EXITED:
+            job->exit_code = (exitcode_t)pvm_exit_status(slot->vm);
+            break;
+        case PVM_ERROR:
+            job->exit_code = EXIT_FAILURE;
+            snprintf(job->error, sizeof(job->error), "%s", pvm_error(slot->vm));
+            break;
+        case PVM_HALTED:
+            job->exit_code = EXIT_SUCCESS;
+            break;
+        default:
+            job->exit_code = EXIT_FAILURE;
+            break;
+    }
+
+    close_job_files(&slot->files);
+    slot->job = NULL;
+}
+
+
+
+// Keeps every slot busy while there are jobs left, and time-slices the
+// ones that are running.
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    size_t job;
+    pvm_task done;
+
+    for (;;)
+    {
+        while (w->idle_count > 0 && (deque_pop(&w->deque, &job) || steal(w, &job)))
+        {
+            Slot *slot = w->idle[w->idle_count - 1];
+            if (!start_job(slot, &jobs[job]))
+                continue;
+
+            w->idle_count--;
+            if (pvm_sched_add(w->sched, slot->vm, jobs[job].priority, slot) != 0)
+            {
+                job_failed(&jobs[job], "Can't schedule", jobs[job].image, ENOMEM);
+                close_job_files(&slot->files);
+                w->idle[w->idle_count++] = slot;
+            }
+        }
+
+        if (!pvm_sched_run(w->sched, &done))
+            break;
+
+        finish_job(done.user, &done);
+        w->idle[w->idle_count++] = done.user;
+    }
+
+    return NULL;
+}
+
+
+
+// **Manifest and results**
+
+static int read_manifest(const char *manifest)
+{
+    FILE *f = fopen(manifest, "r");
+    if (NULL == f)
+    {
+        perror(manifest);
+        return -1;
+    }
+
+    size_t capacity = 0;
+    char *line = NULL;
+    size_t line_size = 0;
+    int line_no = 0;
+
+    while (getline(&line, &line_size, f) != -1)
+    {
+        line_no++;
+
+        char *image = strtok(line, " \t\r\n");
+        if (NULL == image || '#' == image[0])
+            continue;
+        char *in  = strtok(NULL, " \t\r\n");
+        char *out = strtok(NULL, " \t\r\n");
+        char *priority = out ? strtok(NULL, " \t\r\n") : NULL;
+        char *end = NULL;
+        long n = priority ? strtol(priority, &end, 10) : 1;
+
+        if (NULL == out || NULL != strtok(NULL, " \t\r\n") || (priority && (*end || n < 1 || n > 1000)))
+        {
+            fprintf(stderr, "%s:%d: expected an image, a stdin and a stdout path, and maybe a priority\n",
+                    manifest, line_no);
+            free(line);
+            fclose(f);
+            return -1;
+        }
+
+        if (job_count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 256;
+            Job *grown = realloc(jobs, capacity * sizeof(Job));
+            if (NULL == grown)
+            {
+                perror("realloc");
+                free(line);
+                fclose(f);
+                return -1;
+            }
+            jobs = grown;
+        }
+
+        Job *job = &jobs[job_count++];
+        memset(job, 0, sizeof(*job));
+        job->image    = strdup(image);
+        job->in_path  = strdup(in);
+        job->out_path = strdup(out);
+        job->priority = (int)n;
+        if (NULL == job->image || NULL == job->in_path || NULL == job->out_path)
+        {
+            perror("strdup");
+            free(line);
+            fclose(f);
+            return -1;
+        }
+    }
+
+    free(line);
+    fclose(f);
+    return 0;
+}
+
+
+
+static uint32_t hash_path(const char *path)
+{
+    uint32_t h = 2166136261u;   // FNV-1a
+    while (*path)
+        h = (h ^ (unsigned char)*path++) * 16777619u;
+    return h;
+}
+
+
+
+// Every image is read once and kept as a template, all the jobs on it
+// map the same one.
+static int load_images(void)
+{
+    size_t slots = 64;
+    while (slots < 2 * job_count)
+        slots *= 2;
+    Job **seen = calloc(slots, sizeof(Job *));
+    if (NULL == seen)
+    {
+        perror("calloc");
+        return -1;
+    }
+
+    static word_t words[MEMORY_SIZE];
+
+    for (size_t i = 0; i < job_count; i++)
+    {
+        Job *job = &jobs[i];
+        size_t slot = hash_path(job->image) & (slots - 1);
+        while (seen[slot] && 0 != strcmp(seen[slot]->image, job->image))
+            slot = (slot + 1) & (slots - 1);
+
+        if (seen[slot])
+        {
+            job->loaded     = seen[slot]->loaded;
+            job->load_errno = seen[slot]->load_errno;
+            continue;
+        }
+        seen[slot] = job;
+
+        FILE *f = fopen(job->image, "rb");
+        if (NULL == f)
+        {
+            job->load_errno = errno;
+            continue;
+        }
+        size_t count = fread(words, sizeof(word_t), MEMORY_SIZE, f);
+        fclose(f);
+
+        job->loaded = pvm_image_create(words, count * sizeof(word_t));
+        job->owns_image = 1;
+        if (NULL == job->loaded)
+            job->load_errno = errno;
+    }
+
+    free(seen);
+    return 0;
+}
+
+
+
+static int write_results(const char *results)
+{
+    FILE *f = fopen(results, "w");
+    if (NULL == f)
+    {
+        perror(results);
+        return -1;
+    }
+
+    static const char *status_names[] = {
+        [PVM_HALTED] = "halted",
+        [PVM_EXITED] = "exited",
+        [PVM_BUDGET] = "budget",
+        [PVM_ERROR]  = "error",
+        [PVM_BREAK]  = "break",
+        [PVM_OUT_OF_GAS] = "out-of-gas"
+    };
+
+    fprintf(f, "# job status exit instructions gas turns image [error]\n");
+    for (size_t i = 0; i < job_count; i++)
+    {
+        const Job *job = &jobs[i];
+        fprintf(f, "%zu %s %d %llu %llu %llu %s", i, status_names[job->result], job->exit_code,
+                (unsigned long long)job->instructions, (unsigned long long)job->gas,
+                (unsigned long long)job->turns, job->image);
+        if (PVM_ERROR == job->result)
+            fprintf(f, " %s", job->error);
+        fputc('\n', f);
+    }
+
+    fclose(f);
+    return 0;
+}
+
+
+
+int run_batch(const char *manifest, const char *results, int threads, uint64_t turn,
+              uint64_t gas)
+{
+    slice     = turn;
+    gas_limit = gas;
+    resident  = turn ? BATCH_RESIDENT : 1;
+
+    if (read_manifest(manifest) != 0 || load_images() != 0)
+        return -1;
+
+    if (threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if ((size_t)threads > job_count)
+        threads = job_count ? (int)job_count : 1;
+
+    workers = calloc(threads, sizeof(Worker));
+    if (NULL == workers)
+    {
+        perror("calloc");
+        return -1;
+    }
+    worker_count = threads;
+
+    for (int i = 0; i < worker_count; i++)
+    {
+        Worker *w = &workers[i];
+        w->sched       = pvm_sched_create(slice);
+        w->slots       = calloc(resident, sizeof(Slot));
+        w->idle        = malloc(resident * sizeof(Slot *));
+        w->deque.items = malloc((job_count + 1) * sizeof(size_t));
+        w->seed        = 2654435761u * (i + 1);
+        if (NULL == w->sched || NULL == w->slots || NULL == w->idle || NULL == w->deque.items)
+        {
+            perror("FATAL: Could not set up the workers");
+            return -1;
+        }
+
+        // Popped from the top, so the first slot gets the first job.
+        for (int j = 0; j < resident; j++)
+        {
+            w->slots[j].vm = pvm_create();
+            if (NULL == w->slots[j].vm)
+            {
+                perror("FATAL: Could not set up the workers");
+                return -1;
+            }
+            w->idle[resident - 1 - j] = &w->slots[j];
+        }
+        w->idle_count = resident;
+
+        // A contiguous share each, pushed back to front so the owner goes
+        // through it in manifest order and thieves take from the far end.
+        size_t first = job_count * i / worker_count;
+        size_t last  = job_count * (i + 1) / worker_count;
+        for (size_t j = last; j > first; j--)
+            deque_push(&w->deque, j - 1);
+    }
+
+    struct timespec t_start, t_end;
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+
+    for (int i = 0; i < worker_count; i++)
+    {
+        int err = pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+        if (err != 0)
+        {
+            fprintf(stderr, "FATAL: pthread_create: %s\n", strerror(err));
+            return -1;
+        }
+    }
+    for (int i = 0; i < worker_count; i++)
+        pthread_join(workers[i].thread, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &t_end);
+    double elapsed = (t_end.tv_sec - t_start.tv_sec) +
+                     (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+
+    size_t failed = 0;
+    uint64_t instructions = 0;
+    for (size_t i = 0; i < job_count; i++)
+    {
+        // Out of gas or stopped at a break is as good as an error here.
+        failed += PVM_EXITED != jobs[i].result && PVM_HALTED != jobs[i].result;
+        instructions += jobs[i].instructions;
+    }
+
+    printf("** Batch: %zu jobs on %d threads, %zu failed, %llu instructions in %.3f s **\n",
+           job_count, worker_count, failed, (unsigned long long)instructions, elapsed);
+
+    int written = write_results(results);
+
+    for (int i = 0; i < worker_count; i++)
+    {
+        for (int j = 0; j < resident; j++)
+            pvm_destroy(workers[i].slots[j].vm);
+        pvm_sched_destroy(workers[i].sched);
+        free(workers[i].slots);
+        free(workers[i].idle);
+        free(workers[i].deque.items);
+    }
+    free(workers);
+    for (size_t i = 0; i < job_count; i++)
+    {
+        free(jobs[i].image);
+        free(jobs[i].in_path);
+        free(jobs[i].out_path);
+        if (jobs[i].owns_image)
+            pvm_image_destroy(jobs[i].loaded);
+    }
+    free(jobs);
+
+    return (failed || written != 0) ? -1 : 0;
+}
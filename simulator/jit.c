@@ -0,0 +1,894 @@
+#define _DEFAULT_SOURCE
+
+#include "jit.h"
+#include "simulator.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <stddef.h>
+#include <sys/mman.h>
+
+
+
+// **Register assignment**
+//   rbx  &vm->memory[0]
+//   rbp  &vm->regs (PC is only written on the way out)
+//   r12  SP, zero-extended and only ever updated with 16-bit ops
+//   r14  LR
+//   r15  &TABLES
+// BR never changes while a program runs, so it is folded into the
+// addresses of LOAD and STORE when they are translated.
+
+#define JIT_BUFFER_SIZE  (16 * 1024 * 1024)
+#define MAX_BLOCK_LENGTH 256
+#define MAX_INSTR_BYTES  128        // One guest instruction and its stubs.
+#define MAX_STUBS        (MAX_BLOCK_LENGTH * 4)
+
+#define EAX 0
+#define ECX 1
+#define EDX 2
+
+// Why native code handed control back to run_jit().
+enum JitExitReason
+{
+    JIT_EXIT_CHAIN,     // Static target not translated yet, arg is the jump to patch.
+    JIT_EXIT_LOOKUP,    // Dynamic target not translated yet.
+    JIT_EXIT_TRAP,      // arg is the trap number.
+    JIT_EXIT_STORE,     // A STORE hit translated code, arg is the address.
+    JIT_EXIT_HALT,
+    JIT_EXIT_ILLEGAL,
+    JIT_EXIT_DIV_ZERO,
+    JIT_EXIT_UNDERFLOW,
+    JIT_EXIT_OVERFLOW
+};
+
+// Comes back in rax:rdx.
+typedef struct
+{
+    uint64_t reason;
+    uint64_t arg;
+} JitExit;
+
+typedef struct
+{
+    uint8_t  *entry[MEMORY_SIZE];   // Native code of the block starting here.
+    uint16_t  covered[MEMORY_SIZE]; // Live blocks that include this word.
+    uint64_t  executed;             // Every block adds its length on entry.
+} JitTables;
+
+typedef struct
+{
+    word_t   start;
+    word_t   length;
+    uint8_t *native;
+} JitBlock;
+
+// A jump to out-of-line code, filled in once the block body is done.
+typedef struct
+{
+    uint8_t *site;
+    int      reason;
+    word_t   pc;
+    uint32_t arg;
+    int      ran;           // Instructions of the block run by then.
+} JitStub;
+
+typedef JitExit (*jit_enter_t)(word_t *memory, Registers *regs,
+                               JitTables *tables, uint8_t *entry);
+
+// One VM at a time, the one run_jit() was last called for.
+static pvm_vm     *jit_vm = NULL;
+static JitTables   TABLES;
+static JitBlock   *blocks = NULL;
+static size_t      block_count = 0;
+static size_t      block_capacity = 0;
+static JitStub     stubs[MAX_STUBS];
+static int         stub_count = 0;
+
+static uint8_t    *buffer = NULL;
+static uint8_t    *code_ptr;
+static uint8_t    *code_base;      // First byte after the trampoline.
+static uint8_t    *exit_common;
+static jit_enter_t jit_enter;
+static unsigned    generation = 0; // Bumped by every full flush.
+
+
+
+// **Emitters**
+
+static void emit(const uint8_t *bytes, size_t n)
+{
+    memcpy(code_ptr, bytes, n);
+    code_ptr += n;
+}
+
+#define EMIT(...) do { const uint8_t b_[] = { __VA_ARGS__ }; emit(b_, sizeof(b_)); } while (0)
+
+static void emit16(uint16_t v) { memcpy(code_ptr, &v, 2); code_ptr += 2; }
+static void emit32(uint32_t v) { memcpy(code_ptr, &v, 4); code_ptr += 4; }
+
+// Points the rel32 at site to target.
+static void patch(uint8_t *site, uint8_t *target)
+{
+    int32_t rel = (int32_t)(target - (site + 4));
+    memcpy(site, &rel, 4);
+}
+
+static void emit_jmp_to(uint8_t *target)
+{
+    EMIT(0xE9);
+    emit32(0);
+    patch(code_ptr - 4, target);
+}
+
+// <op> on the word at vm->memory[SP + k], i.e. [rbx + r12*2 + 2k].
+static void emit_stack_operand(int word16, const uint8_t *op, size_t oplen, int reg, int k)
+{
+    if (word16)
+        EMIT(0x66);
+    EMIT(0x42);
+    emit(op, oplen);
+    if (0 == k)
+        EMIT((uint8_t)(0x04 | (reg << 3)), 0x63);
+    else
+        EMIT((uint8_t)(0x44 | (reg << 3)), 0x63, (uint8_t)(2 * k));
+}
+
+static void load_stack(int reg, int k)
+{
+    static const uint8_t movzx[] = { 0x0F, 0xB7 };
+    emit_stack_operand(0, movzx, 2, reg, k);
+}
+
+static void load_stack_signed(int reg, int k)
+{
+    static const uint8_t movsx[] = { 0x0F, 0xBF };
+    emit_stack_operand(0, movsx, 2, reg, k);
+}
+
+static void store_stack(int reg, int k)
+{
+    static const uint8_t mov[] = { 0x89 };
+    emit_stack_operand(1, mov, 1, reg, k);
+}
+
+// 0x83 /ext ib on the word at vm->memory[SP + k].
+static void group83_stack(int ext, int k, uint8_t imm)
+{
+    static const uint8_t op[] = { 0x83 };
+    emit_stack_operand(1, op, 1, ext, k);
+    EMIT(imm);
+}
+
+// add/sub/and/or/xor [vm->memory[SP + k]], reg
+static void alu_stack(uint8_t opcode, int reg, int k)
+{
+    const uint8_t op[] = { opcode };
+    emit_stack_operand(1, op, 1, reg, k);
+}
+
+static void sp_add(int n)
+{
+    if (n > 0)
+        EMIT(0x66, 0x41, 0x83, 0xC4, (uint8_t)n);   // add r12w, n
+    else
+        EMIT(0x66, 0x41, 0x83, 0xEC, (uint8_t)-n);  // sub r12w, n
+}
+
+// movzx reg, word [rbx + 2 * addr]
+static void load_abs(int reg, word_t addr)
+{
+    EMIT(0x0F, 0xB7, (uint8_t)(0x83 | (reg << 3)));
+    emit32((uint32_t)addr * 2);
+}
+
+// mov word [rbx + 2 * addr], reg
+static void store_abs(int reg, word_t addr)
+{
+    EMIT(0x66, 0x89, (uint8_t)(0x83 | (reg << 3)));
+    emit32((uint32_t)addr * 2);
+}
+
+// Leaves native code with vm->regs.PC = pc.
+static void emit_exit(int reason, word_t pc, uint32_t arg)
+{
+    EMIT(0x66, 0xC7, 0x45, (uint8_t)offsetof(Registers, PC));  // mov word [rbp + PC], pc
+    emit16(pc);
+    EMIT(0xB8);                                                 // mov eax, reason
+    emit32((uint32_t)reason);
+    EMIT(0xBA);                                                 // mov edx, arg
+    emit32(arg);
+    emit_jmp_to(exit_common);
+}
+
+// Same, but hands back the address of the jump that got us here,
+// so run_jit() can point it straight at the translated target.
+static void emit_chain_exit(word_t target, uint8_t *site)
+{
+    EMIT(0x66, 0xC7, 0x45, (uint8_t)offsetof(Registers, PC));
+    emit16(target);
+    EMIT(0x48, 0x8D, 0x15);                                     // lea rdx, [rip + site]
+    emit32(0);
+    patch(code_ptr - 4, site);
+    EMIT(0xB8);
+    emit32(JIT_EXIT_CHAIN);
+    emit_jmp_to(exit_common);
+}
+
+static void add_stub(uint8_t *site, int reason, word_t pc, uint32_t arg)
+{
+    JitStub *s = &stubs[stub_count++];
+    s->site   = site;
+    s->reason = reason;
+    s->pc     = pc;
+    s->arg    = arg;
+    s->ran    = 0;
+}
+
+// cc is the second byte of a 0x0F 0x8x jcc, or 0 for a plain jmp.
+static uint8_t *emit_branch_site(uint8_t cc)
+{
+    if (cc)
+        EMIT(0x0F, cc);
+    else
+        EMIT(0xE9);
+    emit32(0);
+    return code_ptr - 4;
+}
+
+static void jump_to_stub(uint8_t cc, int reason, word_t pc, uint32_t arg)
+{
+    add_stub(emit_branch_site(cc), reason, pc, arg);
+}
+
+// Jumps to the block at target, directly if it is already translated.
+static void emit_chain(uint8_t cc, word_t target)
+{
+    uint8_t *site = emit_branch_site(cc);
+
+    if (TABLES.entry[target] != NULL)
+        patch(site, TABLES.entry[target]);
+    else
+        add_stub(site, JIT_EXIT_CHAIN, target, 0);
+}
+
+// Jumps to the guest address in eax.
+static void emit_dynamic_jump(void)
+{
+    EMIT(0x49, 0x8B, 0x0C, 0xC7);   // mov rcx, [r15 + rax*8]
+    EMIT(0x48, 0x85, 0xC9);         // test rcx, rcx
+    EMIT(0x74, 0x02);               // jz +2
+    EMIT(0xFF, 0xE1);               // jmp rcx
+    EMIT(0x66, 0x89, 0x45, (uint8_t)offsetof(Registers, PC));  // mov [rbp + PC], ax
+    EMIT(0xB8);
+    emit32(JIT_EXIT_LOOKUP);
+    emit_jmp_to(exit_common);
+}
+
+// Same conditions as CHECK_STACK_* in isa_defs.h.
+static void check_overflow(word_t pc, int n)
+{
+#   ifndef BENCHMARK
+    EMIT(0x66, 0x41, 0x83, 0xFC, (uint8_t)n);  // cmp r12w, n
+    jump_to_stub(0x82, JIT_EXIT_OVERFLOW, pc, 0);           // jb
+#   else
+    (void)pc; (void)n;
+#   endif
+}
+
+static void check_underflow(word_t pc, int n)
+{
+#   ifndef BENCHMARK
+    EMIT(0x66, 0x41, 0x81, 0xFC);             // cmp r12w, INITIAL_SP - n
+    emit16((uint16_t)(INITIAL_SP - n));
+    jump_to_stub(0x87, JIT_EXIT_UNDERFLOW, pc, 0);          // ja
+#   else
+    (void)pc; (void)n;
+#   endif
+}
+
+
+
+// **Translation**
+
+static void flush_all(void)
+{
+    code_ptr = code_base;
+    memset(TABLES.entry, 0, sizeof(TABLES.entry));
+    memset(TABLES.covered, 0, sizeof(TABLES.covered));
+    block_count = 0;
+    generation++;
+}
+
+
+
+static void emit_alu(int func, word_t pc)
+{
+    switch (func)
+    {
+        case FUNC_ADD:
+        case FUNC_SUB:
+        case FUNC_AND:
+        case FUNC_OR:
+        case FUNC_XOR:
+        {
+            static const uint8_t opcodes[] = {
+                [FUNC_ADD] = 0x01, [FUNC_SUB] = 0x29, [FUNC_AND] = 0x21,
+                [FUNC_OR]  = 0x09, [FUNC_XOR] = 0x31
+            };
+            check_underflow(pc, 2);
+            load_stack(EAX, 0);
+            sp_add(1);
+            alu_stack(opcodes[func], EAX, 0);
+            break;
+        }
+
+        case FUNC_MULT:
+        {
+            static const uint8_t imul[] = { 0x0F, 0xAF };
+            check_underflow(pc, 2);
+            load_stack(EAX, 0);
+            sp_add(1);
+            emit_stack_operand(1, imul, 2, EAX, 0);  // imul ax, [sp]
+            store_stack(EAX, 0);
+            break;
+        }
+
+        case FUNC_DIV:
+            // Remainder below the quotient, like the interpreter.
+            check_underflow(pc, 2);
+            load_stack_signed(ECX, 0);
+            EMIT(0x85, 0xC9);                       // test ecx, ecx
+            jump_to_stub(0x84, JIT_EXIT_DIV_ZERO, pc, 0);
+            load_stack_signed(EAX, 1);
+            EMIT(0x99);                             // cdq
+            EMIT(0xF7, 0xF9);                       // idiv ecx
+            store_stack(EDX, 1);
+            store_stack(EAX, 0);
+            break;
+
+        case FUNC_NEG:
+        {
+            static const uint8_t neg[] = { 0xF7 };
+            check_underflow(pc, 1);
+            emit_stack_operand(1, neg, 1, 3, 0);
+            break;
+        }
+
+        case FUNC_INC:
+            check_underflow(pc, 1);
+            group83_stack(0, 0, 1);
+            break;
+
+        case FUNC_DEC:
+            check_underflow(pc, 1);
+            group83_stack(5, 0, 1);
+            break;
+
+        case FUNC_ABS:
+            check_underflow(pc, 1);
+            load_stack_signed(EAX, 0);
+            EMIT(0x89, 0xC1);                       // mov ecx, eax
+            EMIT(0xF7, 0xD9);                       // neg ecx
+            EMIT(0x0F, 0x48, 0xC8);                 // cmovs ecx, eax
+            store_stack(ECX, 0);
+            break;
+
+        case FUNC_NOT:
+            check_underflow(pc, 1);
+            group83_stack(7, 0, 0);                 // cmp word [sp], 0
+            EMIT(0x0F, 0x94, 0xC0);                 // sete al
+            EMIT(0x0F, 0xB6, 0xC0);                 // movzx eax, al
+            store_stack(EAX, 0);
+            break;
+
+        case FUNC_SHL:
+        case FUNC_SHR:
+            check_underflow(pc, 2);
+            load_stack(ECX, 0);
+            sp_add(1);
+            load_stack_signed(EAX, 0);
+            EMIT(0xD3, FUNC_SHL == func ? 0xE0 : 0xF8);  // shl/sar eax, cl
+            store_stack(EAX, 0);
+            break;
+    }
+}
+
+
+
+static void emit_stack_op(int func, word_t pc)
+{
+    switch (func)
+    {
+        case FUNC_SWAP:
+            check_underflow(pc, 2);
+            load_stack(EAX, 0);
+            load_stack(ECX, 1);
+            store_stack(ECX, 0);
+            store_stack(EAX, 1);
+            break;
+
+        case FUNC_DUP:
+            check_underflow(pc, 1);
+            check_overflow(pc, 1);
+            load_stack(EAX, 0);
+            sp_add(-1);
+            store_stack(EAX, 0);
+            break;
+
+        case FUNC_DROP:
+            check_underflow(pc, 1);
+            sp_add(1);
+            break;
+
+        case FUNC_OVER:
+            check_underflow(pc, 2);
+            check_overflow(pc, 1);
+            load_stack(EAX, 1);
+            sp_add(-1);
+            store_stack(EAX, 0);
+            break;
+    }
+}
+
+
+
+// Ends the block. With folded set, the offset came from the LDI just
+// before the branch and was never pushed, so both targets are static.
+static void emit_branch(int func, word_t pc, word_t next, sword_t offset, int folded)
+{
+    int compare = (FUNC_BEQ == func || FUNC_BNE == func);
+    int base    = folded ? 0 : 1;
+    int pops    = base + (compare ? 2 : 1);
+    uint8_t taken_cc = 0;
+
+    check_underflow(pc, pops);
+    if (!folded)
+        load_stack(EAX, 0);         // offset
+    load_stack(ECX, base);          // value, or rhs
+    if (compare)
+        load_stack(EDX, base + 1);  // lhs
+    sp_add(pops);
+
+    if (compare)
+        EMIT(0x66, 0x39, 0xD1);     // cmp cx, dx
+    else
+        EMIT(0x66, 0x85, 0xC9);     // test cx, cx
+
+    switch (func)
+    {
+        case FUNC_BEQ: taken_cc = 0x84; break;  // je
+        case FUNC_BNE: taken_cc = 0x85; break;  // jne
+        case FUNC_BZ:  taken_cc = 0x84; break;  // jz
+        case FUNC_BNZ: taken_cc = 0x85; break;  // jnz
+        case FUNC_BN:  taken_cc = 0x88; break;  // js
+        case FUNC_BP:  taken_cc = 0x8F; break;  // jg
+    }
+
+    if (folded)
+    {
+        emit_chain(taken_cc, (word_t)(next + offset));
+        emit_chain(0, next);
+        return;
+    }
+
+    // Not taken: flip the condition (x86 pairs them up in the low bit).
+    emit_chain(taken_cc ^ 1, next);
+
+    // Taken: next + sign_extend_12(offset).
+    EMIT(0xA9);                     // test eax, 0x800
+    emit32(0x0800);
+    EMIT(0x74, 0x05);               // jz +5
+    EMIT(0x0D);                     // or eax, 0xF000
+    emit32(0xF000);
+    EMIT(0x05);                     // add eax, next
+    emit32(next);
+    EMIT(0x0F, 0xB7, 0xC0);         // movzx eax, ax
+    emit_dynamic_jump();
+}
+
+
+
+static uint8_t *translate(pvm_vm *vm, word_t start)
+{
+    if (buffer + JIT_BUFFER_SIZE - code_ptr < MAX_BLOCK_LENGTH * MAX_INSTR_BYTES)
+        flush_all();
+
+    if (block_count == block_capacity)
+    {
+        block_capacity = block_capacity ? 2 * block_capacity : 1024;
+        JitBlock *grown = realloc(blocks, block_capacity * sizeof(JitBlock));
+        if (NULL == grown)
+            pvm_fail(vm, "realloc: out of memory");
+        blocks = grown;
+    }
+
+    uint8_t *entry = code_ptr;
+    stub_count = 0;
+
+    EMIT(0x49, 0x81, 0x87);         // add qword [r15 + executed], length
+    emit32((uint32_t)offsetof(JitTables, executed));
+    uint8_t *count_site = code_ptr;
+    emit32(0);
+
+    word_t pc = start;
+    int length = 0;
+    int done = 0;
+
+    while (!done)
+    {
+        Instruction in;
+        in.raw = vm->memory[pc];
+        int     arg  = in.fields.arg;
+        sword_t imm  = sign_extend_12(arg);
+        word_t  next = pc + 1;
+        length++;
+
+        switch (in.fields.opcode)
+        {
+            case OP_LDI:
+            {
+                Instruction after;
+                after.raw = vm->memory[next];
+                if (OP_BRANCH == after.fields.opcode &&
+                    after.fields.arg < BRANCH_FUNC_COUNT &&
+                    length < MAX_BLOCK_LENGTH)
+                {
+                    length++;
+                    emit_branch(after.fields.arg, next, (word_t)(next + 1), imm, 1);
+                    done = 1;
+                    break;
+                }
+                sp_add(-1);
+                {
+                    static const uint8_t mov[] = { 0xC7 };
+                    emit_stack_operand(1, mov, 1, 0, 0);
+                    emit16((word_t)imm);
+                }
+                break;
+            }
+
+            case OP_LOAD:
+                check_overflow(pc, 1);
+                load_abs(ECX, (word_t)(vm->regs.BR + imm));
+                sp_add(-1);
+                store_stack(ECX, 0);
+                break;
+
+            case OP_STORE:
+            {
+                word_t ea = vm->regs.BR + imm;
+                check_underflow(pc, 1);
+                load_stack(EAX, 0);
+                store_abs(EAX, ea);
+                sp_add(1);
+                // cmp word [r15 + covered[ea]], 0
+                EMIT(0x66, 0x41, 0x83, 0xBF);
+                emit32((uint32_t)(offsetof(JitTables, covered) + 2 * (size_t)ea));
+                EMIT(0x00);
+                jump_to_stub(0x85, JIT_EXIT_STORE, next, ea);
+                stubs[stub_count - 1].ran = length;
+                break;
+            }
+
+            case OP_JMP:
+                emit_chain(0, (word_t)(next + imm));
+                done = 1;
+                break;
+
+            case OP_JAL:
+                check_overflow(pc, 1);
+                sp_add(-1);
+                EMIT(0x66, 0x46, 0x89, 0x34, 0x63);  // mov [sp], r14w
+                EMIT(0x41, 0xBE);                    // mov r14d, next
+                emit32(next);
+                emit_chain(0, (word_t)(next + imm));
+                done = 1;
+                break;
+
+            case OP_RET:
+                check_underflow(pc, 1);
+                EMIT(0x44, 0x89, 0xF0);              // mov eax, r14d
+                EMIT(0x46, 0x0F, 0xB7, 0x34, 0x63);  // movzx r14d, word [sp]
+                sp_add(1);
+                emit_dynamic_jump();
+                done = 1;
+                break;
+
+            case OP_ALU_LOGIC:
+                if (arg >= ALU_FUNC_COUNT)
+                {
+                    emit_exit(JIT_EXIT_ILLEGAL, pc, 0);
+                    done = 1;
+                    break;
+                }
+                emit_alu(arg, pc);
+                break;
+
+            case OP_STACK_OPS:
+                if (arg >= STACK_FUNC_COUNT)
+                {
+                    emit_exit(JIT_EXIT_ILLEGAL, pc, 0);
+                    done = 1;
+                    break;
+                }
+                emit_stack_op(arg, pc);
+                break;
+
+            case OP_BRANCH:
+                if (arg >= BRANCH_FUNC_COUNT)
+                    emit_exit(JIT_EXIT_ILLEGAL, pc, 0);
+                else
+                    emit_branch(arg, pc, next, 0, 0);
+                done = 1;
+                break;
+
+            // Traps go back to run_jit(), they cost a syscall anyway.
+            case OP_TRAP:
+                emit_exit(JIT_EXIT_TRAP, pc, (uint32_t)arg);
+                done = 1;
+                break;
+
+            case OP_HALT:
+                emit_exit(JIT_EXIT_HALT, pc, 0);
+                done = 1;
+                break;
+
+            default:
+                emit_exit(JIT_EXIT_ILLEGAL, pc, 0);
+                done = 1;
+                break;
+        }
+
+        if (!done && length >= MAX_BLOCK_LENGTH)
+        {
+            emit_chain(0, next);
+            done = 1;
+        }
+        pc = next;
+    }
+
+    memcpy(count_site, &(uint32_t){ (uint32_t)length }, 4);
+
+    // Out-of-line exits.
+    for (int i = 0; i < stub_count; i++)
+    {
+        patch(stubs[i].site, code_ptr);
+        if (JIT_EXIT_CHAIN == stubs[i].reason)
+        {
+            emit_chain_exit(stubs[i].pc, stubs[i].site);
+            continue;
+        }
+        // The block was counted whole on entry, the rest of it is
+        // counted again by whatever runs it after the STORE.
+        if (JIT_EXIT_STORE == stubs[i].reason)
+        {
+            EMIT(0x49, 0x81, 0xAF);     // sub qword [r15 + executed], unrun
+            emit32((uint32_t)offsetof(JitTables, executed));
+            emit32((uint32_t)(length - stubs[i].ran));
+        }
+        emit_exit(stubs[i].reason, stubs[i].pc, stubs[i].arg);
+    }
+
+    JitBlock *b = &blocks[block_count++];
+    b->start  = start;
+    b->length = (word_t)length;
+    b->native = entry;
+
+    for (int i = 0; i < length; i++)
+        TABLES.covered[(word_t)(start + i)]++;
+    TABLES.entry[start] = entry;
+
+    return entry;
+}
+
+
+
+// Direct jumps from other blocks still land on the old entry, so it is
+// turned into a jump through TABLES.entry. Patching it to the new
+// translation instead would chain redirects through every translation
+// a block that keeps being rewritten ever had.
+static void kill_block(JitBlock *b)
+{
+    for (int i = 0; i < b->length; i++)
+        TABLES.covered[(word_t)(b->start + i)]--;
+    if (TABLES.entry[b->start] == b->native)
+        TABLES.entry[b->start] = NULL;
+
+    uint8_t *redirect = code_ptr;
+    EMIT(0xB8);                     // mov eax, start
+    emit32(b->start);
+    emit_dynamic_jump();
+    b->native[0] = 0xE9;
+    patch(b->native + 1, redirect);
+}
+
+
+
+void jit_invalidate(pvm_vm *vm, word_t addr, word_t count)
+{
+    if (NULL == buffer || vm != jit_vm)
+        return;
+
+    int hit = 0;
+    for (int i = 0; i < count && !hit; i++)
+        hit = TABLES.covered[(word_t)(addr + i)] != 0;
+    if (!hit)
+        return;
+
+    // Only live blocks are kept in the list, a dead one lives on as the
+    // redirect kill_block() leaves behind. Programs that patch their own
+    // code in a loop would otherwise make this scan longer every time.
+    for (size_t n = 0; n < block_count; )
+    {
+        JitBlock *b = &blocks[n];
+        int overlaps = 0;
+        for (int i = 0; i < b->length && !overlaps; i++)
+            overlaps = (word_t)(b->start + i - addr) < count;
+
+        if (!overlaps)
+        {
+            n++;
+            continue;
+        }
+
+        // Each redirect needs room for a chain exit.
+        if (buffer + JIT_BUFFER_SIZE - code_ptr < MAX_INSTR_BYTES)
+        {
+            flush_all();
+            return;
+        }
+        kill_block(b);
+        blocks[n] = blocks[--block_count];
+    }
+}
+
+
+
+// The trampoline from C into translated code, and the common exit back.
+static int jit_init(void)
+{
+    // Run again (the bench harness does): start from an empty cache.
+    if (buffer)
+    {
+        flush_all();
+        return 1;
+    }
+
+    buffer = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == buffer)
+    {
+        buffer = NULL;
+        return 0;
+    }
+
+    code_ptr = buffer;
+    jit_enter = (jit_enter_t)(uintptr_t)code_ptr;
+    EMIT(0x53, 0x55, 0x41, 0x54, 0x41, 0x55,   // push rbx, rbp, r12, r13
+         0x41, 0x56, 0x41, 0x57,               // push r14, r15
+         0x48, 0x83, 0xEC, 0x08);              // sub rsp, 8
+    EMIT(0x48, 0x89, 0xFB);                    // mov rbx, rdi
+    EMIT(0x48, 0x89, 0xF5);                    // mov rbp, rsi
+    EMIT(0x49, 0x89, 0xD7);                    // mov r15, rdx
+    EMIT(0x44, 0x0F, 0xB7, 0x65, (uint8_t)offsetof(Registers, SP));  // movzx r12d, [rbp + SP]
+    EMIT(0x44, 0x0F, 0xB7, 0x75, (uint8_t)offsetof(Registers, LR));  // movzx r14d, [rbp + LR]
+    EMIT(0xFF, 0xE1);                          // jmp rcx
+
+    exit_common = code_ptr;
+    EMIT(0x66, 0x44, 0x89, 0x65, (uint8_t)offsetof(Registers, SP));  // mov [rbp + SP], r12w
+    EMIT(0x66, 0x44, 0x89, 0x75, (uint8_t)offsetof(Registers, LR));  // mov [rbp + LR], r14w
+    EMIT(0x48, 0x83, 0xC4, 0x08);              // add rsp, 8
+    EMIT(0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D,   // pop r15, r14, r13
+         0x41, 0x5C, 0x5D, 0x5B, 0xC3);        // pop r12, rbp, rbx; ret
+
+    code_base = code_ptr;
+    flush_all();
+    return 1;
+}
+
+
+
+static pvm_status run_jit(pvm_vm *vm)
+{
+    jit_vm = vm;
+    TABLES.executed = 0;
+
+    for (;;)
+    {
+        uint8_t *entry = TABLES.entry[vm->regs.PC];
+        if (NULL == entry)
+            entry = translate(vm, vm->regs.PC);
+
+        JitExit e = jit_enter(vm->memory, &vm->regs, &TABLES, entry);
+
+        switch (e.reason)
+        {
+            case JIT_EXIT_CHAIN:
+            {
+                unsigned before = generation;
+                uint8_t *target = TABLES.entry[vm->regs.PC];
+                if (NULL == target)
+                    target = translate(vm, vm->regs.PC);
+                // A full flush threw the jump away along with everything else.
+                if (before == generation)
+                    patch((uint8_t *)(uintptr_t)e.arg, target);
+                break;
+            }
+
+            case JIT_EXIT_LOOKUP:
+                break;
+
+            case JIT_EXIT_TRAP:
+                vm->instructions += TABLES.executed;
+                TABLES.executed = 0;
+                if (execute_trap(vm, (int)e.arg, vm->regs.PC))
+                    return PVM_EXITED;
+                vm->regs.PC++;
+                break;
+
+            case JIT_EXIT_STORE:
+                jit_invalidate(vm, (word_t)e.arg, 1);
+                break;
+
+            case JIT_EXIT_HALT:
+                vm->instructions += TABLES.executed;
+                return PVM_HALTED;
+
+            case JIT_EXIT_ILLEGAL:
+                illegal_instruction(vm, vm->regs.PC);
+
+            case JIT_EXIT_DIV_ZERO:
+                pvm_fail(vm, "Divide by zero.");
+
+            case JIT_EXIT_UNDERFLOW:
+                pvm_fail(vm, "Stack underflow");
+
+            case JIT_EXIT_OVERFLOW:
+                pvm_fail(vm, "Stack overflow");
+        }
+    }
+}
+
+
+
+pvm_status pvm_run_jit(pvm_vm *vm)
+{
+    // Translated LOADs and STOREs don't know about it.
+    if (vm->console)
+        return pvm_run(vm, 0);
+
+    if (!jit_init())
+    {
+        perror("Warning: could not map the JIT buffer, using the interpreter");
+        return pvm_run(vm, 0);
+    }
+
+    if (setjmp(vm->bail))
+    {
+        flush_guest_output(vm);
+        return PVM_ERROR;
+    }
+    pvm_status status = run_jit(vm);
+    flush_guest_output(vm);
+    return status;
+}
+
+#else
+
+pvm_status pvm_run_jit(pvm_vm *vm)
+{
+    fprintf(stderr, "Warning: --jit needs x86-64 Linux, using the interpreter.\n");
+    return pvm_run(vm, 0);
+}
+
+
+
+void jit_invalidate(pvm_vm *vm, word_t addr, word_t count)
+{
+    (void)vm;
+    (void)addr;
+    (void)count;
+}
+
+#endif
@@ -0,0 +1,143 @@
+#define _DEFAULT_SOURCE
+
+#include "perf_counters.h"
+
+#ifdef __linux__
+#   include <linux/perf_event.h>
+#   include <sys/ioctl.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+
+
+static int      counter_fd[PERF_COUNTER_COUNT] = { -1, -1, -1, -1 };
+static uint64_t tsc_start = 0;
+
+static uint64_t read_tsc(void)
+{
+#   if defined(__x86_64__) || defined(__i386__)
+    uint32_t lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#   else
+    return 0;
+#   endif
+}
+
+
+
+#ifdef __linux__
+static int open_counter(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = type;
+    attr.config         = config;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+
+    // This process, any CPU.
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+
+
+void perf_counters_start(void)
+{
+#   ifdef __linux__
+    counter_fd[PERF_CYCLES]        = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    counter_fd[PERF_INSTRUCTIONS]  = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    counter_fd[PERF_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    counter_fd[PERF_L1D_MISSES]    = open_counter(PERF_TYPE_HW_CACHE,
+                                                  PERF_COUNT_HW_CACHE_L1D |
+                                                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    {
+        if (counter_fd[i] >= 0)
+        {
+            ioctl(counter_fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#   endif
+
+    tsc_start = read_tsc();
+}
+
+
+
+void perf_counters_stop(PerfCounts *out)
+{
+    uint64_t tsc_end = read_tsc();
+    int any = 0;
+
+    memset(out, 0, sizeof(*out));
+
+#   ifdef __linux__
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    {
+        if (counter_fd[i] < 0)
+            continue;
+
+        ioctl(counter_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (sizeof(uint64_t) == read(counter_fd[i], &out->value[i], sizeof(uint64_t)))
+        {
+            out->valid[i] = 1;
+            any = 1;
+        }
+        close(counter_fd[i]);
+        counter_fd[i] = -1;
+    }
+#   endif
+
+    if (!any && tsc_start != 0)
+    {
+        out->value[PERF_CYCLES] = tsc_end - tsc_start;
+        out->valid[PERF_CYCLES] = 1;
+        out->from_tsc = 1;
+    }
+}
+
+
+
+void perf_counters_report(FILE *out, const PerfCounts *c, uint64_t guest)
+{
+    double n = guest ? (double)guest : 1.0;
+
+    if (c->from_tsc)
+    {
+        fprintf(out, "TSC ticks: %llu (%.2f/instr), perf counters unavailable\n",
+                (unsigned long long)c->value[PERF_CYCLES], c->value[PERF_CYCLES] / n);
+        return;
+    }
+
+    if (!c->valid[PERF_CYCLES] && !c->valid[PERF_INSTRUCTIONS] &&
+        !c->valid[PERF_BRANCH_MISSES] && !c->valid[PERF_L1D_MISSES])
+    {
+        fprintf(out, "Host counters unavailable\n");
+        return;
+    }
+
+    static const char *names[PERF_COUNTER_COUNT] = {
+        [PERF_CYCLES]        = "Host cycles",
+        [PERF_INSTRUCTIONS]  = "host instr",
+        [PERF_BRANCH_MISSES] = "branch-misses",
+        [PERF_L1D_MISSES]    = "L1d misses"
+    };
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    {
+        fprintf(out, "%s%s: ", i ? ", " : "", names[i]);
+        if (c->valid[i])
+            fprintf(out, "%llu (%.3f/instr)", (unsigned long long)c->value[i], c->value[i] / n);
+        else
+            fprintf(out, "n/a");
+    }
+    fprintf(out, "\n");
+}
@@ -0,0 +1,537 @@
+#define _GNU_SOURCE
+
+#include "pinnacle.h"
+#include "simulator.h"
+#include "trap_handlers.h"
+#include "trace.h"
+#include <stdarg.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+
+// The public side of the VM, see pinnacle.h.
+
+#define MEMORY_BYTES (MEMORY_SIZE * sizeof(word_t))
+#define CACHE_BYTES  (MEMORY_SIZE * sizeof(DecodedInstr))
+
+#define CACHE_NONE     0
+#define CACHE_BUILDING 1
+#define CACHE_READY    2
+
+// The rest of every decoded cache is this: all of it still to decode.
+static int blank_cache_fd = -1;
+static int blank_cache_state = CACHE_NONE;
+
+
+
+// **Templates**
+
+static void *map_anonymous(size_t bytes)
+{
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return MAP_FAILED == p ? NULL : p;
+}
+
+
+
+static int map_template(void *addr, size_t bytes, int fd, off_t offset)
+{
+    void *p = mmap(addr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset);
+    return MAP_FAILED == p ? -1 : 0;
+}
+
+
+
+// Drops what the VM wrote over a template mapping, the next touch
+// faults the template's page back in.
+static int discard_writes(void *addr, size_t bytes)
+{
+#   ifdef __linux__
+    return madvise(addr, bytes, MADV_DONTNEED);
+#   else
+    // Elsewhere DONTNEED may keep private pages, they get mapped again.
+    (void)addr;
+    (void)bytes;
+    return -1;
+#   endif
+}
+
+
+
+// A file of size bytes that starts with data and is zero after it.
+static int make_template(const void *data, size_t bytes, size_t size)
+{
+#   ifdef __linux__
+    int fd = memfd_create("pinnacle", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#   else
+    char path[] = "/tmp/pinnacle-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd != -1)
+        unlink(path);
+#   endif
+    if (-1 == fd)
+        return -1;
+
+    if (ftruncate(fd, size) != 0 ||
+        (bytes > 0 && pwrite(fd, data, bytes, 0) != (ssize_t)bytes))
+    {
+        close(fd);
+        return -1;
+    }
+
+#   ifdef __linux__
+    // Nothing changes it under the VMs that map it.
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+#   endif
+    return fd;
+}
+
+
+
+// Once per process. If another VM is busy making it, this one doesn't
+// share its cache, the next one on the image will.
+static int make_blank_cache(void *decode_handler)
+{
+    int state = CACHE_NONE;
+    if (__atomic_compare_exchange_n(&blank_cache_state, &state, CACHE_BUILDING,
+                                    0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+    {
+        DecodedInstr *blank = malloc(CACHE_BYTES);
+        if (blank)
+        {
+            for (int addr = 0; addr < MEMORY_SIZE; addr++)
+            {
+                blank[addr].handler = decode_handler;
+                blank[addr].operand = 0;
+            }
+            blank_cache_fd = make_template(blank, CACHE_BYTES, CACHE_BYTES);
+            free(blank);
+        }
+        state = -1 == blank_cache_fd ? CACHE_NONE : CACHE_READY;
+        __atomic_store_n(&blank_cache_state, state, __ATOMIC_RELEASE);
+    }
+    return CACHE_READY == state ? 0 : -1;
+}
+
+
+
+void share_code_cache(pvm_vm *vm, void *decode_handler)
+{
+    pvm_image *image = vm->image;
+    int state = CACHE_NONE;
+
+    // Profiling decodes to op_profile, the console to its own handlers,
+    // and tracing and a break point keep idioms from being fused, nobody
+    // else wants that.
+    if (NULL == image || profiling || trace_enabled || vm->console || vm->break_pc >= 0 ||
+        !__atomic_compare_exchange_n(&image->cache_state, &state, CACHE_BUILDING,
+                                     0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+
+    if (0 == make_blank_cache(decode_handler))
+        image->cache_fd = make_template(vm->code_cache, image->cache_bytes, image->cache_bytes);
+
+    state = -1 == image->cache_fd ? CACHE_NONE : CACHE_READY;
+    __atomic_store_n(&image->cache_state, state, __ATOMIC_RELEASE);
+}
+
+
+
+// Points the VM's decoded cache at its image's, if there is one yet.
+// Otherwise at the blank one, which leaves the interpreter only the code
+// to decode rather than the whole cache to clear first.
+static void map_code_cache(pvm_vm *vm)
+{
+    pvm_image *image = vm->image;
+    char *cache = (char *)vm->code_cache;
+    size_t decoded = 0;
+
+    vm->cache_ready  = 0;
+    vm->cache_mapped = MAPPED_NONE;
+
+    if (CACHE_READY != __atomic_load_n(&blank_cache_state, __ATOMIC_ACQUIRE))
+        return;
+    // Profiling, tracing and the console decode differently, the image's
+    // cache isn't for them.
+    if (!profiling && !trace_enabled && !vm->console && CACHE_READY == __atomic_load_n(&image->cache_state, __ATOMIC_ACQUIRE))
+        decoded = image->cache_bytes;
+
+    if (decoded > 0 && map_template(cache, decoded, image->cache_fd, 0) != 0)
+        return;
+    if (decoded < CACHE_BYTES &&
+        map_template(cache + decoded, CACHE_BYTES - decoded, blank_cache_fd, decoded) != 0)
+        return;
+
+    vm->cache_ready  = decoded > 0;
+    vm->cache_mapped = decoded > 0 ? MAPPED_IMAGE : MAPPED_BLANK;
+}
+
+
+
+static void release_image(pvm_image *image)
+{
+    if (image && 0 == __atomic_sub_fetch(&image->refs, 1, __ATOMIC_ACQ_REL))
+    {
+        close(image->fd);
+        if (image->cache_fd != -1)
+            close(image->cache_fd);
+        free(image);
+    }
+}
+
+
+
+// Same starting state as pvm has always had, unless the image is a
+// snapshot that starts further along.
+static void reset_state(pvm_vm *vm)
+{
+    if (vm->image)
+    {
+        vm->regs         = vm->image->start;
+        vm->instructions = vm->image->instructions;
+    }
+    else
+    {
+        memset(&vm->regs, 0, sizeof(vm->regs));
+        vm->regs.PC = CODE_START;
+        vm->regs.SP = INITIAL_SP;
+        vm->regs.BR = vm->memory[0x0000];
+        vm->instructions = 0;
+    }
+
+    vm->gas_used = 0;
+
+    vm->status = 0;
+    memset(vm->fused_hits, 0, sizeof(vm->fused_hits));
+    memset(vm->open_files, 0, sizeof(vm->open_files));
+    vm->untracked_files = 0;
+    vm->output_used = 0;
+    vm->input_pos = vm->input_used = 0;
+    vm->error[0] = '\0';
+}
+
+
+
+uint64_t hash_image(const void *image, size_t bytes)
+{
+    const unsigned char *p = image;
+    uint64_t h = 14695981039346656037ull;   // FNV-1a
+    for (size_t i = 0; i < bytes; i++)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+
+
+pvm_image *image_from_file(int fd, off_t offset, const Registers *start,
+                           uint64_t instructions, uint64_t hash)
+{
+    pvm_image *t = calloc(1, sizeof(pvm_image));
+    if (NULL == t)
+        return NULL;
+
+    t->fd           = fd;
+    t->offset       = offset;
+    t->words        = MEMORY_SIZE;
+    t->hash         = hash;
+    t->start        = *start;
+    t->instructions = instructions;
+    t->refs         = 1;
+    t->cache_fd     = -1;
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t used = ((size_t)start->BR + MAX_FUSED_LENGTH) * sizeof(DecodedInstr);
+    t->cache_bytes = (used + page - 1) / page * page;
+    if (t->cache_bytes > CACHE_BYTES)
+        t->cache_bytes = CACHE_BYTES;
+    return t;
+}
+
+
+
+// **Lifecycle**
+
+pvm_vm *pvm_create(void)
+{
+    pvm_vm *vm = calloc(1, sizeof(pvm_vm));
+    if (NULL == vm)
+        return NULL;
+
+    // Mapped rather than allocated, images get mapped over them.
+    vm->memory     = map_anonymous(MEMORY_BYTES);
+    vm->code_cache = map_anonymous(CACHE_BYTES);
+    if (NULL == vm->memory || NULL == vm->code_cache)
+    {
+        pvm_destroy(vm);
+        return NULL;
+    }
+
+    vm->io = HOST_IO;
+    vm->buffered   = 1;
+    vm->break_pc   = -1;
+    vm->break_trap = -1;
+    initialize_trap_table(vm);
+    pvm_load_image(vm, NULL, 0);
+    return vm;
+}
+
+
+
+void pvm_destroy(pvm_vm *vm)
+{
+    if (NULL == vm)
+        return;
+    if (vm->memory)
+        munmap(vm->memory, MEMORY_BYTES);
+    if (vm->code_cache)
+        munmap(vm->code_cache, CACHE_BYTES);
+    release_image(vm->image);
+    free(vm);
+}
+
+
+
+size_t pvm_load_image(pvm_vm *vm, const void *image, size_t bytes)
+{
+    pvm_image *loaded = pvm_image_create(image, bytes);
+    if (loaded && 0 == pvm_map_image(vm, loaded))
+    {
+        size_t words = loaded->words;
+        pvm_image_destroy(loaded);
+        return words;
+    }
+    pvm_image_destroy(loaded);
+
+    // No template, copy it in. pvm_reset() has nothing to go back to.
+    size_t words = bytes / sizeof(word_t);
+    if (words > MEMORY_SIZE)
+        words = MEMORY_SIZE;
+
+    if (words > 0)
+        memcpy(vm->memory, image, words * sizeof(word_t));
+    memset(vm->memory + words, 0, (MEMORY_SIZE - words) * sizeof(word_t));
+
+    release_image(vm->image);
+    vm->image        = NULL;
+    vm->cache_ready  = 0;
+    vm->cache_mapped = MAPPED_NONE;
+    reset_state(vm);
+    return words;
+}
+
+
+
+pvm_image *pvm_image_create(const void *image, size_t bytes)
+{
+    size_t words = bytes / sizeof(word_t);
+    if (words > MEMORY_SIZE)
+        words = MEMORY_SIZE;
+
+    Registers start;
+    memset(&start, 0, sizeof(start));
+    start.PC = CODE_START;
+    start.SP = INITIAL_SP;
+    if (words > 0)
+        memcpy(&start.BR, image, sizeof(word_t));
+
+    int fd = make_template(image, words * sizeof(word_t), MEMORY_BYTES);
+    if (-1 == fd)
+        return NULL;
+
+    pvm_image *t = image_from_file(fd, 0, &start, 0, hash_image(image, words * sizeof(word_t)));
+    if (NULL == t)
+    {
+        close(fd);
+        return NULL;
+    }
+    t->words = words;
+    return t;
+}
+
+
+
+void pvm_image_destroy(pvm_image *image)
+{
+    release_image(image);
+}
+
+
+
+int pvm_map_image(pvm_vm *vm, pvm_image *image)
+{
+    if (image != vm->image)
+    {
+        if (map_template(vm->memory, MEMORY_BYTES, image->fd, image->offset) != 0)
+            return -1;
+
+        __atomic_add_fetch(&image->refs, 1, __ATOMIC_RELAXED);
+        release_image(vm->image);
+        vm->image        = image;
+        vm->cache_mapped = MAPPED_NONE;
+    }
+    return pvm_reset(vm);
+}
+
+
+
+int pvm_reset(pvm_vm *vm)
+{
+    pvm_image *image = vm->image;
+    if (NULL == image)
+        return -1;
+
+    if (discard_writes(vm->memory, MEMORY_BYTES) != 0 &&
+        map_template(vm->memory, MEMORY_BYTES, image->fd, image->offset) != 0)
+        return -1;
+
+    if (MAPPED_IMAGE == vm->cache_mapped && 0 == discard_writes(vm->code_cache, CACHE_BYTES))
+        vm->cache_ready = 1;
+    else
+        map_code_cache(vm);
+
+    reset_state(vm);
+    return 0;
+}
+
+
+
+pvm_status pvm_run(pvm_vm *vm, uint64_t max_instructions)
+{
+    // A write hook may pvm_fail() from the last flush too, it lands here
+    // with nothing left to write.
+    if (setjmp(vm->bail))
+    {
+        flush_guest_output(vm);
+        return PVM_ERROR;
+    }
+    pvm_status status = run_simulator(vm, max_instructions);
+    flush_guest_output(vm);
+    return status;
+}
+
+
+
+void pvm_set_io(pvm_vm *vm, const pvm_io *io)
+{
+    vm->io = io ? *io : HOST_IO;
+
+    // Whatever wasn't given stays with the host.
+    if (NULL == vm->io.read)  vm->io.read  = HOST_IO.read;
+    if (NULL == vm->io.write) vm->io.write = HOST_IO.write;
+    if (NULL == vm->io.open)  vm->io.open  = HOST_IO.open;
+    if (NULL == vm->io.close) vm->io.close = HOST_IO.close;
+}
+
+
+
+void pvm_set_buffering(pvm_vm *vm, int buffered)
+{
+    vm->buffered = buffered;
+}
+
+
+
+void pvm_set_console(pvm_vm *vm, int on)
+{
+    // It changes what two instructions decode to, whatever was decoded
+    // is for the other way.
+    if (!on == !vm->console)
+        return;
+    vm->console      = !!on;
+    vm->cache_ready  = 0;
+    vm->cache_mapped = MAPPED_NONE;
+}
+
+
+
+void pvm_set_trap(pvm_vm *vm, int trap, pvm_trap_fn handler)
+{
+    if (trap >= 0 && trap < 256)
+        vm->traps[trap] = handler;
+}
+
+
+
+void pvm_set_gas(pvm_vm *vm, uint64_t limit)
+{
+    vm->gas_limit = limit;
+}
+
+
+
+void pvm_break_at(pvm_vm *vm, int pc)
+{
+    vm->break_pc = pc >= 0 && pc < MEMORY_SIZE ? pc : -1;
+}
+
+
+
+void pvm_break_on_trap(pvm_vm *vm, int trap)
+{
+    vm->break_trap = trap >= 0 && trap < 256 ? trap : -1;
+}
+
+
+
+// **For trap handlers**
+
+void pvm_push(pvm_vm *vm, uint16_t value)
+{
+    CHECK_SP_OVERFLOW(1);
+    vm->memory[--vm->regs.SP] = value;
+}
+
+
+
+uint16_t pvm_pop(pvm_vm *vm)
+{
+    CHECK_SP_UNDERFLOW(1);
+    return vm->memory[vm->regs.SP++];
+}
+
+
+
+void pvm_fail(pvm_vm *vm, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(vm->error, sizeof(vm->error), fmt, args);
+    va_end(args);
+    longjmp(vm->bail, 1);
+}
+
+
+
+// **State**
+
+uint16_t *pvm_memory(pvm_vm *vm)
+{
+    return vm->memory;
+}
+
+uint16_t pvm_pc(const pvm_vm *vm)
+{
+    return vm->regs.PC;
+}
+
+int pvm_exit_status(const pvm_vm *vm)
+{
+    return vm->status;
+}
+
+uint64_t pvm_instructions(const pvm_vm *vm)
+{
+    return vm->instructions;
+}
+
+uint64_t pvm_gas_used(const pvm_vm *vm)
+{
+    return vm->gas_used;
+}
+
+const char *pvm_error(const pvm_vm *vm)
+{
+    return vm->error;
+}
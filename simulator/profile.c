@@ -0,0 +1,85 @@
+#include "profile.h"
+
+
+
+Profile PROFILE;
+
+// The branch that ran last, resolved by whichever instruction runs next.
+static int    pending_branch = 0;
+static word_t branch_pc;
+
+
+
+static int has_func(int opcode)
+{
+    return OP_ALU_LOGIC == opcode || OP_STACK_OPS == opcode || OP_BRANCH == opcode;
+}
+
+
+
+void profile_instruction(const word_t *memory, word_t pc)
+{
+    Instruction in;
+    in.raw = memory[pc];
+    int opcode = in.fields.opcode;
+    int arg    = in.fields.arg;
+
+    // An offset of 0 lands on pc + 1 as well, it counts as not taken.
+    if (pending_branch)
+    {
+        if (pc == (word_t)(branch_pc + 1))
+            PROFILE.not_taken[branch_pc]++;
+        else
+            PROFILE.taken[branch_pc]++;
+        pending_branch = 0;
+    }
+
+    PROFILE.pc[pc]++;
+    PROFILE.total++;
+    PROFILE.ops[opcode][has_func(opcode) && arg < 16 ? arg : 0]++;
+
+    if (OP_BRANCH == opcode)
+    {
+        pending_branch = 1;
+        branch_pc = pc;
+    }
+    else if (OP_JAL == opcode)
+    {
+        PROFILE.calls[(word_t)(pc + 1 + sign_extend_12(arg))]++;
+    }
+}
+
+
+
+int write_profile(const char *filename)
+{
+    FILE *out = fopen(filename, "w");
+    if (NULL == out)
+    {
+        perror("Could not write the profile");
+        return -1;
+    }
+
+    fprintf(out, "# pvm profile v%d\n", PROFILE_VERSION);
+    fprintf(out, "total %llu\n", (unsigned long long)PROFILE.total);
+
+    for (int addr = 0; addr < MEMORY_SIZE; addr++)
+    {
+        if (PROFILE.pc[addr])
+            fprintf(out, "pc 0x%04X %llu\n", addr, (unsigned long long)PROFILE.pc[addr]);
+        if (PROFILE.taken[addr] || PROFILE.not_taken[addr])
+            fprintf(out, "branch 0x%04X %llu %llu\n", addr,
+                    (unsigned long long)PROFILE.taken[addr],
+                    (unsigned long long)PROFILE.not_taken[addr]);
+        if (PROFILE.calls[addr])
+            fprintf(out, "call 0x%04X %llu\n", addr, (unsigned long long)PROFILE.calls[addr]);
+    }
+
+    for (int op = 0; op < 16; op++)
+        for (int func = 0; func < 16; func++)
+            if (PROFILE.ops[op][func])
+                fprintf(out, "op 0x%X 0x%X %llu\n", op, func, (unsigned long long)PROFILE.ops[op][func]);
+
+    fclose(out);
+    return 0;
+}
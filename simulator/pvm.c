@@ -0,0 +1,400 @@
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "pinnacle.h"
+#include "isa_defs.h"
+#include "simulator.h"
+#include "superinstructions.h"
+#include "jit.h"
+#include "trace.h"
+#include "profile.h"
+#include "sampler.h"
+#include "batch.h"
+#include "snapshot.h"
+#ifdef BENCHMARK
+#   include <time.h>
+#   include "perf_counters.h"
+#endif
+
+
+
+// pvm: runs a.out.bin from the current directory on libpinnacle.
+
+#ifdef BENCHMARK
+    static struct timespec t_start;
+
+    static void log_benchmark(uint64_t instr_count)
+    {
+#       ifndef NO_LOG
+        PerfCounts counts;
+        perf_counters_stop(&counts);
+        struct timespec t_end;
+        clock_gettime(CLOCK_MONOTONIC, &t_end);
+        double elapsed = (t_end.tv_sec - t_start.tv_sec) +
+                         (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
+        fprintf(log_file,
+                "Instr: %llu, elapsed: %.9f s, IPS: %.2f M\n",
+                (unsigned long long)instr_count,
+                elapsed, instr_count / (elapsed * 1e6));
+        perf_counters_report(log_file, &counts, instr_count);
+#       else
+        (void)t_start;
+        (void)instr_count;
+#       endif
+    }
+#else
+#   define log_benchmark(n) ((void)0)
+#endif
+
+
+
+static void write_profile_at_exit(void)
+{
+    write_profile(PROFILE_FILE);
+}
+
+
+
+static void write_samples_at_exit(void)
+{
+    write_samples();
+}
+
+
+
+// Memory loading function. With a snapshot, a.out.bin is only there to
+// check it's a snapshot of this program.
+static void load_memory(pvm_vm *vm, const char *filename, const char *snapshot)
+{
+    static word_t image[MEMORY_SIZE];
+    FILE *f = fopen(filename, "rb");
+
+    // Always use protection.
+    if (NULL == f)
+    {
+        perror("Error opening binary file");
+        fprintf(stderr, "FATAL: Please ensure 'a.out.bin' exists and is accessible.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t words_read = fread(image, sizeof(word_t), MEMORY_SIZE, f);
+    fclose(f);
+
+    if (snapshot)
+    {
+        if (pvm_restore(vm, snapshot, image, words_read * sizeof(word_t)) != 0)
+        {
+            fprintf(stderr, "FATAL: %s\n", pvm_error(vm));
+            exit(EXIT_FAILURE);
+        }
+        printf("Restored %s at 0x%04X after %llu instructions.\n", snapshot, pvm_pc(vm),
+               (unsigned long long)pvm_instructions(vm));
+        return;
+    }
+
+    pvm_load_image(vm, image, words_read * sizeof(word_t));
+
+    if (words_read > 0)
+        printf("Loaded %zu words starting at 0x%04X.\n", words_read, CODE_START);
+    else
+        printf("Warning: Binary file loaded but appears empty lol.\n");
+}
+
+
+
+// --snapshot-at=ADDR or --snapshot-at=trap:N.
+static int parse_snapshot_at(const char *arg, int *pc, int *trap)
+{
+    int is_trap = 0 == strncmp(arg, "trap:", 5);
+    char *end;
+    long n = strtol(is_trap ? arg + 5 : arg, &end, 0);
+
+    if (end == arg || *end || n < 0 || n >= (is_trap ? 256 : MEMORY_SIZE))
+        return -1;
+    *(is_trap ? trap : pc) = (int)n;
+    return 0;
+}
+
+
+
+// Runs to the end, writing a snapshot at the break on the way there.
+static pvm_status run_with_snapshot(pvm_vm *vm)
+{
+    pvm_status result = pvm_run(vm, 0);
+    if (PVM_BREAK != result)
+    {
+        fprintf(stderr, "Warning: never got to the --snapshot-at point, no snapshot written.\n");
+        return result;
+    }
+
+    if (pvm_save_snapshot(vm, SNAPSHOT_FILE) != 0)
+        fprintf(stderr, "Warning: %s\n", pvm_error(vm));
+    else
+        fprintf(stderr, "** Snapshot at 0x%04X after %llu instructions, written to %s **\n",
+                pvm_pc(vm), (unsigned long long)pvm_instructions(vm), SNAPSHOT_FILE);
+    return pvm_run(vm, 0);
+}
+
+
+
+// The main program.
+int main(int argc, char **argv)
+{
+    int use_jit = 0;
+    int flight_recorder = 0;
+    int stats = 0;
+    int unbuffered = 0;
+    int console = 0;
+    const char *batch = NULL;
+    const char *results = BATCH_RESULTS_FILE;
+    int threads = 0;
+    long long slice = 0;
+    long long gas = 0;
+    int snapshot_pc = -1;
+    int snapshot_trap = -1;
+    const char *restore = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--stats"))
+        {
+            stats = 1;
+        }
+        else if (0 == strcmp(argv[i], "--jit"))
+        {
+            use_jit = 1;
+        }
+        else if (0 == strcmp(argv[i], "--unbuffered"))
+        {
+            unbuffered = 1;
+        }
+        else if (0 == strcmp(argv[i], "--console"))
+        {
+            console = 1;
+        }
+        else if (0 == strcmp(argv[i], "--flight-recorder"))
+        {
+            flight_recorder = 1;
+        }
+        else if (0 == strcmp(argv[i], "--profile"))
+        {
+            profiling = 1;
+            atexit(write_profile_at_exit);
+        }
+        else if (0 == strcmp(argv[i], "--sample") || 0 == strncmp(argv[i], "--sample=", 9))
+        {
+            sample_hz = argv[i][8] ? atoi(argv[i] + 9) : SAMPLE_DEFAULT_HZ;
+            if (sample_hz <= 0)
+            {
+                fprintf(stderr, "Invalid sample rate: %s\n", argv[i] + 9);
+                return EXIT_FAILURE;
+            }
+            atexit(write_samples_at_exit);
+        }
+        else if (0 == strncmp(argv[i], "--batch=", 8) && argv[i][8])
+        {
+            batch = argv[i] + 8;
+        }
+        else if (0 == strncmp(argv[i], "--results=", 10) && argv[i][10])
+        {
+            results = argv[i] + 10;
+        }
+        else if (0 == strncmp(argv[i], "--threads=", 10))
+        {
+            threads = atoi(argv[i] + 10);
+            if (threads <= 0)
+            {
+                fprintf(stderr, "Invalid thread count: %s\n", argv[i] + 10);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (0 == strncmp(argv[i], "--slice=", 8))
+        {
+            slice = atoll(argv[i] + 8);
+            if (slice <= 0)
+            {
+                fprintf(stderr, "Invalid time slice: %s\n", argv[i] + 8);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (0 == strncmp(argv[i], "--gas=", 6))
+        {
+            gas = atoll(argv[i] + 6);
+            if (gas <= 0)
+            {
+                fprintf(stderr, "Invalid gas limit: %s\n", argv[i] + 6);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (0 == strncmp(argv[i], "--snapshot-at=", 14))
+        {
+            if (parse_snapshot_at(argv[i] + 14, &snapshot_pc, &snapshot_trap) != 0)
+            {
+                fprintf(stderr, "Invalid snapshot point: %s\n", argv[i] + 14);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (0 == strncmp(argv[i], "--restore=", 10) && argv[i][10])
+        {
+            restore = argv[i] + 10;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--stats] [--jit] [--flight-recorder] [--profile] [--sample[=HZ]]\n", argv[0]);
+            fprintf(stderr, "       %*s [--gas=N] [--snapshot-at=ADDR|trap:N] [--restore=SNAPSHOT] [--unbuffered]\n", (int)strlen(argv[0]), "");
+            fprintf(stderr, "       %*s [--console]\n", (int)strlen(argv[0]), "");
+            fprintf(stderr, "       %s --batch=MANIFEST [--threads=N] [--slice=N] [--gas=N] [--results=FILE]\n", argv[0]);
+            fprintf(stderr, "  --stats:           Report how often each superinstruction fired (none are\n");
+            fprintf(stderr, "                     while tracing, build with NO_LOG or HIDE_TRACE)\n");
+            fprintf(stderr, "  --jit:             Translate basic blocks to native code (x86-64)\n");
+            fprintf(stderr, "  --flight-recorder: Only keep the last %d trace records\n", TRACE_RING_SIZE);
+            fprintf(stderr, "  --profile:         Count every instruction, written to %s\n", PROFILE_FILE);
+            fprintf(stderr, "  --sample[=HZ]:     Sample PC and call stack (default %d Hz), written to %s\n",
+                    SAMPLE_DEFAULT_HZ, SAMPLE_FOLDED_FILE);
+            fprintf(stderr, "  --batch=MANIFEST:  Run every job in MANIFEST (image stdin stdout per line)\n");
+            fprintf(stderr, "  --threads=N:       Batch worker threads (default: one per CPU)\n");
+            fprintf(stderr, "  --slice=N:         Time-slice batch jobs N instructions at a time\n");
+            fprintf(stderr, "  --results=FILE:    Per-job exit codes and instruction counts (default %s)\n",
+                    BATCH_RESULTS_FILE);
+            fprintf(stderr, "  --gas=N:           Stop a program (or each batch job) after N gas\n");
+            fprintf(stderr, "  --snapshot-at=ADDR|trap:N: Write %s the first time it gets to ADDR or TRAP N\n",
+                    SNAPSHOT_FILE);
+            fprintf(stderr, "  --restore=SNAPSHOT: Carry on from a snapshot of a.out.bin\n");
+            fprintf(stderr, "  --unbuffered:      A system call for every TRAP 0 and TRAP 1, no read-ahead\n");
+            fprintf(stderr, "  --console:         STORE -2048 writes a byte to stdout, LOAD -2047 reads one\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // The debugging aids are all process-wide, a batch runs many VMs at once.
+    if (batch)
+    {
+        if (use_jit || flight_recorder || stats || profiling || sample_hz || restore ||
+            snapshot_pc >= 0 || snapshot_trap >= 0 || unbuffered || console)
+        {
+            fprintf(stderr, "--batch doesn't mix with --jit, --stats, --flight-recorder, --profile, --sample,\n"
+                            "--snapshot-at, --restore, --unbuffered or --console.\n");
+            return EXIT_FAILURE;
+        }
+        return run_batch(batch, results, threads, (uint64_t)slice, (uint64_t)gas) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (slice)
+    {
+        fprintf(stderr, "--slice is for --batch.\n");
+        return EXIT_FAILURE;
+    }
+
+    pvm_vm *vm = pvm_create();
+    if (NULL == vm)
+    {
+        perror("FATAL: Could not create the VM");
+        return EXIT_FAILURE;
+    }
+
+    load_memory(vm, "a.out.bin", restore);
+    pvm_break_at(vm, snapshot_pc);
+    pvm_break_on_trap(vm, snapshot_trap);
+    int snapshot = snapshot_pc >= 0 || snapshot_trap >= 0;
+    pvm_set_gas(vm, (uint64_t)gas);
+    pvm_set_buffering(vm, !unbuffered);
+    pvm_set_console(vm, console);
+
+#   ifndef NO_LOG
+        log_file = fopen("pvm.log", "w");
+
+        if (NULL == log_file)
+        {
+            perror("FATAL: Could not open log file 'pvm.log'");
+            return EXIT_FAILURE;
+        }
+#   endif
+
+#   if !defined(HIDE_TRACE) && !defined(NO_LOG)
+    trace_open(log_file, flight_recorder);
+#   else
+    (void)flight_recorder;
+#   endif
+
+#   ifdef BENCHMARK
+    clock_gettime(CLOCK_MONOTONIC, &t_start);
+    perf_counters_start();
+#   endif
+
+    if (use_jit && (profiling || sample_hz))
+    {
+        fprintf(stderr, "Warning: profiling runs on the interpreter, ignoring --jit.\n");
+        use_jit = 0;
+    }
+
+    if (use_jit && snapshot)
+    {
+        fprintf(stderr, "Warning: snapshots are taken on the interpreter, ignoring --jit.\n");
+        use_jit = 0;
+    }
+
+    if (use_jit && gas)
+    {
+        fprintf(stderr, "Warning: gas is metered on the interpreter, ignoring --jit.\n");
+        use_jit = 0;
+    }
+
+    if (use_jit && console)
+    {
+        fprintf(stderr, "Warning: the console is on the interpreter, ignoring --jit.\n");
+        use_jit = 0;
+    }
+
+    printf("** Starting Simulator at 0x%04X **\n", restore ? pvm_pc(vm) : CODE_START);
+
+    pvm_status result = use_jit  ? pvm_run_jit(vm) :
+                        snapshot ? run_with_snapshot(vm) : pvm_run(vm, 0);
+    int exit_code = EXIT_FAILURE;
+
+    switch (result)
+    {
+        case PVM_HALTED:
+            log_benchmark(pvm_instructions(vm));
+            printf("\n** HALT at 0x%04X **\n", pvm_pc(vm));
+            exit_code = EXIT_SUCCESS;
+            break;
+
+        case PVM_EXITED:
+            log_benchmark(pvm_instructions(vm));
+            printf("\n** SYS_EXIT at 0x%04X with status %hhu (0x%04X) **\n", pvm_pc(vm),
+                   (exitcode_t)pvm_exit_status(vm), pvm_exit_status(vm));
+            exit_code = pvm_exit_status(vm);
+            break;
+
+        case PVM_ERROR:
+            fprintf(stderr, "%s\n", pvm_error(vm));
+            break;
+
+        case PVM_OUT_OF_GAS:
+            printf("\n** Out of gas at 0x%04X **\n", pvm_pc(vm));
+            break;
+
+        case PVM_BUDGET:
+        case PVM_BREAK:
+            // No budget was given, the one break was already taken.
+            break;
+    }
+
+    if (gas)
+    {
+        fflush(stdout);
+        fprintf(stderr, "** Gas: %llu of %lld used, %llu instructions **\n",
+                (unsigned long long)pvm_gas_used(vm), gas,
+                (unsigned long long)pvm_instructions(vm));
+    }
+
+    if (stats)
+    {
+        fflush(stdout);
+        print_fused_stats(stderr, vm->fused_hits);
+    }
+
+    CLOSE_LOG();
+    pvm_destroy(vm);
+    return exit_code;
+}
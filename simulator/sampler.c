@@ -0,0 +1,182 @@
+#define _DEFAULT_SOURCE
+
+#include "sampler.h"
+#include <signal.h>
+#include <sys/time.h>
+
+
+
+// Folded stacks, keyed by the stack string.
+#define FOLDED_SLOTS (1 << 14)
+
+typedef struct
+{
+    char     *stack;
+    uint64_t  count;
+} FoldedEntry;
+
+static FoldedEntry FOLDED[FOLDED_SLOTS];
+static uint64_t    pc_samples[MEMORY_SIZE];
+static uint64_t    depth_samples[MEMORY_SIZE];
+static uint64_t    total_samples = 0;
+static uint64_t    dropped_stacks = 0;   // Table full.
+
+
+
+static void on_sigprof(int sig)
+{
+    (void)sig;
+    request_sample();
+}
+
+
+
+int sampler_start(int hz)
+{
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigprof;
+    sigemptyset(&sa.sa_mask);
+    // Guest reads and writes shouldn't see EINTR because of us.
+    sa.sa_flags = SA_RESTART;
+
+    if (sigaction(SIGPROF, &sa, NULL) != 0)
+    {
+        perror("sigaction");
+        return -1;
+    }
+
+    long usec = hz > 0 ? 1000000L / hz : 1000000L / SAMPLE_DEFAULT_HZ;
+    if (usec < 1)
+        usec = 1;
+
+    struct itimerval it;
+    it.it_interval.tv_sec  = usec / 1000000L;
+    it.it_interval.tv_usec = usec % 1000000L;
+    it.it_value = it.it_interval;
+
+    if (setitimer(ITIMER_PROF, &it, NULL) != 0)
+    {
+        perror("setitimer");
+        return -1;
+    }
+    return 0;
+}
+
+
+
+// v is the word after a JAL in the code region.
+static int is_return_address(const pvm_vm *vm, word_t v)
+{
+    word_t call = v - 1;
+    Instruction in;
+    in.raw = vm->memory[call];
+    return call >= CODE_START && (0 == vm->regs.BR || call < vm->regs.BR) &&
+           OP_JAL == in.fields.opcode;
+}
+
+// The function a return address came back from.
+static word_t callee_of(const pvm_vm *vm, word_t ret)
+{
+    Instruction in;
+    in.raw = vm->memory[(word_t)(ret - 1)];
+    return ret + sign_extend_12(in.fields.arg);
+}
+
+
+
+static void count_stack(const char *stack)
+{
+    uint32_t h = 2166136261u;
+    for (const char *c = stack; *c; c++)
+        h = (h ^ (uint8_t)*c) * 16777619u;
+
+    for (uint32_t i = 0; i < FOLDED_SLOTS; i++)
+    {
+        FoldedEntry *e = &FOLDED[(h + i) & (FOLDED_SLOTS - 1)];
+        if (NULL == e->stack)
+        {
+            e->stack = strdup(stack);
+            if (NULL == e->stack)
+                break;
+            e->count = 1;
+            return;
+        }
+        if (0 == strcmp(e->stack, stack))
+        {
+            e->count++;
+            return;
+        }
+    }
+    dropped_stacks++;
+}
+
+
+
+// memory[sp] may be stale in the interpreter, so the top comes in as tos.
+void sampler_record(const pvm_vm *vm, word_t pc, word_t sp, word_t tos)
+{
+    total_samples++;
+    pc_samples[pc]++;
+    depth_samples[(word_t)(INITIAL_SP - sp)]++;
+
+    // Innermost first. Without a valid LR we're not inside a call at all.
+    // A caller's entry can't come after the call site in it, which weeds
+    // out most of the data that merely looks like a return address.
+    word_t frames[SAMPLE_MAX_FRAMES];
+    int n = 0;
+
+    if (is_return_address(vm, vm->regs.LR))
+    {
+        frames[n++] = vm->regs.LR;
+        for (uint32_t slot = sp; slot < INITIAL_SP && n < SAMPLE_MAX_FRAMES; slot++)
+        {
+            word_t v = slot == sp ? tos : vm->memory[slot];
+            if (is_return_address(vm, v) && callee_of(vm, v) <= (word_t)(frames[n - 1] - 1))
+                frames[n++] = v;
+        }
+    }
+
+    // "entry;fn_callee;...;pc", outermost first.
+    char stack[16 * (SAMPLE_MAX_FRAMES + 2)];
+    int len = sprintf(stack, "fn_0x%04X", CODE_START);
+    while (n > 0)
+        len += sprintf(stack + len, ";fn_0x%04X", callee_of(vm, frames[--n]));
+    sprintf(stack + len, ";0x%04X", pc);
+
+    count_stack(stack);
+}
+
+
+
+int write_samples(void)
+{
+    FILE *folded = fopen(SAMPLE_FOLDED_FILE, "w");
+    FILE *hist   = fopen(SAMPLE_HIST_FILE, "w");
+    if (NULL == folded || NULL == hist)
+    {
+        perror("Could not write the samples");
+        if (folded) fclose(folded);
+        if (hist)   fclose(hist);
+        return -1;
+    }
+
+    for (int i = 0; i < FOLDED_SLOTS; i++)
+        if (FOLDED[i].stack)
+            fprintf(folded, "%s %llu\n", FOLDED[i].stack, (unsigned long long)FOLDED[i].count);
+
+    fprintf(hist, "# pvm samples v1\n");
+    fprintf(hist, "total %llu\n", (unsigned long long)total_samples);
+    if (dropped_stacks)
+        fprintf(hist, "dropped %llu\n", (unsigned long long)dropped_stacks);
+    for (int addr = 0; addr < MEMORY_SIZE; addr++)
+        if (pc_samples[addr])
+            fprintf(hist, "pc 0x%04X %llu\n", addr, (unsigned long long)pc_samples[addr]);
+    for (int depth = 0; depth < MEMORY_SIZE; depth++)
+        if (depth_samples[depth])
+            fprintf(hist, "depth %d %llu\n", depth, (unsigned long long)depth_samples[depth]);
+
+    fclose(folded);
+    fclose(hist);
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "pinnacle.h"
+#include <stdlib.h>
+
+
+
+// Green-thread scheduler, see pinnacle.h.
+// The run queue is a ring: a turn takes the VM at the front and puts it
+// back at the end if its budget ran out. Nothing else is ever taken off,
+// so round robin is just that.
+
+typedef struct
+{
+    pvm_vm   *vm;
+    void     *user;
+    uint64_t  budget;       // Of a turn, slice times priority.
+    uint64_t  turns;
+} Task;
+
+struct pvm_sched
+{
+    Task     *ring;
+    size_t    capacity;     // A power of two.
+    size_t    head;
+    size_t    count;
+    uint64_t  slice;
+};
+
+#define INITIAL_CAPACITY 16
+
+
+
+pvm_sched *pvm_sched_create(uint64_t slice)
+{
+    pvm_sched *s = calloc(1, sizeof(pvm_sched));
+    if (NULL == s)
+        return NULL;
+
+    s->ring = malloc(INITIAL_CAPACITY * sizeof(Task));
+    if (NULL == s->ring)
+    {
+        free(s);
+        return NULL;
+    }
+    s->capacity = INITIAL_CAPACITY;
+    s->slice    = slice;
+    return s;
+}
+
+
+
+void pvm_sched_destroy(pvm_sched *s)
+{
+    if (NULL == s)
+        return;
+    free(s->ring);
+    free(s);
+}
+
+
+
+// Doubles the ring, unwrapping it on the way.
+static int grow(pvm_sched *s)
+{
+    Task *ring = malloc(2 * s->capacity * sizeof(Task));
+    if (NULL == ring)
+        return -1;
+
+    for (size_t i = 0; i < s->count; i++)
+        ring[i] = s->ring[(s->head + i) & (s->capacity - 1)];
+
+    free(s->ring);
+    s->ring      = ring;
+    s->capacity *= 2;
+    s->head      = 0;
+    return 0;
+}
+
+
+
+int pvm_sched_add(pvm_sched *s, pvm_vm *vm, int priority, void *user)
+{
+    if (s->count == s->capacity && grow(s) != 0)
+        return -1;
+
+    Task *t   = &s->ring[(s->head + s->count++) & (s->capacity - 1)];
+    t->vm     = vm;
+    t->user   = user;
+    t->budget = s->slice * (uint64_t)(priority > 1 ? priority : 1);
+    t->turns  = 0;
+    return 0;
+}
+
+
+
+int pvm_sched_run(pvm_sched *s, pvm_task *done)
+{
+    while (s->count > 0)
+    {
+        Task t = s->ring[s->head];
+        s->head = (s->head + 1) & (s->capacity - 1);
+        s->count--;
+
+        pvm_status status = pvm_run(t.vm, t.budget);
+        t.turns++;
+
+        if (PVM_BUDGET == status)
+        {
+            // Its own slot was just freed, so this can't have to grow.
+            s->ring[(s->head + s->count++) & (s->capacity - 1)] = t;
+            continue;
+        }
+
+        done->vm     = t.vm;
+        done->user   = t.user;
+        done->status = status;
+        done->turns  = t.turns;
+        return 1;
+    }
+    return 0;
+}
+
+
+
+size_t pvm_sched_count(const pvm_sched *s)
+{
+    return s->count;
+}
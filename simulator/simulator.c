@@ -1,76 +1,158 @@
 
 #define _POSIX_C_SOURCE 199309L
 
+#include <sched.h>
 #include "isa_defs.h"
-#include "instruction_handlers.h"
 #include "trap_handlers.h"
-#ifdef BENCHMARK
-#   include <time.h>
-#endif
+#include "superinstructions.h"
+#include "simulator.h"
+#include "jit.h"
+#include "trace.h"
+#include "profile.h"
+#include "sampler.h"
 
 
 
-// Global definition of memory and registers.
-word_t MEMORY[MEMORY_SIZE] = {0};
-Registers REGS;
-exitcode_t status;
+// Process-wide, see pinnacle.h. Everything else belongs to a pvm_vm.
 FILE *log_file = NULL;
+int profiling = 0;
+int sample_hz = 0;
+
+
+
+#ifndef NO_LOG
+// pvm calls this however the run ended, so the trace always makes it to disk.
+void close_log(void)
+{
+    if (NULL == log_file)
+        return;
+#   ifndef HIDE_TRACE
+    trace_flush();
+#   endif
+    fclose(log_file);
+    log_file = NULL;
+}
+#endif
+
+
+
+// **Shared exits**
+// Used by both the interpreter and the JIT, so they report the same way.
+
+// Runs TRAP n for the instruction at pc. vm->regs.SP must be up to date.
+int execute_trap(pvm_vm *vm, int trap, word_t pc)
+{
+    if (trap < 0 || trap >= 256 || NULL == vm->traps[trap])
+        pvm_fail(vm, "Runtime Error: Unknown TRAP code 0x%X at 0x%04X", trap, pc);
+
+    vm->traps[trap](vm);
+    return trap == 2; // special exit trap
+}
 
-#ifdef BENCHMARK
-    static uint64_t instr_count = 0;
-    __clock_t time_spent;
 
-    static inline void log_time(clock_t start, FILE* log)
+
+// Illegal opcode, or a func code outside its enum.
+void illegal_instruction(pvm_vm *vm, word_t pc)
+{
+    Instruction in;
+    in.raw = vm->memory[pc];
+
+    switch (in.fields.opcode)
     {
-        clock_t diff = clock() - start;
-        fprintf(log, "Speed calculated by clock(): %f\n", (float)diff / CLOCKS_PER_SEC);
+        case OP_ALU_LOGIC:
+            pvm_fail(vm, "Runtime Error: Unknown ALU func code 0x%X", in.fields.arg);
+        case OP_STACK_OPS:
+            pvm_fail(vm, "Unknown stack func 0x%X", in.fields.arg);
+        case OP_BRANCH:
+            pvm_fail(vm, "Unknown branch func 0x%X", in.fields.arg);
+        default:
+            pvm_fail(vm, "Runtime Error: Illegal Opcode 0x%X at address 0x%04X", in.fields.opcode, pc);
     }
-#endif
+}
+
+
+
+// Pre-decoded instruction cache (vm->code_cache).
+// Every word of memory gets an entry, so anything the guest can jump to is
+// covered. Entries start out pointing at the decode handler and are filled
+// in the first time they run (the code region is filled eagerly).
+static void *decode_handler = NULL;
+
+// Shared by every VM, it never changes once it's built.
+static DecodedInstr *sample_cache = NULL;
+static pvm_vm *volatile sampled_vm = NULL;
 
+// With --profile every entry points at op_profile, and the handler it
+// decoded to waits here.
+static void *PROFILED[MEMORY_SIZE];
 
+// With pvm_set_console() on these two don't go to op_store and op_load.
+#define CONSOLE_TX_WORD ((word_t)(OP_STORE << 12 | (PVM_CONSOLE_TX & 0xFFF)))
+#define CONSOLE_RX_WORD ((word_t)(OP_LOAD << 12 | (PVM_CONSOLE_RX & 0xFFF)))
 
-// Memory loading function.
-void load_memory(const char *filename)
+static int covers_console(const word_t *memory, word_t addr, int length)
 {
-    FILE *f = fopen(filename, "rb");
-    
-    // Always use protection.
-    if (NULL == f)
+    for (int i = 0; i < length; i++)
     {
-        perror("Error opening binary file");
-        fprintf(stderr, "FATAL: Please ensure 'a.out.bin' exists and is accessible.\n");
-        exit(EXIT_FAILURE); 
+        word_t w = memory[(word_t)(addr + i)];
+        if (CONSOLE_TX_WORD == w || CONSOLE_RX_WORD == w)
+            return 1;
     }
+    return 0;
+}
+
+// What every possible instruction word decodes to, built once from the
+// enums in isa_defs.h. Filling a code cache entry is a copy from here.
+// VMs on other threads may get there first, the first one builds it and
+// the rest wait for it.
+#define DECODE_TABLE_SIZE (1 << 16)
+#define TABLE_EMPTY    0
+#define TABLE_BUILDING 1
+#define TABLE_READY    2
+static DecodedInstr DECODE_TABLE[DECODE_TABLE_SIZE];
+static int decode_table_state = TABLE_EMPTY;
 
-    size_t words_read = fread(MEMORY, sizeof(word_t), MEMORY_SIZE, f);
 
-    if (words_read > 0)
-        printf("Loaded %zu words starting at 0x%04X.\n", words_read, CODE_START);
-    else
-        printf("Warning: Binary file loaded but appears empty lol.\n");
 
-    fclose(f);
+// Async-signal-safe, it's a single store.
+void request_sample(void)
+{
+    pvm_vm *vm = sampled_vm;
+    if (vm && sample_cache)
+        vm->cache_base = sample_cache;
 }
 
 
 
-void run_simulator(int start_addr)
+// Anything that writes guest memory behind the interpreter's back
+// (TRAP 0 for example) must call this, so stale entries get re-decoded.
+// A fused idiom may start up to MAX_FUSED_LENGTH - 1 words earlier.
+void invalidate_code_cache(pvm_vm *vm, word_t addr, word_t count)
 {
-#   ifdef BENCHMARK
-    struct timespec t_start, t_end;
-    clock_gettime(CLOCK_MONOTONIC, &t_start);
-#   endif
+    jit_invalidate(vm, addr, count);
+
+    if (!vm->cache_ready)
+        return;
+
+    // Reads first, like STORE does, to keep the cache pages shared.
+    word_t first = addr - (MAX_FUSED_LENGTH - 1);
+    for (int i = 0; i < count + MAX_FUSED_LENGTH - 1; i++)
+    {
+        DecodedInstr *entry = &vm->code_cache[(word_t)(first + i)];
+        if (entry->handler != decode_handler)
+            entry->handler = decode_handler;
+    }
+}
 
-    REGS.PC = start_addr;
 
-    printf("** Starting Simulator at 0x%04X **\n", start_addr);
 
-    // **Computed goto dispatch table**
-    static void *dispatch_table[] = {
+pvm_status run_simulator(pvm_vm *vm, uint64_t max_instructions)
+{
+    // **Computed goto dispatch tables**
+    // Only used to build DECODE_TABLE, the hot path jumps through the code cache.
+    // Opcodes that take a func code are split up by the tables below.
+    static void *opcode_handlers[16] = {
         [OP_ILLEGAL]   = &&op_illegal,
-        [OP_ALU_LOGIC] = &&op_alu_logic,
-        [OP_STACK_OPS] = &&op_stack_ops,
-        [OP_BRANCH]    = &&op_branch,
         [OP_LDI]       = &&op_ldi,
         [OP_LOAD]      = &&op_load,
         [OP_STORE]     = &&op_store,
@@ -80,178 +162,702 @@ void run_simulator(int start_addr)
         [OP_TRAP]      = &&op_trap,
         [OP_HALT]      = &&op_halt
     };
+    static void *alu_handlers[ALU_FUNC_COUNT] = {
+        [FUNC_ADD] = &&op_add, [FUNC_SUB] = &&op_sub, [FUNC_MULT] = &&op_mult,
+        [FUNC_DIV] = &&op_div, [FUNC_NEG] = &&op_neg, [FUNC_INC]  = &&op_inc,
+        [FUNC_DEC] = &&op_dec, [FUNC_ABS] = &&op_abs, [FUNC_NOT]  = &&op_not,
+        [FUNC_AND] = &&op_and, [FUNC_OR]  = &&op_or,  [FUNC_XOR]  = &&op_xor,
+        [FUNC_SHL] = &&op_shl, [FUNC_SHR] = &&op_shr
+    };
+    static void *stack_handlers[STACK_FUNC_COUNT] = {
+        [FUNC_SWAP] = &&op_swap, [FUNC_DUP]  = &&op_dup,
+        [FUNC_DROP] = &&op_drop, [FUNC_OVER] = &&op_over
+    };
+    static void *branch_handlers[BRANCH_FUNC_COUNT] = {
+        [FUNC_BEQ] = &&op_beq, [FUNC_BNE] = &&op_bne, [FUNC_BZ] = &&op_bz,
+        [FUNC_BNZ] = &&op_bnz, [FUNC_BN]  = &&op_bn,  [FUNC_BP] = &&op_bp
+    };
 
-fetch:
-#   ifdef BENCHMARK
-    instr_count++;
-#   endif
+    // One handler per entry of FUSED_PATTERNS.
+    static void *fused_table[FUSED_PATTERN_COUNT] = {
+        [FUSE_LOAD_LDI_DIV_DROP]  = &&fuse_load_ldi_div_drop,
+        [FUSE_LOAD_DUP_LOAD_ADD]  = &&fuse_load_dup_load_add,
+        [FUSE_LDI_LDI_TRAP_WRITE] = &&fuse_ldi_ldi_trap_write,
+        [FUSE_LDI_BNZ]            = &&fuse_ldi_bnz
+    };
 
-    Instruction current_instruction;
-    current_instruction.raw = MEMORY[REGS.PC];
-    word_t prev_pc = REGS.PC;
-    REGS.PC++;
+    int table_state = __atomic_load_n(&decode_table_state, __ATOMIC_ACQUIRE);
+    while (TABLE_READY != table_state)
+    {
+        if (TABLE_BUILDING == table_state ||
+            !__atomic_compare_exchange_n(&decode_table_state, &table_state, TABLE_BUILDING,
+                                         0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+        {
+            sched_yield();
+            table_state = __atomic_load_n(&decode_table_state, __ATOMIC_ACQUIRE);
+            continue;
+        }
 
-#   ifndef HIDE_TRACE
-#   ifndef NO_LOG
-    fprintf(log_file,
-        "PC: 0x%04X, SP: 0x%04X, Instruction: 0x%04X (opcode: 0x%X, arg: 0x%X)\n",
-        prev_pc, REGS.SP, current_instruction.raw,
-        current_instruction.fields.opcode, current_instruction.fields.arg);
+        for (int raw = 0; raw < DECODE_TABLE_SIZE; raw++)
+        {
+            Instruction in;
+            in.raw = (word_t)raw;
+            int op  = in.fields.opcode;
+            int arg = in.fields.arg;
+            void *handler;
+
+            switch (op)
+            {
+                case OP_ALU_LOGIC:
+                    handler = arg < ALU_FUNC_COUNT ? alu_handlers[arg] : &&op_illegal;
+                    break;
+                case OP_STACK_OPS:
+                    handler = arg < STACK_FUNC_COUNT ? stack_handlers[arg] : &&op_illegal;
+                    break;
+                case OP_BRANCH:
+                    handler = arg < BRANCH_FUNC_COUNT ? branch_handlers[arg] : &&op_illegal;
+                    break;
+                default:
+                    handler = opcode_handlers[op] ? opcode_handlers[op] : &&op_illegal;
+                    break;
+            }
+
+            // A func added to isa_defs.h without a handler here.
+            if (NULL == handler)
+            {
+                __atomic_store_n(&decode_table_state, TABLE_EMPTY, __ATOMIC_RELEASE);
+                pvm_fail(vm, "FATAL: No handler for instruction 0x%04X", raw);
+            }
+
+            // LDI, LOAD, STORE, JMP and JAL take a signed 12-bit operand,
+            // everything else takes a func code or a trap number.
+            DECODE_TABLE[raw].handler = handler;
+            DECODE_TABLE[raw].operand = (op >= OP_LDI && op <= OP_JAL)
+                                      ? sign_extend_12(arg) : (sword_t)arg;
+        }
+        decode_handler = &&op_decode;
+        __atomic_store_n(&decode_table_state, TABLE_READY, __ATOMIC_RELEASE);
+        table_state = TABLE_READY;
+    }
+
+    word_t       *const memory = vm->memory;
+    DecodedInstr *const cache  = vm->code_cache;
+
+    // A fused idiom is dispatched once, it would leave a single trace
+    // record for all of its instructions. Profiling counts them one by
+    // one too.
+#   if !defined(HIDE_TRACE) && !defined(NO_LOG)
+    const int tracing = trace_enabled;
+#   else
+    const int tracing = 0;
 #   endif
+    const int fusing = !profiling && !tracing;
+
+#   define DECODE_PLAIN(addr) (cache[(addr)] = DECODE_TABLE[memory[(addr)]])
+#   define DROP_DECODED(addr)                                               \
+    do {                                                                    \
+        if (cache[(addr)].handler != &&op_decode)                           \
+            cache[(addr)].handler = &&op_decode;                            \
+    } while (0)
+
+    // A fused head keeps its own operand, the handler reads the rest of
+    // the operands from the entries that follow it.
+#   define DECODE(addr)                                                     \
+    do {                                                                    \
+        DECODE_PLAIN(addr);                                                 \
+        int id_ = fusing ? match_fused_pattern(memory, addr) : -1;          \
+        if (id_ >= 0 && COVERS_BREAK(addr, FUSED_PATTERNS[id_].length))     \
+            id_ = -1;                                                       \
+        if (id_ >= 0 && COVERS_CONSOLE(addr, FUSED_PATTERNS[id_].length))   \
+            id_ = -1;                                                       \
+        if (vm->console && CONSOLE_TX_WORD == memory[(addr)])               \
+            cache[(addr)].handler = &&op_console_tx;                        \
+        if (vm->console && CONSOLE_RX_WORD == memory[(addr)])               \
+            cache[(addr)].handler = &&op_console_rx;                        \
+        if (id_ >= 0)                                                       \
+        {                                                                   \
+            for (int i_ = 1; i_ < FUSED_PATTERNS[id_].length; i_++)         \
+            {                                                               \
+                word_t m_ = (word_t)((addr) + i_);                          \
+                if (cache[m_].handler == &&op_decode)                       \
+                    DECODE_PLAIN(m_);                                       \
+            }                                                               \
+            cache[(addr)].handler = fused_table[id_];                       \
+        }                                                                   \
+        if (profiling)                                                      \
+        {                                                                   \
+            PROFILED[(addr)] = cache[(addr)].handler;                       \
+            cache[(addr)].handler = &&op_profile;                           \
+        }                                                                   \
+        if ((addr) == vm->break_pc)                                         \
+            cache[(addr)].handler = &&op_break;                             \
+    } while (0)
+
+    // Nothing may be fused over a break point, it has to stop right there.
+#   define COVERS_BREAK(addr, length)                                       \
+    (vm->break_pc >= 0 && (word_t)(vm->break_pc - (addr) - 1) < (length) - 1)
+
+    // Nor over the console's two, it would go round them.
+#   define COVERS_CONSOLE(addr, length)                                     \
+    (vm->console && covers_console(memory, addr, length))
+
+    // Decode the code region once, up front. A run that stopped on its
+    // budget carries on with what it had, and a VM on an image some other
+    // VM already decoded starts out with that (see pvm_map_image).
+    if (!vm->cache_ready)
+    {
+        if (MAPPED_BLANK != vm->cache_mapped)
+            for (int addr = 0; addr < MEMORY_SIZE; addr++)
+                cache[addr].handler = &&op_decode;
+        for (word_t addr = CODE_START; addr < vm->regs.BR; addr++)
+            DECODE(addr);
+        vm->cache_ready = 1;
+        share_code_cache(vm, &&op_decode);
+    }
+    vm->cache_base = cache;
+
+    // The cache may have been decoded before the break point was set.
+    // Anything that could be fused over it is decoded again.
+    if (vm->break_pc >= 0)
+    {
+        for (int k = MAX_FUSED_LENGTH - 1; k > 0; k--)
+        {
+            word_t addr = (word_t)(vm->break_pc - k);
+            if (cache[addr].handler != &&op_decode)
+                DECODE(addr);
+        }
+        DECODE((word_t)vm->break_pc);
+    }
+
+    if (sample_hz && NULL == sample_cache)
+    {
+        sample_cache = malloc(MEMORY_SIZE * sizeof(DecodedInstr));
+        if (NULL == sample_cache)
+            pvm_fail(vm, "malloc: out of memory");
+        for (int addr = 0; addr < MEMORY_SIZE; addr++)
+            sample_cache[addr].handler = &&op_sample;
+        sampled_vm = vm;
+        sampler_start(sample_hz);
+    }
+
+    // **Cached machine state**
+    // PC, SP and the top of stack live in locals for the whole loop.
+    // tos is the value of memory[sp]; the memory copy is only refreshed
+    // by SYNC_OUT() (traps and exit) or by a push.
+    // LOAD and STORE spill before touching memory, so they can't see a
+    // stale top slot. Slots below SP are not kept up to date.
+    register word_t pc  = vm->regs.PC;
+    register word_t sp  = vm->regs.SP;
+    register word_t tos = memory[sp];
+    const word_t    br  = vm->regs.BR;
+
+#   define SYNC_OUT()  (memory[sp] = tos, vm->regs.SP = sp, vm->regs.PC = pc)
+#   define SYNC_IN()   (sp = vm->regs.SP, pc = vm->regs.PC, tos = memory[sp])
+#   define PUSH(v)     (memory[sp] = tos, sp--, tos = (v))
+#   define POP()       (sp++, tos = memory[sp])
+
+    DecodedInstr *current;
+    word_t prev_pc;
+
+    // **Instruction count, budget and gas**
+    // Between jumps the program runs in a straight line, so nothing is
+    // counted per instruction. The run that ends at `last` (a jump, a call,
+    // a return or a taken branch) is added up when pc leaves it, and
+    // that's also the only place the budget is checked.
+    // Metered, `left` is gas: whichever runs out first of the budget and
+    // what's left of the limit. The few instructions that cost more than
+    // 1 take the rest out of it themselves, and keep it in `extra` so the
+    // instruction count comes out right.
+    const int metered = vm->gas_limit > 0;
+    const int64_t mult_gas = metered ? GAS_MULT - 1 : 0;
+    const int64_t div_gas  = metered ? GAS_DIV - 1 : 0;
+    const int64_t trap_gas = metered ? GAS_TRAP - 1 : 0;
+    int64_t extra = 0;
+
+    int64_t left = max_instructions ? (int64_t)max_instructions : INT64_MAX;
+    if (metered)
+    {
+        if (vm->gas_used >= vm->gas_limit)
+            return PVM_OUT_OF_GAS;
+        uint64_t gas = vm->gas_limit - vm->gas_used;
+        if (gas < (uint64_t)left)
+            left = (int64_t)gas;
+    }
+    const int64_t budget = left;
+    word_t run_start = pc;
+
+#   define CHARGE(used)      (vm->gas_used += (used), vm->instructions += (used) - extra)
+#   define CHARGE_EXTRA(gas) (left -= (gas), extra += (gas))
+#   define RUN_LENGTH(last)  ((int64_t)(word_t)((last) - run_start) + 1)
+#   define COUNT_RUN(last)   CHARGE(budget - (left - RUN_LENGTH(last)))
+    // Stopping before the instruction at addr, it doesn't count.
+#   define COUNT_BEFORE(addr) CHARGE(budget - left + (word_t)((addr) - run_start))
+#   define JUMPED(last)                                                     \
+    do {                                                                    \
+        left -= RUN_LENGTH(last);                                           \
+        run_start = pc;                                                     \
+        if (__builtin_expect(left <= 0, 0))                                 \
+            goto out_of_budget;                                             \
+    } while (0)
+
+#   define COUNT_FUSED(id)  vm->fused_hits[id]++
+
+    // One binary record per instruction, see trace.h. Only while pvm has
+    // a trace open, the ring is process-wide.
+#   if !defined(HIDE_TRACE) && !defined(NO_LOG)
+#       define TRACE_INSTR() (tracing ? trace_record(prev_pc, sp, memory[prev_pc], tos) : (void)0)
+#   else
+#       define TRACE_INSTR() ((void)0)
 #   endif
 
-    int opcode = current_instruction.fields.opcode;
-    int arg    = current_instruction.fields.arg;
+    // Every handler ends with its own copy of this, so each one gets
+    // its own indirect jump (and its own branch history).
+#   define DISPATCH()                                                       \
+    do {                                                                    \
+        prev_pc = pc;                                                       \
+        current = &vm->cache_base[pc++];                                    \
+        TRACE_INSTR();                                                      \
+        goto *current->handler;                                             \
+    } while (0)
 
-    if (__builtin_expect(opcode < OP_ILLEGAL || opcode > OP_HALT, 0))
-        goto op_illegal;
+    DISPATCH();
 
-    goto *dispatch_table[opcode];
+op_decode:
+    DECODE(prev_pc);
+    goto *current->handler;
 
 op_illegal:
-    fprintf(stderr, "Runtime Error: Illegal Opcode 0x%X at address 0x%04X\n", opcode, prev_pc);
-    CLOSE_LOG();
-    exit(EXIT_FAILURE);
+    illegal_instruction(vm, prev_pc);
+
+op_profile:
+    profile_instruction(memory, prev_pc);
+    goto *PROFILED[prev_pc];
+
+// pvm_break_at(), once. The instruction here hasn't run.
+op_break:
+    if (prev_pc != vm->break_pc)
+    {
+        // One that was moved or cleared since.
+        DECODE(prev_pc);
+        goto *current->handler;
+    }
+    vm->break_pc = -1;
+    DECODE(prev_pc);
+    pc = prev_pc;
+    SYNC_OUT();
+    COUNT_BEFORE(prev_pc);
+    return PVM_BREAK;
+
+op_sample:
+    vm->cache_base = cache;
+    sampler_record(vm, prev_pc, sp, tos);
+    current = &cache[prev_pc];
+    goto *current->handler;
+
+// **ALU**
+op_add:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    sp++;
+    tos = memory[sp] + tos;
+    DISPATCH();
+
+op_sub:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    sp++;
+    tos = memory[sp] - tos;
+    DISPATCH();
+
+op_inc:
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    tos++;
+    DISPATCH();
+
+op_dec:
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    tos--;
+    DISPATCH();
+
+op_mult:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    CHARGE_EXTRA(mult_gas);
+    sp++;
+    tos = (word_t)((sword_t)memory[sp] * (sword_t)tos);
+    DISPATCH();
+
+op_div:
+{
+    // Leaves the remainder below the quotient.
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    sword_t s_tos = (sword_t)tos;
+    sword_t s_nos = (sword_t)memory[sp + 1];
+    if (__builtin_expect(0 == s_tos, 0))
+        pvm_fail(vm, "Divide by zero.");
+    CHARGE_EXTRA(div_gas);
+    memory[sp + 1] = (word_t)(s_nos % s_tos);
+    tos = (word_t)(s_nos / s_tos);
+    DISPATCH();
+}
+
+op_neg:
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    tos = (word_t)(-(sword_t)tos);
+    DISPATCH();
+
+op_abs:
+{
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    sword_t s_tos = (sword_t)tos;
+    tos = (word_t)(s_tos < 0 ? -s_tos : s_tos);
+    DISPATCH();
+}
+
+op_not:
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    tos = (word_t)(!(sword_t)tos);
+    DISPATCH();
+
+op_and:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    sp++;
+    tos = memory[sp] & tos;
+    DISPATCH();
+
+op_or:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    sp++;
+    tos = memory[sp] | tos;
+    DISPATCH();
+
+op_xor:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    sp++;
+    tos = memory[sp] ^ tos;
+    DISPATCH();
+
+op_shl:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    sp++;
+    tos = (word_t)((sword_t)memory[sp] << (sword_t)tos);
+    DISPATCH();
+
+op_shr:
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    sp++;
+    tos = (word_t)((sword_t)memory[sp] >> (sword_t)tos);
+    DISPATCH();
+
+// **Stack**
+
+op_swap:
+{
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    word_t nos = memory[sp + 1];
+    memory[sp + 1] = tos;
+    tos = nos;
+    DISPATCH();
+}
+
+op_dup:
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    CHECK_STACK_OVERFLOW(sp, 1);
+    PUSH(tos);
+    DISPATCH();
+
+op_drop:
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    POP();
+    DISPATCH();
+
+op_over:
+{
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    CHECK_STACK_OVERFLOW(sp, 1);
+    word_t nos = memory[sp + 1];
+    PUSH(nos);
+    DISPATCH();
+}
+
+// **Branch**
+// The offset is on top, the value (or the pair to compare) below it.
+op_beq:
+{
+    CHECK_STACK_UNDERFLOW(sp, 3);
+    word_t offset = tos;
+    word_t rhs    = memory[sp + 1];
+    word_t lhs    = memory[sp + 2];
+    sp += 3;
+    tos = memory[sp];
+    if (lhs == rhs)
+    {
+        pc += sign_extend_12(offset);
+        JUMPED(prev_pc);
+    }
+    DISPATCH();
+}
 
-op_alu_logic:
-    execute_alu(arg);
-    goto fetch;
+op_bne:
+{
+    CHECK_STACK_UNDERFLOW(sp, 3);
+    word_t offset = tos;
+    word_t rhs    = memory[sp + 1];
+    word_t lhs    = memory[sp + 2];
+    sp += 3;
+    tos = memory[sp];
+    if (lhs != rhs)
+    {
+        pc += sign_extend_12(offset);
+        JUMPED(prev_pc);
+    }
+    DISPATCH();
+}
+
+op_bz:
+{
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    word_t offset = tos;
+    word_t val    = memory[sp + 1];
+    sp += 2;
+    tos = memory[sp];
+    if (val == 0)
+    {
+        pc += sign_extend_12(offset);
+        JUMPED(prev_pc);
+    }
+    DISPATCH();
+}
+
+op_bnz:
+{
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    word_t offset = tos;
+    word_t val    = memory[sp + 1];
+    sp += 2;
+    tos = memory[sp];
+    if (val != 0)
+    {
+        pc += sign_extend_12(offset);
+        JUMPED(prev_pc);
+    }
+    DISPATCH();
+}
+
+op_bn:
+{
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    word_t offset = tos;
+    sword_t val   = (sword_t)memory[sp + 1];
+    sp += 2;
+    tos = memory[sp];
+    if (val < 0)
+    {
+        pc += sign_extend_12(offset);
+        JUMPED(prev_pc);
+    }
+    DISPATCH();
+}
 
-op_stack_ops:
-    execute_stack_op(arg);
-    goto fetch;
+op_bp:
+{
+    CHECK_STACK_UNDERFLOW(sp, 2);
+    word_t offset = tos;
+    sword_t val   = (sword_t)memory[sp + 1];
+    sp += 2;
+    tos = memory[sp];
+    if (val > 0)
+    {
+        pc += sign_extend_12(offset);
+        JUMPED(prev_pc);
+    }
+    DISPATCH();
+}
 
-op_branch:
-    execute_branch(arg);
-    goto fetch;
+// **Memory and control flow**
 
 op_ldi:
-    REGS.SP--;
-    MEMORY[REGS.SP] = (word_t)sign_extend_12(arg);
-    goto fetch;
+    PUSH((word_t)current->operand);
+    DISPATCH();
 
 op_load:
 {
-    CHECK_SP_OVERFLOW(1);
-    word_t ea = REGS.BR + (word_t)sign_extend_12(arg);
-    REGS.SP--;
-    MEMORY[REGS.SP] = MEMORY[ea];
-    goto fetch;
+    CHECK_STACK_OVERFLOW(sp, 1);
+    word_t ea = br + (word_t)current->operand;
+    memory[sp] = tos;
+    sp--;
+    tos = memory[ea];
+    DISPATCH();
 }
 
 op_store:
 {
-    CHECK_SP_UNDERFLOW(1);
-    word_t ea = REGS.BR + (word_t)sign_extend_12(arg);
-    MEMORY[ea] = MEMORY[REGS.SP];
-    REGS.SP++;
-    goto fetch;
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    word_t ea = br + (word_t)current->operand;
+    memory[ea] = tos;
+    POP();
+    // The three before ea may be the head of a fused idiom covering it.
+    // Only decoded entries are written, the cache is mapped copy-on-write
+    // and a store to data shouldn't cost a private page of it.
+    DROP_DECODED(ea);
+    DROP_DECODED((word_t)(ea - 1));
+    DROP_DECODED((word_t)(ea - 2));
+    DROP_DECODED((word_t)(ea - 3));
+    DISPATCH();
 }
 
 op_jmp:
 {
-    REGS.PC += sign_extend_12(arg);
-    goto fetch;
+    pc += current->operand;
+    JUMPED(prev_pc);
+    DISPATCH();
 }
 
 op_jal:
 {
-    CHECK_SP_OVERFLOW(1);
-    REGS.SP--;
-    MEMORY[REGS.SP] = REGS.LR;
-    REGS.LR = REGS.PC;
-    REGS.PC += sign_extend_12(arg);
-    goto fetch;
+    CHECK_STACK_OVERFLOW(sp, 1);
+    PUSH(vm->regs.LR);
+    vm->regs.LR = pc;
+    pc += current->operand;
+    JUMPED(prev_pc);
+    DISPATCH();
 }
 
 op_ret:
 {
-    CHECK_SP_UNDERFLOW(1);
-    REGS.PC = REGS.LR;
-    REGS.LR = MEMORY[REGS.SP];
-    REGS.SP++;
-    goto fetch;
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    pc = vm->regs.LR;
+    vm->regs.LR = tos;
+    POP();
+    JUMPED(prev_pc);
+    DISPATCH();
 }
 
 op_trap:
-{
-    if (TRAP_TABLE[arg] != NULL)
+    if (__builtin_expect(current->operand == vm->break_trap, 0))
     {
-        TRAP_TABLE[arg]();
-        if (arg == 2) // special exit trap
-        {
-#           ifdef BENCHMARK
-#           ifndef NO_LOG
-            clock_gettime(CLOCK_MONOTONIC, &t_end);
-            double elapsed = (t_end.tv_sec - t_start.tv_sec) +
-                             (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
-            fprintf(log_file,
-                    "Instr: %llu, elapsed: %.9f s, IPS: %.2f M\n",
-                    (unsigned long long)instr_count,
-                    elapsed, instr_count / (elapsed * 1e6));
-#           endif
-#           endif
-            printf("\n** SYS_EXIT at 0x%04X with status %hhu (0x%04X) **\n", prev_pc, status, status);
-            CLOSE_LOG();
-            exit(status);
-        }
+        // pvm_break_on_trap(), once. The trap hasn't run.
+        vm->break_trap = -1;
+        pc = prev_pc;
+        SYNC_OUT();
+        COUNT_BEFORE(prev_pc);
+        return PVM_BREAK;
     }
-    else
+    CHARGE_EXTRA(trap_gas);
+    SYNC_OUT();
+    if (execute_trap(vm, current->operand, prev_pc))
     {
-        fprintf(stderr, "Runtime Error: Unknown TRAP code 0x%X at 0x%04X\n", arg, prev_pc);
-        CLOSE_LOG();
-        exit(EXIT_FAILURE);
+        vm->regs.PC = prev_pc;
+        COUNT_RUN(prev_pc);
+        return PVM_EXITED;
     }
-    goto fetch;
-}
-
-op_halt:
-#   ifdef BENCHMARK
-#   ifndef NO_LOG
-    clock_gettime(CLOCK_MONOTONIC, &t_end);
-    double elapsed = (t_end.tv_sec - t_start.tv_sec) +
-                     (t_end.tv_nsec - t_start.tv_nsec) / 1e9;
-    fprintf(log_file,
-            "Instr: %llu, elapsed: %.9f s, IPS: %.2f M\n",
-            (unsigned long long)instr_count,
-            elapsed, instr_count / (elapsed * 1e6));
-#   endif
-#   endif
-    printf("\n** HALT at 0x%04X **\n", prev_pc);
-    CLOSE_LOG();
-    exit(EXIT_SUCCESS);
-}
+    if (metered)
+    {
+        CHARGE_EXTRA((int64_t)vm->bulk_gas);
+        vm->bulk_gas = 0;
+    }
+    SYNC_IN();
+    DISPATCH();
 
+// **Console** (pvm_set_console())
+// STORE -2048 and LOAD -2047 decode to these instead while it's on.
 
+op_console_tx:
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    SYNC_OUT();
+    console_write(vm, tos);
+    POP();
+    DISPATCH();
 
-// The main program.
-int main(void)
+op_console_rx:
 {
-    // Initial setup...
-    REGS.SP = INITIAL_SP;
-    // Historical reminder that once we thought a static section was a good idea.
-    // REGS.BR = 0x2000;   // We set the Base Register for data access start.
+    CHECK_STACK_OVERFLOW(sp, 1);
+    SYNC_OUT();
+    word_t c = console_read(vm);
+    PUSH(c);
+    DISPATCH();
+}
 
-    initialize_trap_table();
+// **Superinstructions**
+// Each one has the same effect on PC, SP and the live part of the stack
+// as the sequence it replaces.
 
-    load_memory("a.out.bin");
+fuse_load_ldi_div_drop:
+{
+    // LOAD x; LDI k; DIV; DROP
+    CHECK_STACK_OVERFLOW(sp, 1);
+    word_t ea = br + (word_t)current->operand;
+    memory[sp] = tos;
+    sword_t s_nos = (sword_t)memory[ea];
+    sword_t s_tos = cache[(word_t)(prev_pc + 1)].operand;
+    if (__builtin_expect(0 == s_tos, 0))
+        pvm_fail(vm, "Divide by zero.");
+    CHARGE_EXTRA(div_gas);
+    sp--;
+    tos = (word_t)(s_nos % s_tos);
+    pc += 3;
+    COUNT_FUSED(FUSE_LOAD_LDI_DIV_DROP);
+    DISPATCH();
+}
 
-#   ifndef NO_LOG
-        log_file = fopen("pvm.log", "w");
-#   endif
+fuse_load_dup_load_add:
+{
+    // LOAD a; DUP; LOAD b; ADD
+    // Both copies of a are written out, as the second LOAD may read either.
+    CHECK_STACK_OVERFLOW(sp, 1);
+    word_t ea = br + (word_t)current->operand;
+    memory[sp] = tos;
+    word_t a = memory[ea];
+    CHECK_STACK_OVERFLOW(sp - 1, 1);
+    memory[sp - 1] = a;
+    memory[sp - 2] = a;
+    CHECK_STACK_OVERFLOW(sp - 2, 1);
+    ea = br + (word_t)cache[(word_t)(prev_pc + 2)].operand;
+    sp -= 2;
+    tos = (word_t)((sword_t)a + (sword_t)memory[ea]);
+    pc += 3;
+    COUNT_FUSED(FUSE_LOAD_DUP_LOAD_ADD);
+    DISPATCH();
+}
 
-    if (NULL == log_file)
+fuse_ldi_ldi_trap_write:
+{
+    // LDI fd; LDI buf; TRAP 1
+    // The trap itself runs through op_trap, as if it had been fetched.
+    PUSH((word_t)current->operand);
+    PUSH((word_t)cache[(word_t)(prev_pc + 1)].operand);
+    pc += 2;
+    prev_pc += 2;
+    current = &cache[prev_pc];
+    COUNT_FUSED(FUSE_LDI_LDI_TRAP_WRITE);
+    goto op_trap;
+}
+
+fuse_ldi_bnz:
+{
+    // LDI k; BNZ
+    CHECK_STACK_UNDERFLOW(sp, 1);
+    word_t val = tos;
+    POP();
+    pc++;
+    COUNT_FUSED(FUSE_LDI_BNZ);
+    if (val != 0)
     {
-        perror("FATAL: Could not open log file 'pvm.log'");
-        return EXIT_FAILURE;
+        pc += current->operand;
+        JUMPED(prev_pc + 1);
     }
+    DISPATCH();
+}
+
+op_halt:
+    pc = prev_pc;
+    SYNC_OUT();
+    COUNT_RUN(prev_pc);
+    return PVM_HALTED;
+
+// pc is already where the jump went, and `left` has the run counted.
+out_of_budget:
+    SYNC_OUT();
+    CHARGE(budget - left);
+    return metered && vm->gas_used >= vm->gas_limit ? PVM_OUT_OF_GAS : PVM_BUDGET;
+}
 
-    REGS.BR = MEMORY[0x0000];
 
-    run_simulator(CODE_START);
 
-    // We shouldn't be here.
-    // Still... Just in case.
-    CLOSE_LOG();
-    return EXIT_SUCCESS;
-}
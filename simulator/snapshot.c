@@ -0,0 +1,213 @@
+#define _GNU_SOURCE
+
+#include "snapshot.h"
+#include "simulator.h"
+#include "trap_handlers.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// See snapshot.h for the format.
+
+#define MEMORY_BYTES (MEMORY_SIZE * sizeof(word_t))
+
+// Guest descriptors are below this, see open_files in simulator.h. The
+// snapshot itself is kept above it so it can't be in one's way.
+#define GUEST_FD_LIMIT 256
+
+
+
+// Like pvm_fail(), for the calls that return instead.
+static int refuse(pvm_vm *vm, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(vm->error, sizeof(vm->error), fmt, args);
+    va_end(args);
+    return -1;
+}
+
+
+
+static uint64_t header_checksum(const SnapshotHeader *h)
+{
+    return hash_image(h, offsetof(SnapshotHeader, checksum));
+}
+
+
+
+// Where the file behind a guest descriptor is, and how it's open.
+static int describe_file(pvm_vm *vm, int fd, SnapshotFile *file)
+{
+    file->fd     = fd;
+    file->flags  = fcntl(fd, F_GETFL);
+    file->offset = lseek(fd, 0, SEEK_CUR);
+    if (-1 == file->flags || -1 == file->offset)
+        return refuse(vm, "Snapshot: can't describe guest fd %d: %s", fd, strerror(errno));
+    file->flags &= O_ACCMODE | O_APPEND;
+
+#   ifdef __linux__
+    char link[64];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    ssize_t n = readlink(link, file->path, sizeof(file->path) - 1);
+    if (n <= 0 || n == (ssize_t)sizeof(file->path) - 1 || '/' != file->path[0])
+        return refuse(vm, "Snapshot: guest fd %d is not a file it can name", fd);
+    file->path[n] = '\0';
+    return 0;
+#   else
+    return refuse(vm, "Snapshot: can't name the files the guest has open here");
+#   endif
+}
+
+
+
+int pvm_save_snapshot(pvm_vm *vm, const char *path)
+{
+    if (NULL == vm->image)
+        return refuse(vm, "Snapshot: the VM wasn't loaded from an image");
+
+    SnapshotHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SNAPSHOT_MAGIC, 4);
+    h.version      = SNAPSHOT_VERSION;
+    h.header_size  = sizeof(SnapshotHeader);
+    h.memory_words = MEMORY_SIZE;
+    h.image_hash   = vm->image->hash;
+    h.instructions = vm->instructions;
+    h.regs         = vm->regs;
+
+    if (vm->untracked_files > 0)
+        return refuse(vm, "Snapshot: the guest has descriptors past %d open", GUEST_FD_LIMIT - 1);
+
+    for (int fd = 0; fd < GUEST_FD_LIMIT; fd++)
+    {
+        if (0 == (vm->open_files[fd / 64] & (1ull << (fd % 64))))
+            continue;
+        if (vm->io.open != HOST_IO.open)
+            return refuse(vm, "Snapshot: the guest's files aren't the host's");
+        if (h.file_count == SNAPSHOT_MAX_FILES)
+            return refuse(vm, "Snapshot: the guest has more than %d files open", SNAPSHOT_MAX_FILES);
+        if (describe_file(vm, fd, &h.files[h.file_count++]) != 0)
+            return -1;
+    }
+    h.checksum = header_checksum(&h);
+
+    // Written next to it and renamed, a snapshot is either all there or not.
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (-1 == fd)
+        return refuse(vm, "Snapshot: %s: %s", tmp, strerror(errno));
+
+    int ok = pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+             pwrite(fd, vm->memory, MEMORY_BYTES, SNAPSHOT_MEMORY_AT) == (ssize_t)MEMORY_BYTES;
+    int err = errno;
+    close(fd);
+
+    if (!ok || rename(tmp, path) != 0)
+    {
+        err = ok ? errno : err;
+        unlink(tmp);
+        return refuse(vm, "Snapshot: %s: %s", path, strerror(err));
+    }
+    return 0;
+}
+
+
+
+// Opens a guest's file again at the descriptor it had.
+static int reopen_file(pvm_vm *vm, const SnapshotFile *file)
+{
+    if (file->fd < 0 || file->fd >= GUEST_FD_LIMIT)
+        return refuse(vm, "Restore: bad descriptor %d in the snapshot", file->fd);
+
+    // Something of ours may already be there.
+    if (fcntl(file->fd, F_GETFD) != -1)
+        return refuse(vm, "Restore: guest fd %d is already in use", file->fd);
+
+    int fd = open(file->path, file->flags);
+    if (-1 == fd)
+        return refuse(vm, "Restore: %s: %s", file->path, strerror(errno));
+
+    if (lseek(fd, file->offset, SEEK_SET) != file->offset ||
+        (fd != file->fd && dup2(fd, file->fd) != file->fd))
+    {
+        int err = errno;
+        close(fd);
+        return refuse(vm, "Restore: %s: %s", file->path, strerror(err));
+    }
+    if (fd != file->fd)
+        close(fd);
+
+    vm->open_files[file->fd / 64] |= 1ull << (file->fd % 64);
+    return 0;
+}
+
+
+
+// What pvm_image_create() hashes of it.
+static size_t image_bytes(size_t bytes)
+{
+    size_t words = bytes / sizeof(word_t);
+    return (words < MEMORY_SIZE ? words : MEMORY_SIZE) * sizeof(word_t);
+}
+
+
+
+int pvm_restore(pvm_vm *vm, const char *path, const void *image, size_t bytes)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (-1 == fd)
+        return refuse(vm, "Restore: %s: %s", path, strerror(errno));
+
+    // Up and out of the way of the guest's descriptors.
+    int high = fcntl(fd, F_DUPFD_CLOEXEC, GUEST_FD_LIMIT);
+    close(fd);
+    if (-1 == high)
+        return refuse(vm, "Restore: %s: %s", path, strerror(errno));
+    fd = high;
+
+    SnapshotHeader h;
+    struct stat st;
+    const char *stale = NULL;
+
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || 0 != memcmp(h.magic, SNAPSHOT_MAGIC, 4))
+        stale = "not a snapshot";
+    else if (h.version != SNAPSHOT_VERSION || h.header_size != sizeof(SnapshotHeader) ||
+             h.memory_words != MEMORY_SIZE)
+        stale = "made by a different version of pvm";
+    else if (h.checksum != header_checksum(&h) || h.file_count > SNAPSHOT_MAX_FILES ||
+             fstat(fd, &st) != 0 || st.st_size != (off_t)(SNAPSHOT_MEMORY_AT + MEMORY_BYTES))
+        stale = "damaged";
+    else if (h.image_hash != hash_image(image, image_bytes(bytes)))
+        stale = "of a different program";
+
+    if (stale)
+    {
+        close(fd);
+        return refuse(vm, "Restore: %s is %s", path, stale);
+    }
+
+    pvm_image *snapshot = image_from_file(fd, SNAPSHOT_MEMORY_AT, &h.regs,
+                                          h.instructions, h.image_hash);
+    if (NULL == snapshot)
+    {
+        close(fd);
+        return refuse(vm, "Restore: out of memory");
+    }
+
+    int mapped = pvm_map_image(vm, snapshot);
+    pvm_image_destroy(snapshot);
+    if (mapped != 0)
+        return refuse(vm, "Restore: can't map %s: %s", path, strerror(errno));
+
+    for (uint32_t i = 0; i < h.file_count; i++)
+        if (reopen_file(vm, &h.files[i]) != 0)
+            return -1;
+    return 0;
+}
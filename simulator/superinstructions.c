@@ -0,0 +1,63 @@
+#include "superinstructions.h"
+
+
+
+// Match helpers, so the table below reads like assembly.
+#define ANY_OF(op)         { 0xF000, (word_t)((op) << 12) }
+#define EXACTLY(op, func)  { 0xFFFF, (word_t)(((op) << 12) | (func)) }
+
+// Patterns are tried in order, so keep the longer ones first.
+const FusedPattern FUSED_PATTERNS[FUSED_PATTERN_COUNT] = {
+    [FUSE_LOAD_LDI_DIV_DROP] = {
+        "LOAD x; LDI k; DIV; DROP", 4,
+        { ANY_OF(OP_LOAD), ANY_OF(OP_LDI),
+          EXACTLY(OP_ALU_LOGIC, FUNC_DIV), EXACTLY(OP_STACK_OPS, FUNC_DROP) }
+    },
+    [FUSE_LOAD_DUP_LOAD_ADD] = {
+        "LOAD a; DUP; LOAD b; ADD", 4,
+        { ANY_OF(OP_LOAD), EXACTLY(OP_STACK_OPS, FUNC_DUP),
+          ANY_OF(OP_LOAD), EXACTLY(OP_ALU_LOGIC, FUNC_ADD) }
+    },
+    [FUSE_LDI_LDI_TRAP_WRITE] = {
+        "LDI fd; LDI buf; TRAP 1", 3,
+        { ANY_OF(OP_LDI), ANY_OF(OP_LDI), EXACTLY(OP_TRAP, 1) }
+    },
+    [FUSE_LDI_BNZ] = {
+        "LDI k; BNZ", 2,
+        { ANY_OF(OP_LDI), EXACTLY(OP_BRANCH, FUNC_BNZ) }
+    }
+};
+
+
+
+// Returns the id of the first pattern that starts at addr, or -1.
+int match_fused_pattern(const word_t *memory, word_t addr)
+{
+    for (int id = 0; id < FUSED_PATTERN_COUNT; id++)
+    {
+        const FusedPattern *p = &FUSED_PATTERNS[id];
+        int i = 0;
+
+        while (i < p->length &&
+               (memory[(word_t)(addr + i)] & p->match[i].mask) == p->match[i].value)
+            i++;
+
+        if (i == p->length)
+            return id;
+    }
+    return -1;
+}
+
+
+
+void print_fused_stats(FILE *out, const uint64_t *hits)
+{
+    fprintf(out, "\n** Superinstruction stats **\n");
+    for (int id = 0; id < FUSED_PATTERN_COUNT; id++)
+    {
+        fprintf(out, "  %-28s hits: %-12llu instructions: %llu\n",
+                FUSED_PATTERNS[id].name,
+                (unsigned long long)hits[id],
+                (unsigned long long)hits[id] * FUSED_PATTERNS[id].length);
+    }
+}
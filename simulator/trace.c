@@ -0,0 +1,76 @@
+#include "trace.h"
+
+
+
+TraceRecord TRACE_RING[TRACE_RING_SIZE];
+uint64_t    trace_count = 0;
+int         trace_streaming = 0;
+int         trace_enabled = 0;
+
+static FILE *trace_file = NULL;
+static int   trace_flags = 0;
+
+
+
+static void write_header(uint32_t dropped)
+{
+    TraceHeader h;
+    memcpy(h.magic, TRACE_MAGIC, 4);
+    h.version     = TRACE_VERSION;
+    h.record_size = sizeof(TraceRecord);
+    h.flags       = trace_flags;
+    h.dropped     = dropped;
+    fwrite(&h, sizeof(h), 1, trace_file);
+}
+
+
+
+void trace_open(FILE *log, int flight_recorder)
+{
+    trace_file      = log;
+    trace_flags     = flight_recorder ? TRACE_FLIGHT : 0;
+    trace_streaming = !flight_recorder;
+    trace_enabled   = 1;
+
+    // The flight recorder only knows how much it dropped at the end.
+    if (trace_streaming)
+        write_header(0);
+}
+
+
+
+void trace_spill(void)
+{
+    fwrite(TRACE_RING, sizeof(TraceRecord), TRACE_RING_SIZE, trace_file);
+}
+
+
+
+void trace_flush(void)
+{
+    if (NULL == trace_file)
+        return;
+
+    size_t tail = trace_count & (TRACE_RING_SIZE - 1);
+
+    if (trace_streaming)
+    {
+        fwrite(TRACE_RING, sizeof(TraceRecord), tail, trace_file);
+    }
+    else if (trace_count <= TRACE_RING_SIZE)
+    {
+        write_header(0);
+        fwrite(TRACE_RING, sizeof(TraceRecord), trace_count, trace_file);
+    }
+    else
+    {
+        // Oldest record first.
+        uint64_t dropped = trace_count - TRACE_RING_SIZE;
+        write_header(dropped > UINT32_MAX ? UINT32_MAX : (uint32_t)dropped);
+        fwrite(TRACE_RING + tail, sizeof(TraceRecord), TRACE_RING_SIZE - tail, trace_file);
+        fwrite(TRACE_RING, sizeof(TraceRecord), tail, trace_file);
+    }
+
+    trace_file    = NULL;
+    trace_enabled = 0;
+}
@@ -1,80 +1,237 @@
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "trap_handlers.h"
 #include "string_utils.h"
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 
 
 
-// Global TRAP Dispatch Table definition.
-trap_handler_t TRAP_TABLE[256] = {0};
-
 // Forward declarations for local trap handlers
-void trap_read_handler(void);
-void trap_write_handler(void);
-void trap_exit_handler(void);
-void trap_open_handler(void);
-void trap_close_handler(void);
+static void trap_read_handler(pvm_vm *vm);
+static void trap_write_handler(pvm_vm *vm);
+static void trap_exit_handler(pvm_vm *vm);
+static void trap_open_handler(pvm_vm *vm);
+static void trap_close_handler(pvm_vm *vm);
+static void trap_memcpy_handler(pvm_vm *vm);
+static void trap_memset_handler(pvm_vm *vm);
+static void trap_memcmp_handler(pvm_vm *vm);
+static void trap_strcmp_handler(pvm_vm *vm);
+static void trap_format_handler(pvm_vm *vm);
+static void trap_format_unsigned_handler(pvm_vm *vm);
+static void trap_parse_handler(pvm_vm *vm);
+
+
+
+// **Default I/O hooks**
+// Straight to the host, guest descriptors are host descriptors.
+
+static long host_read(void *user, int fd, void *buf, size_t count)
+{
+    (void)user;
+    return read(fd, buf, count);
+}
+
+static long host_write(void *user, int fd, const void *buf, size_t count)
+{
+    (void)user;
+    return write(fd, buf, count);
+}
+
+static int host_open(void *user, const char *path, int flags)
+{
+    (void)user;
+    return open(path, flags);
+}
+
+static int host_close(void *user, int fd)
+{
+    (void)user;
+    return close(fd);
+}
+
+const pvm_io HOST_IO = { NULL, host_read, host_write, host_open, host_close };
+
+
+
+// **Buffering**
+// A TRAP 1 only copies the string into vm->output, which goes out in one
+// write when it's full, when the guest writes to another descriptor,
+// reads anything or closes it, and when the run ends. A TRAP 0 on stdin
+// is served from what was read ahead. pvm_set_buffering(vm, 0) goes back
+// to a system call for every TRAP (strings longer than the buffer still
+// take more than one).
+
+void flush_guest_output(pvm_vm *vm)
+{
+    size_t used = vm->output_used;
+    size_t done = 0;
+
+    // Emptied first, the hook may pvm_fail() and never come back.
+    vm->output_used = 0;
+
+    // Write errors never were the guest's business.
+    while (done < used)
+    {
+        long n = vm->io.write(vm->io.user, vm->output_fd, vm->output + done, used - done);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+}
+
+
+
+// Up to max_count bytes of stdin, read ahead a buffer at a time. Returns
+// what read() would, with *data pointing at them.
+static long read_stdin(pvm_vm *vm, const char **data, word_t max_count)
+{
+    if (vm->input_pos == vm->input_used)
+    {
+        long n = vm->io.read(vm->io.user, 0, vm->input, sizeof(vm->input));
+        if (n <= 0)
+            return n;
+        vm->input_pos  = 0;
+        vm->input_used = n;
+    }
+
+    size_t n = vm->input_used - vm->input_pos;
+    if (n > max_count)
+        n = max_count;
+    *data = vm->input + vm->input_pos;
+    vm->input_pos += n;
+    return (long)n;
+}
+
+
+
+// The console (pvm_set_console()), what TRAP 1 on stdout does with a
+// one character string.
+void console_write(pvm_vm *vm, word_t c)
+{
+    if ((vm->output_used > 0 && vm->output_fd != 1) || OUTPUT_BUFFER == vm->output_used)
+        flush_guest_output(vm);
+    vm->output_fd = 1;
+    vm->output[vm->output_used++] = (char)c;
+
+    if (!vm->buffered)
+        flush_guest_output(vm);
+}
+
+
+
+// Unlike TRAP 0 it only flushes when it has to wait for stdin, a
+// program echoing a byte at a time would make a write of every one.
+word_t console_read(pvm_vm *vm)
+{
+    if (vm->input_pos == vm->input_used)
+        flush_guest_output(vm);
+
+    char c;
+    const char *data = &c;
+    long n;
+
+    if (vm->buffered || vm->input_pos < vm->input_used)
+        n = read_stdin(vm, &data, 1);
+    else
+        n = vm->io.read(vm->io.user, 0, &c, 1);
+
+    return n > 0 ? (unsigned char)*data : 0xFFFF;
+}
 
 
 
 // Syscall 0: read(fd, buf_offset, count);
-void trap_read_handler()
+static void trap_read_handler(pvm_vm *vm)
 {
+    word_t *memory = vm->memory;
+
     CHECK_SP_UNDERFLOW(3);
     // POP Max Count to read.
-    word_t max_count = MEMORY[REGS.SP++];
+    word_t max_count = memory[vm->regs.SP++];
     // POP Buffer Offset (relative to BR).
-    word_t buf_offset = MEMORY[REGS.SP++];
+    word_t buf_offset = memory[vm->regs.SP++];
     // POP File Descriptor.
-    word_t fd = MEMORY[REGS.SP++];
+    word_t fd = memory[vm->regs.SP++];
 
     if (max_count > MAX_STACK_READ_SIZE)
-    {
-        fprintf(stderr, "Runtime Error: Read request of %u bytes exceeds maximum of %d\n", max_count, MAX_STACK_READ_SIZE);
-        CLOSE_LOG();
-        exit(EXIT_FAILURE);
-    }
+        pvm_fail(vm, "Runtime Error: Read request of %u bytes exceeds maximum of %d",
+                 max_count, MAX_STACK_READ_SIZE);
+
+    // A prompt has to be out before we wait for the answer.
+    flush_guest_output(vm);
 
     char tmp[max_count];
-    ssize_t n = read((int)fd, tmp, max_count);
+    const char *data = tmp;
+    long n;
+
+    if (0 == fd && max_count > 0 && (vm->buffered || vm->input_pos < vm->input_used))
+        n = read_stdin(vm, &data, max_count);
+    else
+        n = vm->io.read(vm->io.user, (int)fd, tmp, max_count);
 
     if (n < 0)
     {
-        MEMORY[--REGS.SP] = (word_t)n;
+        memory[--vm->regs.SP] = (word_t)n;
         return;
     }
 
     // Pack the buffer into memory, including the length prefix.
-    buf_pack(tmp, buf_offset, n);
+    word_t addr = vm->regs.BR + buf_offset;
+    buf_pack(memory, addr, data, n);
+    invalidate_code_cache(vm, addr, 1 + (n + 1) / 2);
 
-    MEMORY[--REGS.SP] = (word_t)n;
+    memory[--vm->regs.SP] = (word_t)n;
 }
 
 
 
 // Syscall 1: write(fd, buf_offset, count);
-void trap_write_handler()
+static void trap_write_handler(pvm_vm *vm)
 {
+    word_t *memory = vm->memory;
+
     CHECK_SP_UNDERFLOW(2);
     // POP Buffer Offset (relative to BR).
-    word_t buf_offset = MEMORY[REGS.SP++];
+    word_t buf_offset = memory[vm->regs.SP++];
     // POP File Descriptor.
-    word_t fd = MEMORY[REGS.SP++];
+    word_t fd = memory[vm->regs.SP++];
+
+    word_t addr = vm->regs.BR + buf_offset;
+    word_t count = memory[addr];
+
+    if (vm->output_used > 0 && vm->output_fd != fd)
+        flush_guest_output(vm);
+    vm->output_fd = fd;
 
-    string_t write_str = str_unpack(buf_offset);
-    write((1 == fd ? STDOUT_FILENO : (2 == fd ? STDERR_FILENO : fd)), write_str.str, write_str.count);
-    free(write_str.str);
-    MEMORY[--REGS.SP] = write_str.count;
+    // Longer strings than the buffer go out a buffer at a time.
+    for (word_t done = 0; done < count; )
+    {
+        if (OUTPUT_BUFFER == vm->output_used)
+            flush_guest_output(vm);
+
+        size_t n = OUTPUT_BUFFER - vm->output_used;
+        if (n > (size_t)(count - done))
+            n = count - done;
+        buf_unpack(memory, addr, vm->output + vm->output_used, done, (word_t)n);
+        vm->output_used += n;
+        done += n;
+    }
+
+    if (!vm->buffered)
+        flush_guest_output(vm);
+    memory[--vm->regs.SP] = count;
 }
 
 
 
 // Syscall 2: exit(status);
-void trap_exit_handler()
+static void trap_exit_handler(pvm_vm *vm)
 {
     // The exitcode is stored at the Base Register.
-    status = MEMORY[REGS.BR];
+    vm->status = vm->memory[vm->regs.BR];
 }
 
 
@@ -82,58 +239,364 @@ void trap_exit_handler()
 // Syscall 3: open(*path, flags, count);
 // Count is added as a way to actually unpack this.
 // There are other options, like mode, but let's work with this.
-void trap_open_handler()
+static void trap_open_handler(pvm_vm *vm)
 {
+    word_t *memory = vm->memory;
+
     CHECK_SP_UNDERFLOW(2);
     // POP Flags. Check: https://man7.org/linux/man-pages/man2/open.2.html
-    word_t flags = MEMORY[REGS.SP++];
+    word_t flags = memory[vm->regs.SP++];
     // POP path. We still have to process it.
-    word_t buf_offset = MEMORY[REGS.SP++];
+    word_t buf_offset = memory[vm->regs.SP++];
 
-    string_t open_str = str_unpack(buf_offset);
-    int fd = open(open_str.str, (int)flags);
+    char path[MAX_PATH_LENGTH];
+    if (str_unpack(memory, vm->regs.BR + buf_offset, path, sizeof(path)) >= sizeof(path))
+        pvm_fail(vm, "open: %s", strerror(ENAMETOOLONG));
+    int fd = vm->io.open(vm->io.user, path, (int)flags);
 
     if (-1 == fd)
-    {
-        perror("open");
-        free(open_str.str);
-        CLOSE_LOG();
-        exit(EXIT_FAILURE);
-    }
+        pvm_fail(vm, "open: %s", strerror(errno));
 
-    free(open_str.str);
-    MEMORY[--REGS.SP] = (word_t)fd;
+    // For snapshots, see pvm_save_snapshot().
+    if (fd < 256)
+        vm->open_files[fd / 64] |= 1ull << (fd % 64);
+    else
+        vm->untracked_files++;
+
+    memory[--vm->regs.SP] = (word_t)fd;
 }
 
 
 
 // Syscall 4: close(fd);
-void trap_close_handler()
+static void trap_close_handler(pvm_vm *vm)
 {
     // POP fd.
-    word_t fd = MEMORY[REGS.SP++];
+    word_t fd = vm->memory[vm->regs.SP++];
+
+    // Nothing for it may be left behind, nor read ahead of a new stdin.
+    if (vm->output_used > 0 && vm->output_fd == fd)
+        flush_guest_output(vm);
+    if (0 == fd)
+        vm->input_pos = vm->input_used = 0;
 
     // (https://man7.org/linux/man-pages/man2/close.2.html)
     // close() returns zero on success.  On error, -1 is returned, and
     // errno is set to indicate the error.
-    if (close(fd) != 0)
+    if (vm->io.close(vm->io.user, fd) != 0)
+        pvm_fail(vm, "Could not close the file.");
+
+    if (fd < 256)
+        vm->open_files[fd / 64] &= ~(1ull << (fd % 64));
+    else if (vm->untracked_files > 0)
+        vm->untracked_files--;
+}
+
+
+
+// **Bulk memory**
+// What a LOAD/STORE loop would do, a range at a time. Addresses are BR
+// relative and ranges carry on at 0 past the end of memory, like every
+// other address. The host functions only see runs that don't.
+
+// Of count words from at on, how many come before the end of memory.
+static size_t run_length(word_t at, size_t count)
+{
+    size_t run = (size_t)MEMORY_SIZE - at;
+    return run < count ? run : count;
+}
+
+
+
+// Longer ones cost gas too, see GAS_WORDS.
+static void charge_words(pvm_vm *vm, size_t words)
+{
+    if (vm->gas_limit > 0)
+        vm->bulk_gas = words / GAS_WORDS;
+}
+
+
+
+// -1, 0 or 1 for the first of count words that differ, as unsigned words.
+// memcmp() finds the block it's in, byte order makes it useless for more.
+#define COMPARE_BLOCK 32
+
+static int compare_words(const word_t *memory, word_t a, word_t b, size_t count)
+{
+    while (count > 0)
+    {
+        size_t run = run_length(a, run_length(b, count));
+        const word_t *x = memory + a, *y = memory + b;
+
+        for (size_t i = 0; i < run; i += COMPARE_BLOCK)
+        {
+            size_t n = run - i < COMPARE_BLOCK ? run - i : COMPARE_BLOCK;
+            if (0 == memcmp(x + i, y + i, n * sizeof(word_t)))
+                continue;
+            for (size_t j = i; ; j++)
+                if (x[j] != y[j])
+                    return x[j] < y[j] ? -1 : 1;
+        }
+        a += run;
+        b += run;
+        count -= run;
+    }
+    return 0;
+}
+
+
+
+// memmove() a run at a time, front to back or back to front. Either is
+// right as long as no word is written before it's been read.
+static void move_up(word_t *memory, word_t dst, word_t src, size_t count)
+{
+    for (size_t done = 0, run; done < count; done += run)
     {
-        fprintf(stderr, "Could not close the file.\n");
-        CLOSE_LOG();
-        exit(EXIT_FAILURE);
+        word_t s = (word_t)(src + done), d = (word_t)(dst + done);
+        run = run_length(s, run_length(d, count - done));
+        memmove(memory + d, memory + s, run * sizeof(word_t));
     }
 }
 
 
 
+static void move_down(word_t *memory, word_t dst, word_t src, size_t count)
+{
+    for (size_t left = count, run; left > 0; left -= run)
+    {
+        // The last words left, as many as don't go back past 0.
+        word_t s = (word_t)(src + left - 1), d = (word_t)(dst + left - 1);
+        run = left;
+        if (run > (size_t)s + 1)
+            run = (size_t)s + 1;
+        if (run > (size_t)d + 1)
+            run = (size_t)d + 1;
+        memmove(memory + (d + 1 - run), memory + (s + 1 - run), run * sizeof(word_t));
+    }
+}
+
+
+
+static void reverse_words(word_t *w, size_t count)
+{
+    for (size_t i = 0, j = count - 1; i < j; i++, j--)
+    {
+        word_t t = w[i];
+        w[i] = w[j];
+        w[j] = t;
+    }
+}
+
+
+
+// Syscall 5: memcpy(dst, src, count);
+// Words, and the ranges may overlap (it's memmove really).
+static void trap_memcpy_handler(pvm_vm *vm)
+{
+    word_t *memory = vm->memory;
+
+    CHECK_SP_UNDERFLOW(3);
+    word_t count = memory[vm->regs.SP++];
+    word_t src   = vm->regs.BR + memory[vm->regs.SP++];
+    word_t dst   = vm->regs.BR + memory[vm->regs.SP++];
+    word_t shift = dst - src;
+
+    if (0 == shift || 0 == count)
+        ;
+    else if (shift >= count)
+        move_up(memory, dst, src, count);
+    else if ((size_t)MEMORY_SIZE - shift >= count)
+        move_down(memory, dst, src, count);
+    else
+    {
+        // Longer than half of memory, the destination runs into the
+        // source at both ends. Between them they cover all of it: turn
+        // all of memory round by shift, then give the words past the
+        // destination back their old values, which that moved up by
+        // shift too. There are fewer of them than shift.
+        reverse_words(memory, MEMORY_SIZE);
+        reverse_words(memory, shift);
+        reverse_words(memory + shift, MEMORY_SIZE - shift);
+        for (size_t i = 0; i < MEMORY_SIZE - (size_t)count; i++)
+        {
+            word_t at = (word_t)(dst + count + i);
+            memory[at] = memory[(word_t)(at + shift)];
+        }
+    }
+
+    invalidate_code_cache(vm, dst, count);
+    charge_words(vm, count);
+}
+
+
+
+// Syscall 6: memset(dst, value, count);
+// Fills count words with value.
+static void trap_memset_handler(pvm_vm *vm)
+{
+    word_t *memory = vm->memory;
+
+    CHECK_SP_UNDERFLOW(3);
+    word_t count = memory[vm->regs.SP++];
+    word_t value = memory[vm->regs.SP++];
+    word_t dst   = vm->regs.BR + memory[vm->regs.SP++];
+
+    for (word_t at = dst, left = count; left > 0; )
+    {
+        size_t run = run_length(at, left);
+        if ((value >> 8) == (value & 0xFF))
+            memset(memory + at, value & 0xFF, run * sizeof(word_t));
+        else
+        {
+            for (size_t i = 0; i < run; i++)
+                memory[at + i] = value;
+        }
+        at   += run;
+        left -= run;
+    }
+
+    invalidate_code_cache(vm, dst, count);
+    charge_words(vm, count);
+}
+
+
+
+// Syscall 7: memcmp(a, b, count);
+// Pushes -1, 0 or 1, the words compared as unsigned.
+static void trap_memcmp_handler(pvm_vm *vm)
+{
+    word_t *memory = vm->memory;
+
+    CHECK_SP_UNDERFLOW(3);
+    word_t count = memory[vm->regs.SP++];
+    word_t b     = vm->regs.BR + memory[vm->regs.SP++];
+    word_t a     = vm->regs.BR + memory[vm->regs.SP++];
+
+    int result = compare_words(memory, a, b, count);
+
+    charge_words(vm, count);
+    memory[--vm->regs.SP] = (word_t)result;
+}
+
+
+
+// Syscall 8: strcmp(a, b);
+// Packed strings, -1, 0 or 1 like strcmp() (characters are unsigned).
+// There's no strlen, a packed string's length is its first word.
+static void trap_strcmp_handler(pvm_vm *vm)
+{
+    word_t *memory = vm->memory;
+
+    CHECK_SP_UNDERFLOW(2);
+    word_t b = vm->regs.BR + memory[vm->regs.SP++];
+    word_t a = vm->regs.BR + memory[vm->regs.SP++];
+
+    word_t len_a = memory[a], len_b = memory[b];
+    word_t n = len_a < len_b ? len_a : len_b;
+
+    // The first character is the high byte, so a word compares two at once.
+    int result = compare_words(memory, a + 1, b + 1, n / 2);
+    if (0 == result && n % 2)
+    {
+        word_t x = memory[(word_t)(a + 1 + n / 2)] >> 8;
+        word_t y = memory[(word_t)(b + 1 + n / 2)] >> 8;
+        result = (x > y) - (x < y);
+    }
+    if (0 == result)
+        result = (len_a > len_b) - (len_a < len_b);
+
+    charge_words(vm, n / 2);
+    memory[--vm->regs.SP] = (word_t)result;
+}
+
+
+
+// **Numbers**
+// What a DIV loop would do to print one, see str_format_word() and
+// str_parse_word().
+
+static void check_base(pvm_vm *vm, word_t base)
+{
+    if (base < 2 || base > 36)
+        pvm_fail(vm, "Runtime Error: Base %u is not between 2 and 36", base);
+}
+
+
+
+static void format_word(pvm_vm *vm, int is_signed)
+{
+    word_t *memory = vm->memory;
+
+    CHECK_SP_UNDERFLOW(3);
+    word_t base  = memory[vm->regs.SP++];
+    word_t value = memory[vm->regs.SP++];
+    word_t addr  = vm->regs.BR + memory[vm->regs.SP++];
+    check_base(vm, base);
+
+    word_t count = str_format_word(memory, addr, value, base, is_signed);
+    invalidate_code_cache(vm, addr, 1 + (count + 1) / 2);
+
+    memory[--vm->regs.SP] = count;
+}
+
+
+
+// Syscall 9: format(buf_offset, value, base);
+// Value as a signed number, a packed string at buf_offset. Pushes its length.
+static void trap_format_handler(pvm_vm *vm)
+{
+    format_word(vm, 1);
+}
+
+
+
+// Syscall 10: format_unsigned(buf_offset, value, base);
+static void trap_format_unsigned_handler(pvm_vm *vm)
+{
+    format_word(vm, 0);
+}
+
+
+
+// Syscall 11: parse(buf_offset, from, base);
+// The number at character from of the packed string at buf_offset.
+// Pushes its value, then how many characters it took (0 if none).
+static void trap_parse_handler(pvm_vm *vm)
+{
+    word_t *memory = vm->memory;
+
+    CHECK_SP_UNDERFLOW(3);
+    word_t base = memory[vm->regs.SP++];
+    word_t from = memory[vm->regs.SP++];
+    word_t addr = vm->regs.BR + memory[vm->regs.SP++];
+    check_base(vm, base);
+
+    word_t value;
+    word_t count = str_parse_word(memory, addr, from, base, &value);
+
+    memory[--vm->regs.SP] = value;
+    memory[--vm->regs.SP] = count;
+}
+
+
+
 // We have 256 options, could we expand this later if so? Yeah?
-void initialize_trap_table()
+void initialize_trap_table(pvm_vm *vm)
 {
+    memset(vm->traps, 0, sizeof(vm->traps));
+
     // For now we have this one.
     // TODO: Add the implementation for more system calls.
-    TRAP_TABLE[0] = trap_read_handler;
-    TRAP_TABLE[1] = trap_write_handler;
-    TRAP_TABLE[2] = trap_exit_handler;
-    TRAP_TABLE[3] = trap_open_handler;
-    TRAP_TABLE[4] = trap_close_handler;
+    vm->traps[0] = trap_read_handler;
+    vm->traps[1] = trap_write_handler;
+    vm->traps[2] = trap_exit_handler;
+    vm->traps[3] = trap_open_handler;
+    vm->traps[4] = trap_close_handler;
+    vm->traps[5] = trap_memcpy_handler;
+    vm->traps[6] = trap_memset_handler;
+    vm->traps[7] = trap_memcmp_handler;
+    vm->traps[8] = trap_strcmp_handler;
+    vm->traps[9] = trap_format_handler;
+    vm->traps[10] = trap_format_unsigned_handler;
+    vm->traps[11] = trap_parse_handler;
 }
@@ -0,0 +1,121 @@
+; A TRAP 5 (memcpy) of more than half of memory, across the end of it,
+; where the source and the destination overlap at both ends: 0xFBF0
+; words from 0xD400 to 0x0400. Four words are marked beforehand and
+; printed after: the first and the last of the destination, and two
+; whose source was in the destination already. Everything of this
+; program (under 0x0400) and the stack (over 0xFFEF) is left alone.
+
+.CODE
+    JMP FIND_BR
+
+START:
+    JAL GOT_BR          ; Pushes LR, which FIND_BR left at BR.
+GOT_BR:
+    LDI 0
+    SWAP
+    SUB
+    STORE ZERO
+
+    LOAD AT_D400
+    LDI MARKS
+    JAL POKE
+    LOAD AT_FFEF
+    LDI MARKS
+    INC
+    JAL POKE
+    LOAD AT_0400
+    LDI MARKS
+    LDI 2
+    ADD
+    JAL POKE
+    LOAD AT_CFEF
+    LDI MARKS
+    LDI 3
+    ADD
+    JAL POKE
+
+    LOAD ZERO
+    LOAD AT_0400
+    ADD
+    LOAD ZERO
+    LOAD AT_D400
+    ADD
+    LDI -1040           ; 0xFBF0
+    TRAP 5
+
+    LOAD AT_0400
+    LDI OUT
+    INC
+    JAL PEEK
+    LOAD AT_2FEF
+    LDI OUT
+    LDI 2
+    ADD
+    JAL PEEK
+    LOAD AT_3400
+    LDI OUT
+    LDI 3
+    ADD
+    JAL PEEK
+    LOAD AT_FFEF
+    LDI OUT
+    LDI 4
+    ADD
+    JAL PEEK
+
+    LDI 1
+    LDI OUT
+    TRAP 1
+    DROP
+    LDI 1
+    LDI NEWLINE
+    TRAP 1
+    DROP
+    TRAP 2
+
+; Copies the word at the offset on top to the address under it.
+POKE:
+    SWAP
+    STORE FROM
+    SWAP
+    LOAD ZERO
+    ADD
+    LOAD FROM
+    LDI 1
+    TRAP 5
+    RET
+
+; Copies the word at the address under the offset on top to that offset.
+PEEK:
+    SWAP
+    STORE FROM
+    SWAP
+    LOAD ZERO
+    ADD
+    LOAD FROM
+    SWAP
+    LDI 1
+    TRAP 5
+    RET
+
+; The last word of code, so the address after it is BR.
+FIND_BR:
+    JAL START
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NEWLINE:    .WORD 1
+                .WORD 0x0A00
+    ZERO:       .WORD 0     ; Address 0, relative to BR.
+    FROM:       .WORD 0
+    AT_0400:    .WORD 0x0400
+    AT_2FEF:    .WORD 0x2FEF
+    AT_3400:    .WORD 0x3400
+    AT_CFEF:    .WORD 0xCFEF
+    AT_D400:    .WORD 0xD400
+    AT_FFEF:    .WORD 0xFFEF
+    MARKS:      .WORD 0x4142    ; "AB" at 0xD400, to go to 0x0400
+                .WORD 0x4344    ; "CD" at 0xFFEF, to 0x2FEF
+                .WORD 0x4546    ; "EF" at 0x0400, to 0x3400
+                .WORD 0x4748    ; "GH" at 0xCFEF, to 0xFFEF
+    OUT:        .STRING "........"
@@ -0,0 +1,102 @@
+; Overlapping TRAP 5 (memcpy) copies that wrap round the end of memory,
+; one of each direction. The words from 0xFFFF to 9 are the scratch: with
+; nothing left on the stack between traps it never gets past 0xFFFB,
+; memory[0] is only read at load time and the code there has already run.
+
+.CODE
+    JMP FIND_BR
+    HALT
+    HALT
+    HALT
+    HALT
+    HALT
+    HALT
+    HALT
+    HALT
+    HALT
+
+START:
+    JAL GOT_BR          ; Pushes LR, which FIND_BR left at BR.
+GOT_BR:
+    LDI 0
+    SWAP
+    SUB
+    STORE ZERO
+
+    ; 0xFFFF..6 to 2..9, back to front.
+    JAL FILL
+    LOAD ZERO
+    DEC
+    LDI TEXT
+    INC
+    LDI 8
+    TRAP 5
+    LOAD ZERO
+    LDI 2
+    ADD
+    LOAD ZERO
+    DEC
+    LDI 8
+    TRAP 5
+    JAL SHOW
+
+    ; 2..9 to 0xFFFD..4, front to back.
+    JAL FILL
+    LOAD ZERO
+    LDI 2
+    ADD
+    LDI TEXT
+    INC
+    LDI 8
+    TRAP 5
+    LOAD ZERO
+    LDI 3
+    SUB
+    LOAD ZERO
+    LDI 2
+    ADD
+    LDI 8
+    TRAP 5
+    JAL SHOW
+    TRAP 2
+
+; Dashes from 0xFFFF to 9.
+FILL:
+    LOAD ZERO
+    DEC
+    LDI DASHES
+    INC
+    LDI 11
+    TRAP 5
+    RET
+
+; Prints what's from 0xFFFF to 9 and a newline.
+SHOW:
+    LDI OUT
+    INC
+    LOAD ZERO
+    DEC
+    LDI 11
+    TRAP 5
+    LDI 1
+    LDI OUT
+    TRAP 1
+    DROP
+    LDI 1
+    LDI NEWLINE
+    TRAP 1
+    DROP
+    RET
+
+; The last word of code, so the address after it is BR.
+FIND_BR:
+    JAL START
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    NEWLINE:    .WORD 1
+                .WORD 0x0A00
+    ZERO:       .WORD 0     ; Address 0, relative to BR.
+    TEXT:       .STRING "ABCDEFGHIJKLMNOP"
+    DASHES:     .STRING "----------------------"
+    OUT:        .STRING "......................"
@@ -0,0 +1,55 @@
+#!/bin/sh
+# make check: the tests on a pvmd of their own. Every one with a
+# NAME.error has to come back as that error (twice, on the same pvmd)
+# without taking pvmd down, and the ones with a NAME.expected have to
+# give that output after them.
+#
+#     sh tests/pvmd_check.sh BIN_DIR IMAGE_DIR
+
+bin=$1
+images=$2
+sock=$images/pvmd.sock
+
+fail()
+{
+    echo "pvmd: $*"
+    exit 1
+}
+
+"$bin/pvmd" --socket="$sock" --threads=2 > /dev/null &
+pid=$!
+trap 'kill $pid 2> /dev/null; wait $pid 2> /dev/null' EXIT
+
+i=0
+until [ -S "$sock" ]
+do
+    i=$((i + 1))
+    [ $i -le 100 ] || fail "not listening on $sock"
+    sleep 0.05
+done
+
+for error in tests/*.error
+do
+    name=$(basename "$error" .error)
+    for run in 1 2
+    do
+        "$bin/pvmc" --socket="$sock" "$images/$name.bin" < /dev/null > /dev/null 2> "$images/$name.err"
+        rc=$?
+        if [ $rc -ne 1 ] || ! grep -qF -f "$error" "$images/$name.err"
+        then
+            fail "$name: exit status $rc, expected the error in $error"
+        fi
+        kill -0 $pid 2> /dev/null || fail "$name took pvmd down"
+    done
+done
+
+for expected in tests/*.expected
+do
+    name=$(basename "$expected" .expected)
+    "$bin/pvmc" --socket="$sock" "$images/$name.bin" < /dev/null 2> /dev/null |
+        cmp -s - "$expected" || fail "$name: output does not match $expected"
+done
+
+kill $pid
+wait $pid || fail "exit status $? after SIGTERM"
+trap - EXIT
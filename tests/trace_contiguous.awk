@@ -0,0 +1,34 @@
+# Reads pdis -t. Every record has to be for the instruction after the one
+# before it, unless that one was a branch, a jump, a call or a return.
+# Fails on any gap, and on a trace with nothing in it.
+
+function hex(s,    i, v)
+{
+    v = 0
+    for (i = 1; i <= length(s); i++)
+        v = v * 16 + index("0123456789ABCDEF", substr(s, i, 1)) - 1
+    return v
+}
+
+match($0, /\[0X[0-9A-F]+\]/) {
+    pc = hex(substr($0, RSTART + 3, RLENGTH - 4))
+    if (records++ && !jumped && pc != (last + 1) % 65536)
+    {
+        printf "trace: 0x%04X follows 0x%04X\n", pc, last
+        gaps++
+    }
+
+    # Opcodes 3, 7, 8 and 9, see isa_defs.h.
+    match($0, /\(0X[0-9A-F]+\)$/)
+    op = substr($0, RSTART + 3, 1)
+    jumped = op == "3" || op == "7" || op == "8" || op == "9"
+    last = pc
+}
+
+END {
+    if (gaps || !records)
+    {
+        printf "trace: %d records, %d gaps\n", records, gaps
+        exit 1
+    }
+}
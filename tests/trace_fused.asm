@@ -0,0 +1,66 @@
+; A loop over all four fused idioms (see superinstructions.c). make check
+; runs it traced as well, every instruction has to leave a record.
+
+.CODE
+LOOP:
+    LOAD N
+    LDI 1
+    BNZ
+    JMP DONE
+    LOAD N          ; S += N
+    DUP
+    LOAD S
+    ADD
+    STORE S
+    DEC
+    STORE N
+    LOAD N          ; R += N % 3
+    LDI 3
+    DIV
+    DROP
+    LOAD R
+    ADD
+    STORE R
+    LDI 1
+    LDI DOT
+    TRAP 1
+    DROP
+    JMP LOOP
+
+DONE:
+    LOAD S
+    JAL PRINT_NUM
+    LOAD R
+    JAL PRINT_NUM
+    TRAP 2
+
+; Prints the number under the return address and a newline.
+PRINT_NUM:
+    SWAP
+    STORE NUM
+    LDI BUF
+    LOAD NUM
+    LDI 10
+    TRAP 9
+    DROP
+    LDI 1
+    LDI BUF
+    TRAP 1
+    DROP
+    LDI 1
+    LDI NEWLINE
+    TRAP 1
+    DROP
+    RET
+
+.DATA
+    EXIT_CODE:  .WORD 0
+    DOT:        .WORD 1
+                .WORD 0x2E00
+    NEWLINE:    .WORD 1
+                .WORD 0x0A00
+    N:          .WORD 10
+    S:          .WORD 0
+    R:          .WORD 0
+    NUM:        .WORD 0
+    BUF:        .WORD 0     ; Past the image, room for any number.
@@ -0,0 +1,6 @@
+; TRAP takes 12 bits but there are only 256 traps. One past the table
+; has to stop with an error, not call whatever is after it.
+
+.CODE
+    TRAP 261
+    HALT